@@ -31,12 +31,14 @@
       'src/cpu.cc',
       'src/gc.cc',
       'src/heap.cc',
+      'src/heap-snapshot.cc',
       'src/lexer.cc',
       'src/parser.cc',
       'src/scope.cc',
       'src/root.cc',
       'src/visitor.cc',
       'src/source-map.cc',
+      'src/safepoint.cc',
       'src/fullgen.cc',
       'src/fullgen-instructions.cc',
       'src/hir.cc',
@@ -44,6 +46,10 @@
       'src/lir.cc',
       'src/lir-instructions.cc',
       'src/pic.cc',
+      'src/stub-cache.cc',
+      'src/type-feedback.cc',
+      'src/tiering.cc',
+      'src/string-table.cc',
       'src/macroassembler.cc',
       'src/runtime.cc',
     ],
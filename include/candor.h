@@ -24,6 +24,7 @@
 #define _INCLUDE_CANDOR_H_
 
 #include <stdint.h>  // uint32_t
+#include <stddef.h>  // NULL
 #include <sys/types.h>  // size_t
 
 namespace candor {
@@ -38,6 +39,7 @@ namespace internal {
   class HValueReference;
 }  // namespace internal
 
+class Isolate;
 class Value;
 class Nil;
 class Function;
@@ -49,9 +51,106 @@ class Array;
 class CData;
 struct Error;
 
+// Heap sizing and GC policy (zero values are replaced by defaults)
+struct HeapConfig {
+  typedef void (*OutOfMemoryCallback)(Isolate* isolate);
+
+  HeapConfig();
+
+  // Size of pages that spaces are consisting of (2mb by default)
+  uint32_t page_size;
+
+  // GC of space is performed when it grows over `live size * growth_factor`
+  // (2 by default), but this limit is never lower than initial size and
+  // higher than max size (zero max size means no cap)
+  uint32_t initial_new_space_size;
+  uint32_t max_new_space_size;
+  uint32_t initial_old_space_size;
+  uint32_t max_old_space_size;
+  double growth_factor;
+
+  // Number of new space GCs that object should survive to be promoted
+  // (from 1 to 5, 5 by default)
+  uint32_t tenure_generation;
+
+  // Hard limit of the whole heap's size (no limit by default), callback is
+  // invoked if heap is still bigger after full GC. Process is aborted if
+  // callback returns.
+  uint32_t heap_limit;
+  OutOfMemoryCallback out_of_memory_callback;
+};
+
+// Collections' statistics, all times are in microseconds
+struct GCStatistics {
+  // Parts of GC pause
+  enum Phase {
+    kRoots,  // remembered set and persistent handles
+    kFrames,  // values on stack
+    kVisit,  // copying or marking of everything reachable from roots
+    kWeakReferences,  // weak handles and weak slots
+    kSwap,  // swapping new space or sweeping old one
+    kPhaseCount
+  };
+
+  // Histogram bucket N counts pauses that took [2^(N-1), 2^N) microseconds
+  // (the last one counts longer pauses too)
+  static const int kHistogramSize = 24;
+
+  GCStatistics();
+
+  uint32_t minor_gcs;
+  uint32_t major_gcs;
+  uint32_t marking_steps;
+
+  // Bytes copied within new space and bytes moved into old space
+  // (or promoted in place, for large objects)
+  uint64_t bytes_copied;
+  uint64_t bytes_promoted;
+
+  // Bytes of old objects visited by background marking thread
+  // (see Isolate::SetConcurrentMarking)
+  uint64_t bytes_marked_concurrently;
+
+  uint64_t total_pause;
+  uint64_t max_pause;
+  uint32_t pause_histogram[kHistogramSize];
+
+  uint64_t phase_time[kPhaseCount];
+  uint32_t phase_histogram[kPhaseCount][kHistogramSize];
+
+  // Current size of spaces (old space's used bytes exclude free lists)
+  uint32_t new_space_size;
+  uint32_t old_space_size;
+  uint32_t old_space_used;
+  uint32_t large_space_size;
+};
+
+// Information about one GC pause, passed to trace callback
+struct GCEvent {
+  enum Type {
+    kMinor,
+    kMajor,
+    kMarkingStep
+  };
+
+  Type type;
+  uint64_t pause;
+  uint64_t phase_time[GCStatistics::kPhaseCount];
+
+  uint32_t bytes_copied;
+  uint32_t bytes_promoted;
+
+  // Size of the whole heap (see HeapConfig::heap_limit)
+  uint32_t heap_size_before;
+  uint32_t heap_size_after;
+};
+
 class Isolate {
  public:
+  typedef void (*GCTraceCallback)(Isolate* isolate, const GCEvent& event);
+
   Isolate();
+  explicit Isolate(const HeapConfig& config);
   ~Isolate();
 
   static Isolate* GetCurrent();
@@ -62,6 +161,42 @@ class Isolate {
 
   Array* StackTrace();
 
+  // Maximum amount of bytes visited by one incremental marking step,
+  // zero disables incremental marking (old space GC is stop-the-world then)
+  void SetMarkingStepSize(uint32_t bytes);
+
+  // Number of threads copying objects in new space GC (one by default)
+  void SetScavengerThreads(uint32_t threads);
+
+  // Perform incremental marking in background thread (disabled by default)
+  void SetConcurrentMarking(bool enabled);
+
+  // Ask kernel to back heap pages with transparent huge pages
+  void SetHugePages(bool enabled);
+
+  // Perform GC pause of given type: kMinor collects new space, kMajor collects
+  // both spaces (and finishes incremental marking), kMarkingStep starts
+  // incremental marking or performs its step
+  void CollectGarbage(GCEvent::Type type);
+
+  // Perform GC work that is expected to fit into `deadline_us` microseconds
+  // of idle time, returns true if there's nothing worth collecting
+  bool IdleNotification(uint64_t deadline_us);
+
+  // Statistics are accumulated since isolate's creation
+  void GetGCStatistics(GCStatistics* stats);
+
+  // Callback is invoked after every GC pause (NULL disables it)
+  void SetGCTraceCallback(GCTraceCallback callback);
+
+  // Print one line per GC pause to stderr
+  static void EnableGCTracing();
+  static void DisableGCTracing();
+
+  // Write all heap objects and references between them into JSON file
+  // (see tools/heap-snapshot.py), returns false if file can't be written
+  bool WriteHeapSnapshot(const char* path);
+
   static void EnableFullgenLogging();
   static void DisableFullgenLogging();
   static void EnableHIRLogging();
@@ -70,12 +205,18 @@ class Isolate {
   static void DisableLIRLogging();
 
  protected:
+  void Init(const HeapConfig& config);
   void SetError(Error* err);
 
+  static void OnOutOfMemory(internal::Heap* heap);
+  static void OnGCTrace(internal::Heap* heap, const GCEvent& event);
+
   internal::Heap* heap;
   internal::CodeSpace* space;
 
   Error* error;
+  HeapConfig::OutOfMemoryCallback out_of_memory_callback;
+  GCTraceCallback gc_trace_callback;
 
   friend class Value;
   friend class Nil;
@@ -90,6 +231,7 @@ class Isolate {
   template <class T>
   friend class Handle;
   friend class CWrapper;
+  friend class HandleScope;
 };
 
 struct Error {
@@ -282,6 +424,45 @@ class Handle {
   internal::HValueReference* ref;
 };
 
+// Values referenced by locals are kept alive until the innermost scope is
+// closed, scopes should be closed in reverse order of their creation
+class HandleScope {
+ public:
+  HandleScope();
+  ~HandleScope();
+
+  // Slot in the isolate's handle arena (used by Local)
+  static Value** CreateSlot(Value* value);
+
+ protected:
+  Value** top_;
+  int block_;
+};
+
+// Cheap non-persistent handle, use Handle to keep value alive outside of
+// the current HandleScope
+template <class T>
+class Local {
+ public:
+  Local() : slot(NULL) {}
+  explicit Local(Value* v)
+      : slot(reinterpret_cast<T**>(HandleScope::CreateSlot(v->As<T>()))) {
+  }
+
+  inline bool IsEmpty() { return slot == NULL; }
+
+  inline T* operator*() { return slot == NULL ? NULL : *slot; }
+  inline T* operator->() { return *slot; }
+
+  template <class S>
+  static inline Local<T> Cast(Local<S> local) {
+    return Local<T>(Value::Cast<T>(*local));
+  }
+
+ protected:
+  T** slot;
+};
+
 class CWrapper {
  public:
   explicit CWrapper(const int* magic);
@@ -29,6 +29,7 @@
 #include "isolate.h"
 #include "heap.h"
 #include "heap-inl.h"
+#include "heap-snapshot.h"
 #include "code-space.h"
 #include "fullgen.h"
 #include "fullgen-inl.h"
@@ -77,20 +78,74 @@ TYPES_LIST(METHODS_ENUM)
 
 static Isolate* current_isolate = NULL;
 
+HeapConfig::HeapConfig() : page_size(0),
+                           initial_new_space_size(0),
+                           max_new_space_size(0),
+                           initial_old_space_size(0),
+                           max_old_space_size(0),
+                           growth_factor(0),
+                           tenure_generation(0),
+                           heap_limit(0),
+                           out_of_memory_callback(NULL) {
+}
+
+
+GCStatistics::GCStatistics() {
+  memset(this, 0, sizeof(*this));
+}
+
+
 Isolate::Isolate() {
+  Init(HeapConfig());
+}
+
+
+Isolate::Isolate(const HeapConfig& config) {
+  Init(config);
+}
+
+
+void Isolate::Init(const HeapConfig& config) {
   IsolateData::GetCurrent()->isolate = this;
 
-  heap = new Heap(2 * 1024 * 1024);
+  // Pages are mmap'd, so their size should be multiple of OS page size
+  uint32_t page_size = config.page_size == 0 ?
+      2 * 1024 * 1024
+      :
+      RoundUp(config.page_size, GetPageSize());
+
+  heap = new Heap(page_size);
+  heap->new_space()->initial_size(config.initial_new_space_size);
+  heap->new_space()->max_size(config.max_new_space_size);
+  heap->old_space()->initial_size(config.initial_old_space_size);
+  heap->old_space()->max_size(config.max_old_space_size);
+  if (config.growth_factor > 1) {
+    heap->new_space()->growth_factor(config.growth_factor);
+    heap->old_space()->growth_factor(config.growth_factor);
+  }
+  heap->new_space()->compute_size_limit();
+  heap->old_space()->compute_size_limit();
+  if (config.tenure_generation != 0) {
+    heap->tenure_generation(config.tenure_generation);
+  }
+  heap->limit(config.heap_limit);
+  heap->isolate(this);
+  heap->out_of_memory_handler(OnOutOfMemory);
+  heap->gc()->trace_handler(OnGCTrace);
+
   space = new CodeSpace(heap);
   error = NULL;
+  out_of_memory_callback = config.out_of_memory_callback;
+  gc_trace_callback = NULL;
 
   current_isolate = this;
 }
 
 
 Isolate::~Isolate() {
-  delete heap;
+  // Code chunks may hold references to the heap
   delete space;
+  delete heap;
   delete IsolateData::GetCurrent();
 }
 
@@ -121,6 +176,22 @@ void Isolate::PrintError() {
 }
 
 
+void Isolate::OnOutOfMemory(Heap* heap) {
+  Isolate* isolate = heap->isolate();
+  if (isolate->out_of_memory_callback != NULL) {
+    isolate->out_of_memory_callback(isolate);
+  }
+}
+
+
+void Isolate::OnGCTrace(Heap* heap, const GCEvent& event) {
+  Isolate* isolate = heap->isolate();
+  if (isolate->gc_trace_callback != NULL) {
+    isolate->gc_trace_callback(isolate, event);
+  }
+}
+
+
 void Isolate::SetError(Error* err) {
   if (HasError()) {
     delete error;
@@ -135,6 +206,69 @@ Array* Isolate::StackTrace() {
 }
 
 
+void Isolate::SetMarkingStepSize(uint32_t bytes) {
+  heap->gc()->marking_step_size(bytes);
+}
+
+
+void Isolate::SetScavengerThreads(uint32_t threads) {
+  heap->gc()->scavenger_threads(threads);
+}
+
+
+void Isolate::SetConcurrentMarking(bool enabled) {
+  heap->gc()->concurrent_marking(enabled);
+}
+
+
+void Isolate::SetHugePages(bool enabled) {
+  heap->page_pool()->huge_pages(enabled);
+}
+
+
+void Isolate::CollectGarbage(GCEvent::Type type) {
+  heap->gc()->CollectGarbage(type, *heap->last_stack(), *heap->last_frame());
+}
+
+
+bool Isolate::IdleNotification(uint64_t deadline_us) {
+  return heap->gc()->IdleNotification(deadline_us,
+                                      *heap->last_stack(),
+                                      *heap->last_frame());
+}
+
+
+void Isolate::GetGCStatistics(GCStatistics* stats) {
+  *stats = *heap->gc()->stats();
+  stats->new_space_size = heap->new_space()->size();
+  stats->old_space_size = heap->old_space()->size();
+  stats->old_space_used = heap->old_space()->used();
+  stats->large_space_size = heap->large_space()->new_size() +
+                            heap->large_space()->old_size();
+}
+
+
+void Isolate::SetGCTraceCallback(GCTraceCallback callback) {
+  gc_trace_callback = callback;
+}
+
+
+void Isolate::EnableGCTracing() {
+  GC::EnableLogging();
+}
+
+
+void Isolate::DisableGCTracing() {
+  GC::DisableLogging();
+}
+
+
+bool Isolate::WriteHeapSnapshot(const char* path) {
+  HeapSnapshot snapshot(heap);
+  return snapshot.Write(path);
+}
+
+
 void Isolate::EnableFullgenLogging() {
   Fullgen::EnableLogging();
 }
@@ -232,6 +366,27 @@ bool Handle<T>::IsEmpty() {
 }
 
 
+HandleScope::HandleScope() : top_(NULL), block_(0) {
+  if (ISOLATE->heap == NULL) return;
+
+  HandleArena* handles = ISOLATE->heap->handles();
+  top_ = reinterpret_cast<Value**>(handles->top());
+  block_ = handles->block();
+}
+
+
+HandleScope::~HandleScope() {
+  if (ISOLATE->heap == NULL) return;
+  ISOLATE->heap->handles()->Restore(reinterpret_cast<char**>(top_), block_);
+}
+
+
+Value** HandleScope::CreateSlot(Value* value) {
+  return reinterpret_cast<Value**>(
+      ISOLATE->heap->handles()->Allocate(reinterpret_cast<char*>(value)));
+}
+
+
 Value* Value::New(char* addr) {
   return reinterpret_cast<Value*>(addr);
 }
@@ -274,7 +429,8 @@ bool Value::Is() {
   }
 
   if (addr() != NULL && addr() != HNil::New()) {
-    assert(!HValue::Cast(addr())->IsSoftGCMarked() &&
+    assert((!HValue::Cast(addr())->IsSoftGCMarked() ||
+            Heap::Current()->gc()->is_marking()) &&
            !HValue::Cast(addr())->IsGCMarked());
   }
 
@@ -480,14 +636,17 @@ void Object::Set(Value* key, Value* value) {
                                         key->addr(),
                                         1);
   *slot = value->addr();
+  ISOLATE->heap->RecordWrite(HObject::Map(addr()), value->addr());
 }
 
 
 Value* Object::Get(Value* key) {
-  return Value::New(*HObject::LookupProperty(ISOLATE->heap,
-                                             addr(),
-                                             key->addr(),
-                                             0));
+  char** slot = HObject::LookupProperty(ISOLATE->heap,
+                                        addr(),
+                                        key->addr(),
+                                        0);
+  if (slot == NULL) return Nil::New();
+  return Value::New(*slot);
 }
 
 
@@ -533,6 +692,7 @@ void Array::Set(int64_t key, Value* value) {
                                         HNumber::ToPointer(key),
                                         1);
   *slot = value->addr();
+  ISOLATE->heap->RecordWrite(HObject::Map(addr()), value->addr());
 }
 
 
@@ -25,7 +25,7 @@
 #include <unistd.h>  // open, lseek
 #include <fcntl.h>  // O_RDONLY, ...
 #include <sys/types.h>  // off_t
-#include <string.h>  // memcpy
+#include <string.h>  // memcpy, strcmp
 
 #include "candor.h"
 #include "utils.h"  // candor::internal::List
@@ -223,7 +223,13 @@ void StartRepl() {
 
 
 int main(int argc, char** argv) {
-  if (argc < 2) {
+  int arg = 1;
+  if (argc > arg && strcmp(argv[arg], "--trace-gc") == 0) {
+    candor::Isolate::EnableGCTracing();
+    arg++;
+  }
+
+  if (argc <= arg) {
     // Start repl
     StartRepl();
   } else {
@@ -231,9 +237,9 @@ int main(int argc, char** argv) {
 
     // Load script and run
     off_t size = 0;
-    const char* script = ReadContents(argv[1], &size);
+    const char* script = ReadContents(argv[arg], &size);
 
-    candor::Function* code = candor::Function::New(argv[1], script, size);
+    candor::Function* code = candor::Function::New(argv[arg], script, size);
     delete script;
 
     if (isolate.HasError()) {
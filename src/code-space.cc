@@ -47,6 +47,8 @@
 namespace candor {
 namespace internal {
 
+bool CodeSpace::tiering_ = true;
+
 CodeSpace::CodeSpace(Heap* heap) : heap_(heap) {
   stubs_ = new Stubs(this);
   entry_ = stubs()->GetEntryStub();
@@ -175,32 +177,13 @@ char* CodeSpace::Compile(const char* filename,
   for (FunctionIterator it(ast); !it.IsEnded(); it.Advance()) {
     FunctionLiteral* current = it.Value();
 
-    int len = current->own_length();
-    if (len < HIRGen::kMaxOptimizableSize) {
-      // Generate CFG with SSA
-      HIRGen hir(heap(), &r, chunk->filename());
-
-      hir.Build(current);
-
-      // Generate low-level representation:
-      //   For each root in reverse order generate lir
-      //   (Generate children first, parents later)
-      HIRBlockList::Item* head = hir.roots()->head();
-      for (; head != NULL; head = head->next()) {
-        // Generate LIR
-        LGen lir(&hir, chunk->filename(), head->value());
-
-        // Generate Masm code
-        lir.Generate(&masm, heap()->source_map());
-      }
+    if (tiering_) {
+      // Script's body is executed only once, don't profile it
+      GenerateBaseline(chunk, current, &r, &masm, current != ast);
+    } else if (current->own_length() < HIRGen::kMaxOptimizableSize) {
+      GenerateOptimized(chunk, current, &r, &masm);
     } else {
-      Fullgen f(heap(), &r, chunk->filename());
-
-      // Create instruction list
-      f.Build(current);
-
-      // Generate instructions
-      f.Generate(&masm);
+      GenerateBaseline(chunk, current, &r, &masm, false);
     }
   }
 
@@ -215,17 +198,123 @@ char* CodeSpace::Compile(const char* filename,
                                chunk->source(),
                                chunk->source_len(),
                                chunk->addr());
+  heap()->safepoints()->Commit(chunk->addr());
 
   return chunk->addr();
 }
 
 
-char* CodeSpace::CreatePIC() {
+void CodeSpace::Optimize(Tiering::Site* site, char* root) {
+  Zone zone;
+
+  CodeChunk* chunk = site->chunk();
+
+  // AST isn't kept after compilation, but parsing the same source gives
+  // the same node ids
+  Parser p(chunk->source(), chunk->source_len());
+  AstNode* ast = p.Execute();
+  assert(!p.has_error());
+
+  Scope::Analyze(ast);
+
+  FunctionIterator it(ast);
+  while (!it.IsEnded() && it.Value()->id != site->id()) it.Advance();
+  assert(!it.IsEnded());
+
+  FunctionLiteral* fn = it.Value();
+
+  // Existing root values are kept at their indexes: nested functions are
+  // created with the new root, but may be already compiled against the old
+  // one
+  Root r(heap(), root);
+  Masm masm(this);
+
+  // Optimized function goes first (at the start of the chunk), nested
+  // functions are starting in baseline tier and share counters and feedback
+  // with the original ones
+  GenerateOptimized(chunk, fn, &r, &masm);
+
+  FunctionIterator nested(fn);
+  for (nested.Advance(); !nested.IsEnded(); nested.Advance()) {
+    GenerateBaseline(chunk, nested.Value(), &r, &masm, true);
+  }
+
+  // Source is owned by the original chunk
+  CodeChunk* code = CreateChunk(chunk->filename(), "", 0);
+  Put(code, &masm);
+
+  heap()->source_map()->Commit(chunk->filename(),
+                               chunk->source(),
+                               chunk->source_len(),
+                               code->addr());
+  heap()->safepoints()->Commit(code->addr());
+
+  site->Optimized(heap(), code->addr(), r.Allocate()->addr());
+}
+
+
+void CodeSpace::GenerateBaseline(CodeChunk* chunk,
+                                 FunctionLiteral* fn,
+                                 Root* root,
+                                 Masm* masm,
+                                 bool profile) {
+  Fullgen f(heap(), root, chunk->filename());
+
+  // Count calls and collect types if function may be optimized later
+  if (profile && fn->own_length() < HIRGen::kMaxOptimizableSize) {
+    f.feedback(chunk->feedback());
+    f.tiering(chunk->tiering());
+  }
+
+  // Create instruction list
+  f.Build(fn);
+
+  // Generate instructions
+  f.Generate(masm);
+}
+
+
+void CodeSpace::GenerateOptimized(CodeChunk* chunk,
+                                  FunctionLiteral* fn,
+                                  Root* root,
+                                  Masm* masm) {
+  // Generate CFG with SSA
+  HIRGen hir(heap(), root, chunk->filename());
+
+  hir.feedback(chunk->feedback());
+  hir.Build(fn);
+
+  // Generate low-level representation:
+  //   For each root in reverse order generate lir
+  //   (Generate children first, parents later)
+  HIRBlockList::Item* head = hir.roots()->head();
+  for (; head != NULL; head = head->next()) {
+    // Generate LIR
+    LGen lir(&hir, chunk->filename(), head->value());
+
+    // Generate Masm code
+    lir.Generate(masm, heap()->source_map());
+  }
+}
+
+
+void CodeSpace::EnableTiering() {
+  tiering_ = true;
+}
+
+
+void CodeSpace::DisableTiering() {
+  tiering_ = false;
+}
+
+
+PIC* CodeSpace::CreatePIC() {
   PIC* p = new PIC(this);
 
   pics_.Push(p);
+  p->Generate();
 
-  return p->Generate();
+  return p;
 }
 
 
@@ -293,7 +382,7 @@ void CodePage::Unref() {
 
 
 CodeChunk::CodeChunk(const char* filename, const char* source, uint32_t length)
-    : source_len_(length), page_(NULL), ref_(1) {
+    : source_len_(length), page_(NULL), ref_(1), tiering_(this) {
   int filename_len = strlen(filename) + 1;
 
   filename_ = new char[filename_len];
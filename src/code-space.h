@@ -24,6 +24,8 @@
 #define _SRC_CODE_SPACE_H_
 
 #include "utils.h"  // List
+#include "type-feedback.h"  // TypeFeedback
+#include "tiering.h"  // Tiering
 
 namespace candor {
 
@@ -41,6 +43,8 @@ class CodePage;
 class CodeChunk;
 class Code;
 class PIC;
+class Root;
+class FunctionLiteral;
 
 typedef List<CodePage*, EmptyClass> CodePageList;
 typedef List<CodeChunk*, EmptyClass> CodeChunkList;
@@ -59,7 +63,7 @@ class CodeSpace {
   CodeChunk* CreateChunk(const char* filename,
                          const char* source,
                          uint32_t length);
-  char* CreatePIC();
+  PIC* CreatePIC();
 
   void Put(CodeChunk* chunk, Masm* masm);
   char* Compile(const char* filename,
@@ -68,12 +72,35 @@ class CodeSpace {
                 char** root,
                 Error** error);
 
+  // Compile hot function with HIR/LIR, baseline code will jump to it
+  void Optimize(Tiering::Site* site, char* root);
+
   Value* Run(char* fn, uint32_t argc, Value* argv[]);
 
+  // Compile everything with fullgen first and optimize only hot functions
+  // (enabled by default), or optimize all functions eagerly
+  static void EnableTiering();
+  static void DisableTiering();
+  static inline bool IsTieringEnabled() { return tiering_; }
+
   inline Heap* heap() { return heap_; }
   inline Stubs* stubs() { return stubs_; }
+  inline List<PIC*, EmptyClass>* pics() { return &pics_; }
+  inline CodeChunkList* chunks() { return &chunks_; }
 
  private:
+  void GenerateBaseline(CodeChunk* chunk,
+                        FunctionLiteral* fn,
+                        Root* root,
+                        Masm* masm,
+                        bool profile);
+  void GenerateOptimized(CodeChunk* chunk,
+                         FunctionLiteral* fn,
+                         Root* root,
+                         Masm* masm);
+
+  static bool tiering_;
+
   Heap* heap_;
   Stubs* stubs_;
   char* entry_;
@@ -116,6 +143,8 @@ class CodeChunk {
   inline const char* source() { return source_; }
   inline uint32_t source_len() { return source_len_; }
   inline char* addr() { return addr_; }
+  inline TypeFeedback* feedback() { return &feedback_; }
+  inline Tiering* tiering() { return &tiering_; }
 
  private:
   char* filename_;
@@ -124,6 +153,8 @@ class CodeChunk {
   CodePage* page_;
   char* addr_;
   int ref_;
+  TypeFeedback feedback_;
+  Tiering tiering_;
 
   friend class CodeSpace;
 };
@@ -143,6 +143,28 @@ inline SourceMap* Fullgen::source_map() {
 }
 
 
+inline void Fullgen::feedback(TypeFeedback* feedback) {
+  feedback_ = feedback;
+}
+
+
+inline TypeFeedback::Site* Fullgen::GetFeedbackSite(AstNode* node) {
+  // Nodes created by code generators have no ids
+  if (feedback_ == NULL || node->id < 0) return NULL;
+  return feedback_->GetSite(node->id);
+}
+
+
+inline void Fullgen::tiering(Tiering* tiering) {
+  tiering_ = tiering;
+}
+
+
+inline Tiering::Site* Fullgen::tiering_site() {
+  return tiering_site_;
+}
+
+
 inline void Fullgen::Print(char* out, int32_t size) {
   PrintBuffer p(out, size);
   Print(&p);
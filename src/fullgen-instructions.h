@@ -25,6 +25,7 @@
 
 #include "ast.h"  // AstNode
 #include "macroassembler.h"
+#include "tiering.h"  // Tiering
 #include "zone.h"
 #include "utils.h"
 
@@ -74,6 +75,7 @@ typedef ZoneList<FInstruction*> FInstructionList;
     V(AlignStack) \
     V(CollectGarbage) \
     V(GetStackTrace) \
+    V(BackEdge) \
     V(Call)
 
 #define FULLGEN_INSTRUCTION_ENUM(V) \
@@ -150,8 +152,11 @@ class FLabel : public FInstruction {
 
 class FEntry : public FInstruction {
  public:
-  explicit FEntry(int context_slots) : FInstruction(kEntry),
-                                       context_slots_(context_slots) {
+  // Calls are counted in `site` (if not NULL)
+  FEntry(int context_slots, Tiering::Site* site)
+      : FInstruction(kEntry),
+        context_slots_(context_slots),
+        site_(site) {
   }
 
   inline int stack_slots();
@@ -161,6 +166,7 @@ class FEntry : public FInstruction {
  protected:
   int context_slots_;
   int stack_slots_;
+  Tiering::Site* site_;
 };
 
 class FReturn : public FInstruction {
@@ -208,13 +214,22 @@ class FLiteral : public FInstruction {
 class FBinOp : public FInstruction {
  public:
   explicit FBinOp(BinOp::BinOpType sub_type) : FInstruction(kBinOp),
-                                               sub_type_(sub_type) {
+                                               sub_type_(sub_type),
+                                               site_(NULL) {
+  }
+
+  // Operand types will be recorded in `site` before each operation
+  FBinOp(BinOp::BinOpType sub_type, TypeFeedback::Site* site)
+      : FInstruction(kBinOp),
+        sub_type_(sub_type),
+        site_(site) {
   }
 
   FULLGEN_DEFAULT_METHODS(BinOp)
 
  protected:
   BinOp::BinOpType sub_type_;
+  TypeFeedback::Site* site_;
 };
 
 class FNot : public FInstruction {
@@ -285,7 +300,7 @@ class FAllocateObject : public FInstruction {
  public:
   explicit FAllocateObject(int size)
       : FInstruction(kAllocateObject),
-        size_(RoundUp(PowerOfTwo(size + 1), 64)) {
+        size_(HObject::SizeFor(size)) {
   }
 
   FULLGEN_DEFAULT_METHODS(AllocateObject)
@@ -452,6 +467,18 @@ class FCollectGarbage : public FInstruction {
   FULLGEN_DEFAULT_METHODS(CollectGarbage)
 };
 
+class FBackEdge : public FInstruction {
+ public:
+  explicit FBackEdge(Tiering::Site* site) : FInstruction(kBackEdge),
+                                            site_(site) {
+  }
+
+  FULLGEN_DEFAULT_METHODS(BackEdge)
+
+ protected:
+  Tiering::Site* site_;
+};
+
 class FGetStackTrace : public FInstruction {
  public:
   FGetStackTrace() : FInstruction(kGetStackTrace) {
@@ -43,7 +43,10 @@ Fullgen::Fullgen(Heap* heap, Root* root, const char* filename)
       current_function_(NULL),
       loop_start_(NULL),
       loop_end_(NULL),
-      source_map_(heap->source_map()) {
+      source_map_(heap->source_map()),
+      feedback_(NULL),
+      tiering_(NULL),
+      tiering_site_(NULL) {
 }
 
 
@@ -60,6 +63,8 @@ void Fullgen::DisableLogging() {
 void Fullgen::Build(AstNode* ast) {
   EmptySlots();
 
+  if (tiering_ != NULL) tiering_site_ = tiering_->GetSite(ast->id);
+
   FFunction* current = new FFunction(ast, 0);
   current->Init(this);
   set_current_function(current);
@@ -81,6 +86,11 @@ void Fullgen::Build(AstNode* ast) {
 
 
 void Fullgen::Generate(Masm* masm) {
+  // Liveness of stack slots isn't tracked, all of them are reported
+  // to safepoints
+  BitField<EmptyClass> live(0);
+  masm->live_slots(&live);
+
   FInstructionList::Item* ihead = instructions_.head();
   for (; ihead != NULL; ihead = ihead->next()) {
     FInstruction* instr = ihead->value();
@@ -88,7 +98,11 @@ void Fullgen::Generate(Masm* masm) {
       if (ihead->prev() != NULL) masm->FinalizeSpills();
 
       // +1 for argc
-      masm->stack_slots(FEntry::Cast(instr)->stack_slots() + 1);
+      int slots = FEntry::Cast(instr)->stack_slots();
+      masm->stack_slots(slots + 1);
+
+      live.Reset();
+      for (int i = 0; i < slots; i++) live.Set(i);
     }
 
     // Amend source map
@@ -100,13 +114,14 @@ void Fullgen::Generate(Masm* masm) {
     instr->Generate(masm);
   }
   masm->FinalizeSpills();
+  masm->live_slots(NULL);
   masm->AlignCode();
 }
 
 
 FInstruction* Fullgen::Visit(AstNode* node) {
   FInstruction* res = Visitor<FInstruction>::Visit(node);
-  if (res != NULL) res->ast(node);
+  if (res != NULL && res->ast() == NULL) res->ast(node);
   return res;
 }
 
@@ -231,7 +246,8 @@ FInstruction* Fullgen::VisitFunction(AstNode* stmt) {
   if (current_function()->root_ast() == stmt) {
     current_function()->body = new FLabel(fn->label());
     Add(current_function()->body);
-    current_function()->entry = new FEntry(stmt->context_slots());
+    current_function()->entry = new FEntry(stmt->context_slots(),
+                                           tiering_site());
     Add(current_function()->entry);
 
     // Load all passed arguments
@@ -460,6 +476,7 @@ FInstruction* Fullgen::VisitWhile(AstNode* node) {
   if (rhs != NULL) rhs->SetResult(&cond);
 
   // Loop
+  if (tiering_site() != NULL) Add(new FBackEdge(tiering_site()));
   Add(new FGoto(loop_start_));
 
   Add(loop_end_);
@@ -652,7 +669,14 @@ FInstruction* Fullgen::VisitCall(AstNode* stmt) {
   // Release slots used for arguments
   while (arg_slots.length() > 0) ReleaseSlot(arg_slots.Shift());
 
-  return Add(new FCall())->AddArg(&var_slot)->AddArg(&argc_slot);
+  FInstruction* call = Add(new FCall())
+      ->AddArg(&var_slot)
+      ->AddArg(&argc_slot);
+
+  // Report call at the start of callee expression in stack traces
+  if (fn->variable()->offset() >= 0) call->ast(fn->variable());
+
+  return call;
 }
 
 
@@ -703,7 +727,7 @@ FInstruction* Fullgen::VisitUnOp(AstNode* node) {
     load = Visit(op->lhs())->SetResult(&load_slot);
     GetNumber(1)->SetResult(&one);
 
-    add = Add(new FBinOp(type));
+    add = Add(new FBinOp(type, GetFeedbackSite(node)));
     add->AddArg(&load_slot)->AddArg(&one)->SetResult(&value);
 
     if (op->subtype() == UnOp::kPreInc || op->subtype() == UnOp::kPreDec) {
@@ -746,6 +770,7 @@ FInstruction* Fullgen::VisitUnOp(AstNode* node) {
     type = op->subtype() == UnOp::kPlus ? BinOp::kAdd : BinOp::kSub;
 
     AstNode* wrap = new BinOp(type, zero, op->lhs());
+    wrap->id = node->id;
 
     return Visit(wrap);
   } else if (op->subtype() == UnOp::kNot) {
@@ -767,7 +792,9 @@ FInstruction* Fullgen::VisitBinOp(AstNode* node) {
     FScopedSlot rhs(this);
     Visit(node->rhs())->SetResult(&rhs);
 
-    return Add(new FBinOp(op->subtype()))->AddArg(&lhs)->AddArg(&rhs);
+    return Add(new FBinOp(op->subtype(), GetFeedbackSite(node)))
+        ->AddArg(&lhs)
+        ->AddArg(&rhs);
   } else {
     FScopedSlot result(this);
     FLabel* t = new FLabel();
@@ -31,6 +31,8 @@
 #include "ast.h"  // AstNode, FunctionLiteral
 #include "zone.h"  // ZoneObject
 #include "utils.h"  // List
+#include "type-feedback.h"  // TypeFeedback
+#include "tiering.h"  // Tiering
 
 namespace candor {
 namespace internal {
@@ -169,6 +171,14 @@ class Fullgen : public Visitor<FInstruction> {
   inline Root* root();
   inline SourceMap* source_map();
 
+  // Record operand types into `feedback` (optional)
+  inline void feedback(TypeFeedback* feedback);
+  inline TypeFeedback::Site* GetFeedbackSite(AstNode* node);
+
+  // Count calls and loop iterations in `tiering` (optional)
+  inline void tiering(Tiering* tiering);
+  inline Tiering::Site* tiering_site();
+
  private:
   static bool log_;
 
@@ -187,6 +197,9 @@ class Fullgen : public Visitor<FInstruction> {
   FOperandList free_slots_;
 
   SourceMap* source_map_;
+  TypeFeedback* feedback_;
+  Tiering* tiering_;
+  Tiering::Site* tiering_site_;
 
   friend class FScopedSlot;
 };
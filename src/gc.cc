@@ -23,29 +23,87 @@
 #include "gc.h"
 
 #include <stdlib.h>  // NULL
+#include <stdio.h>  // fprintf
 #include <stdint.h>  // int32_t and others
 #include <unistd.h>  // intptr_t
 #include <assert.h>  // assert
+#include <string.h>  // memcpy
+#include <sched.h>  // sched_yield
+#include <pthread.h>  // pthread_t
 
 #include "heap.h"
 #include "heap-inl.h"
 #include "code-space.h"
+#include "safepoint.h"  // FrameIterator
 
 namespace candor {
 namespace internal {
 
-void GC::GCValue::Relocate(char* address) {
-  if (slot_ != NULL) {
-    *slot_ = address;
-  }
-  if (!value()->IsGCMarked()) value()->SetGCMark(address);
+bool GC::log_ = false;
+
+GC::GC(Heap* heap) : heap_(heap),
+                     tmp_space_(NULL),
+                     gc_type_(kNone),
+                     marking_(0),
+                     marking_limit_(0),
+                     full_gc_(false),
+                     marking_step_size_(kDefaultMarkingStepSize),
+                     scavenger_threads_(1),
+                     concurrent_marking_(false),
+                     marker_(NULL),
+                     marker_paused_(false),
+                     marker_busy_(false),
+                     marker_exit_(false),
+                     wait_for_marker_(false),
+                     parent_(NULL),
+                     workers_(NULL),
+                     idle_workers_(0),
+                     shared_grey_(0),
+                     bytes_copied_(0),
+                     bytes_promoted_(0),
+                     pause_start_(0),
+                     phase_start_(0),
+                     trace_handler_(NULL) {
+  memset(&event_, 0, sizeof(event_));
+  memset(last_pause_, 0, sizeof(last_pause_));
+  pthread_mutex_init(&grey_lock_, NULL);
+  pthread_mutex_init(&space_lock_, NULL);
+  pthread_mutex_init(&idle_lock_, NULL);
+  pthread_cond_init(&idle_cond_, NULL);
+  pthread_mutex_init(&marking_lock_, NULL);
+  pthread_cond_init(&marking_cond_, NULL);
+}
+
+
+GC::~GC() {
+  if (marker_ != NULL) StopMarker();
+
+  pthread_mutex_destroy(&marking_lock_);
+  pthread_cond_destroy(&marking_cond_);
+  pthread_mutex_destroy(&grey_lock_);
+  pthread_mutex_destroy(&space_lock_);
+  pthread_mutex_destroy(&idle_lock_);
+  pthread_cond_destroy(&idle_cond_);
 }
 
 
-void GC::CollectGarbage(char* stack_top) {
-  assert(grey_items()->length() == 0);
+void GC::CollectGarbage(char* stack_top, char* frame) {
+  assert(grey_objects()->length() == 0);
   assert(black_items()->length() == 0);
 
+  if (marker_ != NULL && wait_for_marker_) WaitForMarker();
+
+  StartPause();
+
+  // Marking thread may request step too, so it should be paused first
+  if (marker_ != NULL) PauseMarker();
+
+  // Old space GC may be called right after new space one
+  bool after_scavenge = gc_type() == kNewSpace;
+
+  // Objects allocated during incremental marking survive it anyway
+  bool after_marking = false;
+
   // __$gc() isn't setting needs_gc() attribute
   if (heap()->needs_gc() == Heap::kGCNone) {
     heap()->needs_gc(Heap::kGCNewSpace);
@@ -54,204 +112,1128 @@ void GC::CollectGarbage(char* stack_top) {
   switch (heap()->needs_gc()) {
     case Heap::kGCNewSpace: gc_type(kNewSpace); break;
     case Heap::kGCOldSpace: gc_type(kOldSpace); break;
+    case Heap::kGCMarkingStep: gc_type(kIncrementalMarking); break;
     default:
       UNEXPECTED
       break;
   }
 
-  // Select space to GC
-  Space* space = gc_type() == kNewSpace ?
-      heap()->new_space()
-      :
-      heap()->old_space();
+  // Heap is over the hard limit - full GC is needed (new space first), no
+  // time for incremental marking
+  if (gc_type() == kOldSpace && heap()->IsOverLimit() && !after_scavenge) {
+    gc_type(kNewSpace);
+  }
+
+  if (gc_type() == kOldSpace && marking_step_size() != 0 &&
+      !heap()->IsOverLimit() && !full_gc_) {
+    if (!is_marking()) {
+      // Start incremental marking instead of stop-the-world GC
+      StartMarking(stack_top, frame);
+      EndPause(GCEvent::kMarkingStep);
+      return;
+    }
+
+    // Finish marking in one pause if mutator is allocating too fast
+    if (heap()->old_space()->size() < marking_limit_) {
+      gc_type(kIncrementalMarking);
+    }
+  }
 
-  // Temporary space which will contain copies of all visited objects
-  tmp_space(new Space(heap(), space->page_size()));
+  if (gc_type() == kIncrementalMarking) {
+    heap()->needs_gc(Heap::kGCNone);
+    if (!is_marking() || !MarkingStep()) {
+      if (marker_ != NULL) ResumeMarker();
+      gc_type(kNone);
+      EndPause(GCEvent::kMarkingStep);
+      return;
+    }
+
+    // Everything reachable from visited objects was marked,
+    // finish marking in the final pause
+    gc_type(kOldSpace);
+  }
+
+  phase_start_ = GetTimeMicros();
+  if (gc_type() == kNewSpace) {
+    // Temporary space which will contain copies of all visited objects
+    tmp_space(new Space(heap(), heap()->new_space()->page_size()));
+
+    // Old objects referencing new space are roots too
+    ColourRememberedSet();
+  } else {
+    // Old space objects are marked in place
+    tmp_space(NULL);
+
+    // Continue incremental marking
+    if (is_marking()) {
+      after_marking = true;
+      if (marker_ != NULL) StopMarker();
+
+      while (marking_objects()->length() != 0) {
+        grey_objects()->Push(marking_objects()->Pop());
+      }
+
+      // New space objects weren't visited by marking steps
+      ColourRememberedSet();
+    }
+  }
 
   // Add referenced in C++ land values to the grey list
   ColourPersistentHandles();
+  ColourLocalHandles();
+  EndPhase(GCStatistics::kRoots);
 
   // Colour on-stack registers
-  ColourFrames(stack_top);
+  ColourFrames(stack_top, frame);
+  EndPhase(GCStatistics::kFrames);
 
-  // Reset marks for items from external space
-  while (black_items()->length() != 0) {
-    GCValue* value = black_items()->Shift();
-    assert(value->value()->IsSoftGCMarked());
-    value->value()->ResetSoftGCMark();
+  // Visit everything reachable from roots
+  if (gc_type() == kNewSpace && scavenger_threads() > 1) {
+    ParallelScavenge();
+  } else {
+    ProcessGrey();
   }
+  EndPhase(GCStatistics::kVisit);
 
   RelocateWeakHandles();
+  heap()->string_table()->Relocate(this);
 
   // Visit all weak references and call callbacks if some of them are dead
   HandleWeakReferences();
+  EndPhase(GCStatistics::kWeakReferences);
+
+  if (gc_type() == kNewSpace) {
+    heap()->new_space()->Swap(tmp_space());
+    delete tmp_space();
+
+    // Unmap large objects that weren't promoted
+    heap()->large_space()->SweepNew();
+
+    // Pretenure literals that are surviving
+    heap()->UpdateAllocationSites();
+  } else {
+    // Shapes that aren't used by anyone are removed from transition tree
+    heap()->shape_count(ClearDeadTransitions(*heap()->root_shape()));
+
+    // Remove dead objects from remembered set
+    FilterRememberedSet();
+
+    // Free dead objects and reset marks of live ones
+    heap()->old_space()->Sweep();
+    heap()->large_space()->SweepOld();
+    marking_ = 0;
+
+    // Stop pretenuring literals that are dying
+    heap()->UpdateTenuredSites();
+  }
+
+  // Cached keys may be moved or freed
+  heap()->stub_cache()->Clear();
 
-  space->Swap(tmp_space());
-  delete tmp_space();
+  // Reset marks for items from external space
+  while (black_items()->length() != 0) {
+    HValue* value = black_items()->Pop();
+    assert(value->IsSoftGCMarked());
+    value->ResetSoftGCMark();
+  }
+  EndPhase(GCStatistics::kSwap);
+  EndPause(gc_type() == kNewSpace ? GCEvent::kMinor : GCEvent::kMajor);
+
+  if (gc_type() == kNewSpace && heap()->IsOverLimit()) {
+    // Only full GC may free enough memory
+    heap()->needs_gc(Heap::kGCOldSpace);
+  } else if (gc_type() == kOldSpace && heap()->IsOverLimit()) {
+    if (after_marking) {
+      // Retry with non-incremental GC, floating garbage may be collected
+      heap()->needs_gc(Heap::kGCOldSpace);
+      CollectGarbage(stack_top, frame);
+      return;
+    } else if (after_scavenge) {
+      heap()->OutOfMemory();
+    }
+  }
 
-  if (gc_type() != kNewSpace || heap()->needs_gc() == Heap::kGCNewSpace) {
+  if (gc_type() == kNewSpace && heap()->needs_gc() != Heap::kGCNewSpace) {
+    // Call gc for old space
+    CollectGarbage(stack_top, frame);
+  } else if (gc_type() == kNewSpace && is_marking()) {
+    // Promoted objects may need to be visited by marking
+    heap()->needs_gc(Heap::kGCMarkingStep);
+    CollectGarbage(stack_top, frame);
+  } else {
     // Reset GC flag
     heap()->needs_gc(Heap::kGCNone);
-  } else {
-    // Or call gc for old_space space
-    CollectGarbage(stack_top);
+
+    // Give memory of pages that are unused for a while back to OS
+    heap()->page_pool()->Trim();
+  }
+  gc_type(kNone);
+}
+
+
+void GC::CollectGarbage(GCEvent::Type type, char* stack_top, char* frame) {
+  switch (type) {
+    case GCEvent::kMinor:
+      heap()->needs_gc(Heap::kGCNewSpace);
+      CollectGarbage(stack_top, frame);
+      break;
+    case GCEvent::kMajor:
+      {
+        // New space garbage shouldn't keep old objects alive
+        uint32_t major_gcs = stats()->major_gcs;
+        heap()->needs_gc(Heap::kGCNewSpace);
+        CollectGarbage(stack_top, frame);
+
+        // Scavenge may be followed by old space GC (or by the final pause of
+        // incremental marking), otherwise finish or skip marking
+        if (stats()->major_gcs != major_gcs) break;
+        full_gc_ = true;
+        heap()->needs_gc(Heap::kGCOldSpace);
+        CollectGarbage(stack_top, frame);
+        full_gc_ = false;
+      }
+      break;
+    case GCEvent::kMarkingStep:
+      // Start marking (or do full GC if incremental marking is disabled)
+      heap()->needs_gc(is_marking() ? Heap::kGCMarkingStep : Heap::kGCOldSpace);
+      CollectGarbage(stack_top, frame);
+      break;
+    default:
+      UNEXPECTED
+      break;
+  }
+}
+
+
+bool GC::IdleNotification(uint64_t deadline,
+                          char* stack_top,
+                          char* frame) {
+  uint64_t end = GetTimeMicros() + deadline;
+
+  // Pause requested by allocation would happen soon anyway
+  if (heap()->needs_gc() != Heap::kGCNone) CollectGarbage(stack_top, frame);
+
+  // Scavenge when new space is filled by half
+  Space* new_space = heap()->new_space();
+  if (new_space->allocated() >= (new_space->size_limit() >> 1) &&
+      GetTimeMicros() + last_pause_[GCEvent::kMinor] <= end) {
+    CollectGarbage(GCEvent::kMinor, stack_top, frame);
+  }
+
+  // Start marking when old space is halfway to the limit (which is twice
+  // the size left by the last sweep)
+  Space* old_space = heap()->old_space();
+  uint32_t old_threshold = old_space->size_limit() -
+                           (old_space->size_limit() >> 2);
+  if (!is_marking() && old_space->size() > old_threshold) {
+    GCEvent::Type type = marking_step_size() == 0 ?
+        GCEvent::kMajor
+        :
+        GCEvent::kMarkingStep;
+    if (GetTimeMicros() + last_pause_[type] <= end) {
+      CollectGarbage(type, stack_top, frame);
+    }
+  }
+
+  // Continue marking until it's finished or time is over, last step is
+  // followed by the final pause
+  while (is_marking() &&
+         GetTimeMicros() + last_pause_[GCEvent::kMarkingStep] <= end) {
+    CollectGarbage(GCEvent::kMarkingStep, stack_top, frame);
+  }
+
+  old_threshold = old_space->size_limit() - (old_space->size_limit() >> 2);
+  return !is_marking() &&
+         new_space->allocated() < (new_space->size_limit() >> 1) &&
+         old_space->size() <= old_threshold;
+}
+
+
+void GC::EnableLogging() {
+  log_ = true;
+}
+
+
+void GC::DisableLogging() {
+  log_ = false;
+}
+
+
+void GC::StartPause() {
+  memset(&event_, 0, sizeof(event_));
+  pause_start_ = GetTimeMicros();
+  phase_start_ = pause_start_;
+  event_.heap_size_before = heap()->size();
+  bytes_copied_ = 0;
+  bytes_promoted_ = 0;
+}
+
+
+void GC::EndPhase(GCStatistics::Phase phase) {
+  uint64_t now = GetTimeMicros();
+  event_.phase_time[phase] = now - phase_start_;
+  phase_start_ = now;
+}
+
+
+void GC::EndPause(GCEvent::Type type) {
+  event_.type = type;
+  event_.pause = GetTimeMicros() - pause_start_;
+  event_.bytes_copied = bytes_copied_;
+  event_.bytes_promoted = bytes_promoted_;
+  event_.heap_size_after = heap()->size();
+  last_pause_[type] = event_.pause;
+
+  switch (type) {
+    case GCEvent::kMinor: stats_.minor_gcs++; break;
+    case GCEvent::kMajor: stats_.major_gcs++; break;
+    case GCEvent::kMarkingStep: stats_.marking_steps++; break;
+    default: UNEXPECTED break;
+  }
+  stats_.bytes_copied += bytes_copied_;
+  stats_.bytes_promoted += bytes_promoted_;
+  stats_.total_pause += event_.pause;
+  if (event_.pause > stats_.max_pause) stats_.max_pause = event_.pause;
+  Record(stats_.pause_histogram, event_.pause);
+
+  // Marking steps have no phases
+  if (type != GCEvent::kMarkingStep) {
+    for (int i = 0; i < GCStatistics::kPhaseCount; i++) {
+      stats_.phase_time[i] += event_.phase_time[i];
+      Record(stats_.phase_histogram[i], event_.phase_time[i]);
+    }
+  }
+
+  if (log_) {
+    const char* names[] = { "minor", "major", "marking step" };
+    fprintf(stderr,
+            "[gc] %s: %.3fms (roots %.3f, frames %.3f, visit %.3f, "
+            "weak %.3f, swap %.3f), heap %ukb -> %ukb, "
+            "copied %ukb, promoted %ukb\n",
+            names[type],
+            event_.pause / 1000.0,
+            event_.phase_time[GCStatistics::kRoots] / 1000.0,
+            event_.phase_time[GCStatistics::kFrames] / 1000.0,
+            event_.phase_time[GCStatistics::kVisit] / 1000.0,
+            event_.phase_time[GCStatistics::kWeakReferences] / 1000.0,
+            event_.phase_time[GCStatistics::kSwap] / 1000.0,
+            event_.heap_size_before >> 10,
+            event_.heap_size_after >> 10,
+            event_.bytes_copied >> 10,
+            event_.bytes_promoted >> 10);
+  }
+
+  if (trace_handler_ != NULL) trace_handler_(heap(), event_);
+}
+
+
+void GC::Record(uint32_t* histogram, uint64_t time) {
+  int bucket = 0;
+  if (time != 0) {
+    bucket = time >= 0x80000000ULL ? 32 : Log2(time) + 1;
+  }
+  if (bucket >= GCStatistics::kHistogramSize) {
+    bucket = GCStatistics::kHistogramSize - 1;
+  }
+  histogram[bucket]++;
+}
+
+
+void GC::StartMarking(char* stack_top, char* frame) {
+  assert(!is_marking());
+  assert(marking_objects()->length() == 0);
+
+  marking_ = 1;
+  marking_limit_ = heap()->old_space()->size() << 1;
+
+  // Roots will be visited again in the final pause, new space objects
+  // are visited only there
+  gc_type(kIncrementalMarking);
+  ColourPersistentHandles();
+  ColourLocalHandles();
+  ColourFrames(stack_top, frame);
+  gc_type(kNone);
+
+  heap()->needs_gc(Heap::kGCNone);
+
+  if (!concurrent_marking()) return;
+
+  marker_ = new GC(heap());
+  marker_->parent_ = this;
+  marker_->gc_type(kIncrementalMarking);
+  marker_->marking_ = marking_;
+  __atomic_store_n(&marker_paused_, false, __ATOMIC_SEQ_CST);
+  marker_busy_ = false;
+  marker_exit_ = false;
+  if (pthread_create(&marker_thread_, NULL, MarkingThread, marker_)) abort();
+}
+
+
+bool GC::MarkingStep() {
+  assert(gc_type() == kIncrementalMarking);
+
+  // Marking thread is doing all work, pause only checks if it has finished
+  if (marker_ != NULL) {
+    return marking_objects()->length() == 0 &&
+           marker_->marking_objects()->length() == 0;
+  }
+
+  uint32_t visited = 0;
+  while (visited < marking_step_size() && marking_objects()->length() != 0) {
+    HValue* value = marking_objects()->Pop();
+    visited += value->Size();
+    VisitValue(value);
+  }
+
+  return marking_objects()->length() == 0;
+}
+
+
+void GC::MarkValue(HValue* value) {
+  if (value->IsSoftGCMarked()) return;
+
+  // Marking thread may be marking the same value
+  if (!value->TrySetSoftGCMark()) return;
+
+  if (marker_ == NULL) {
+    marking_objects()->Push(value);
+    return;
+  }
+
+  // Pass value to marking thread (and wake it up)
+  pthread_mutex_lock(&marking_lock_);
+  marking_objects()->Push(value);
+  if (!marker_busy_) pthread_cond_broadcast(&marking_cond_);
+  pthread_mutex_unlock(&marking_lock_);
+}
+
+
+void GC::PauseMarker() {
+  pthread_mutex_lock(&marking_lock_);
+  __atomic_store_n(&marker_paused_, true, __ATOMIC_SEQ_CST);
+  while (marker_busy_) pthread_cond_wait(&marking_cond_, &marking_lock_);
+  pthread_mutex_unlock(&marking_lock_);
+}
+
+
+void GC::WaitForMarker() {
+  pthread_mutex_lock(&marking_lock_);
+  while (marker_busy_ ||
+         marking_objects()->length() != 0 ||
+         marker_->marking_objects()->length() != 0) {
+    pthread_cond_wait(&marking_cond_, &marking_lock_);
+  }
+  pthread_mutex_unlock(&marking_lock_);
+}
+
+
+void GC::ResumeMarker() {
+  pthread_mutex_lock(&marking_lock_);
+  __atomic_store_n(&marker_paused_, false, __ATOMIC_SEQ_CST);
+  pthread_cond_broadcast(&marking_cond_);
+  pthread_mutex_unlock(&marking_lock_);
+}
+
+
+void GC::StopMarker() {
+  pthread_mutex_lock(&marking_lock_);
+  __atomic_store_n(&marker_paused_, true, __ATOMIC_SEQ_CST);
+  marker_exit_ = true;
+  pthread_cond_broadcast(&marking_cond_);
+  pthread_mutex_unlock(&marking_lock_);
+
+  pthread_join(marker_thread_, NULL);
+  stats_.bytes_marked_concurrently +=
+      marker_->stats()->bytes_marked_concurrently;
+
+  // Objects that weren't visited by marker will be visited in the pause
+  while (marker_->marking_objects()->length() != 0) {
+    marking_objects()->Push(marker_->marking_objects()->Pop());
   }
+
+  delete marker_;
+  marker_ = NULL;
+}
+
+
+void* GC::MarkingThread(void* marker) {
+  reinterpret_cast<GC*>(marker)->ConcurrentMark();
+  return NULL;
+}
+
+
+void GC::ConcurrentMark() {
+  GC* gc = parent_;
+
+  pthread_mutex_lock(&gc->marking_lock_);
+  while (!gc->marker_exit_) {
+    if (gc->marker_paused() ||
+        (marking_objects()->length() == 0 &&
+         gc->marking_objects()->length() == 0)) {
+      pthread_cond_wait(&gc->marking_cond_, &gc->marking_lock_);
+      continue;
+    }
+
+    // Take objects marked by write barrier
+    while (gc->marking_objects()->length() != 0) {
+      marking_objects()->Push(gc->marking_objects()->Pop());
+    }
+    gc->marker_busy_ = true;
+    pthread_mutex_unlock(&gc->marking_lock_);
+
+    // NOTE: Slots are pointer aligned, so their values can't be torn by
+    // mutator's writes
+    while (!gc->marker_paused() && marking_objects()->length() != 0) {
+      HValue* value = marking_objects()->Pop();
+      stats_.bytes_marked_concurrently += value->Size();
+      VisitValue(value);
+    }
+
+    pthread_mutex_lock(&gc->marking_lock_);
+    gc->marker_busy_ = false;
+    pthread_cond_broadcast(&gc->marking_cond_);
+
+    // Everything was visited - ask mutator for the final pause
+    if (!gc->marker_paused() &&
+        marking_objects()->length() == 0 &&
+        gc->marking_objects()->length() == 0) {
+      __sync_bool_compare_and_swap(
+          reinterpret_cast<intptr_t*>(heap()->needs_gc_addr()),
+          Heap::kGCNone,
+          Heap::kGCMarkingStep);
+    }
+  }
+  pthread_mutex_unlock(&gc->marking_lock_);
 }
 
 
 void GC::ColourPersistentHandles() {
-  HValueRefMap::Item* item = heap()->references()->head();
-  for (; item != NULL; item = item->next_scalar()) {
+  HValueRefMap* references = heap()->references();
+  HValueRefMap::Item* item = references->head();
+  for (; item != NULL; item = references->next(item)) {
     HValueReference* ref = item->value();
     if (ref->is_persistent()) {
-      push_grey(ref->value(), reinterpret_cast<char**>(ref->reference()));
-      push_grey(ref->value(), reinterpret_cast<char**>(ref->valueptr()));
-      ProcessGrey();
+      VisitSlot(reinterpret_cast<char**>(ref->reference()), NULL);
+      VisitSlot(reinterpret_cast<char**>(ref->valueptr()), NULL);
     }
   }
 }
 
 
-void GC::RelocateWeakHandles() {
-  HValueRefMap::Item* item = heap()->references()->head();
-  HValueRefMap::Item* next;
+void GC::ColourLocalHandles() {
+  HandleArena* handles = heap()->handles();
+  for (int i = 0; i <= handles->block(); i++) {
+    char** end = handles->block_end(i);
+    for (char** slot = handles->block_start(i); slot < end; slot++) {
+      VisitSlot(slot, NULL);
+    }
+  }
+}
+
+
+void GC::ColourRememberedSet() {
+  if (gc_type() == kOldSpace) {
+    // Holders marked by incremental marking won't be visited again, but
+    // new space objects referenced by them should be marked too
+    HValueList::Item* item = heap()->remembered_set()->head();
+    for (; item != NULL; item = item->next()) {
+      if (item->value()->IsSoftGCMarked()) VisitValue(item->value());
+    }
+    return;
+  }
+
+  // Holders that will be recorded again during visiting are appended to the
+  // tail of the set, process only those that are present now
+  int32_t count = heap()->remembered_set()->length();
+  while (count-- > 0) {
+    HValue* holder = heap()->remembered_set()->Shift();
+    holder->ResetRemembered();
+
+    VisitValue(holder);
+  }
+}
+
+
+void GC::FilterRememberedSet() {
+  HValueList::Item* item = heap()->remembered_set()->head();
+  HValueList::Item* next;
   for (; item != NULL; item = next) {
+    next = item->next();
+    if (!IsAlive(item->value())) heap()->remembered_set()->Remove(item);
+  }
+}
+
+
+uint32_t GC::ClearDeadTransitions(char* shape) {
+  uint32_t live = 1;
+
+  char* transitions = HShape::Transitions(shape);
+  if (transitions == HNil::New()) return live;
+
+  // Take live transitions out of the table and insert them back (removing
+  // items from the middle would break probe sequences)
+  HMap* map = HValue::As<HMap>(transitions);
+  uint32_t size = map->size();
+  char* keys[HShape::kMaxTransitions];
+  char* targets[HShape::kMaxTransitions];
+  uint32_t count = 0;
+  for (uint32_t i = 0; i < size; i++) {
+    char** slot = map->GetSlotAddress(i);
+    if (*slot == HNil::New()) continue;
+
+    if (HValue::Cast(slot[size])->IsSoftGCMarked()) {
+      keys[count] = slot[0];
+      targets[count] = slot[size];
+      count++;
+    }
+    slot[0] = HNil::New();
+    slot[size] = HNil::New();
+  }
+
+  uint32_t mask = size - 1;
+  for (uint32_t i = 0; i < count; i++) {
+    // Same start slot as in HShape::FindKey, keys are unique
+    uint32_t index = (HString::Hash(heap(), keys[i]) &
+                      (mask * HValue::kPointerSize)) / HValue::kPointerSize;
+    char** slot = map->GetSlotAddress(index);
+    while (*slot != HNil::New()) {
+      index = (index + 1) & mask;
+      slot = map->GetSlotAddress(index);
+    }
+    slot[0] = keys[i];
+    slot[size] = targets[i];
+
+    live += ClearDeadTransitions(targets[i]);
+  }
+
+  *reinterpret_cast<intptr_t*>(shape + HShape::kTransitionCountOffset) = count;
+  if (count == 0) {
+    *HShape::TransitionsSlot(shape) = HNil::New();
+    *reinterpret_cast<intptr_t*>(shape + HShape::kTransitionMaskOffset) = 0;
+  } else if (!map->IsSoftGCMarked()) {
+    // Table isn't visited by marking, keys are alive in targets' tables
+    map->SetSoftGCMark();
+  }
+
+  return live;
+}
+
+
+void GC::RelocateWeakHandles() {
+  HValueRefMap* references = heap()->references();
+  HValueRefMap::Item* item = references->head();
+  for (; item != NULL; item = references->next(item)) {
     HValueReference* ref = item->value();
-    next = item->next_scalar();
 
     if (ref->is_weak()) {
-      GCValue* v;
-
       // Skip ICs zap values and everything unboxed
       if (HValue::IsUnboxed(reinterpret_cast<char*>(ref->value()))) continue;
 
-      if (ref->value()->IsGCMarked()) {
-        v = new GCValue(ref->value(),
-                        reinterpret_cast<char**>(ref->reference()));
-        v->Relocate(v->value()->GetGCMark());
-        v = new GCValue(ref->value(),
-                        reinterpret_cast<char**>(ref->valueptr()));
-        v->Relocate(v->value()->GetGCMark());
-      } else {
-        // Value was garbage collected - remove reference from the list
-        heap()->references()->RemoveOne(item->key());
+      if (!IsAlive(ref->value())) {
+        // Value was garbage collected - zap slot (memory may be reused, ICs
+        // shouldn't match it) and remove reference from the list
+        *reinterpret_cast<intptr_t*>(ref->reference()) = Heap::kICZapValue;
+        references->RemoveOne(item->key());
+      } else if (ref->value()->IsGCMarked()) {
+        char* addr = ref->value()->GetGCMark();
+        *reinterpret_cast<char**>(ref->reference()) = addr;
+        *reinterpret_cast<char**>(ref->valueptr()) = addr;
       }
     }
   }
 }
 
 
-void GC::ColourFrames(char* stack_top) {
-  // Go through the frames
-  char** frame = reinterpret_cast<char**>(stack_top);
-  while (frame != NULL) {
-    // Skip C++ frames
-    while (frame != NULL &&
-           static_cast<uint32_t>(reinterpret_cast<intptr_t>(*frame)) ==
-               Heap::kEnterFrameTag) {
-      frame = reinterpret_cast<char**>(*(frame + 1));
-    }
-    if (frame == NULL) break;
+void GC::ColourFrames(char* stack_top, char* frame) {
+  // Compiled frames are visited using safepoints, dead slots are cleared
+  FrameIterator it(heap(), stack_top, frame, true);
 
-    char* value = *frame;
-    // Skip nil, non-pointer values and rbp pushes
-    if (value != HNil::New() && !HValue::IsUnboxed(value)) {
-      push_grey(HValue::Cast(value), frame);
-      ProcessGrey();
-    }
-
-    frame++;
+  char** slot;
+  while ((slot = it.Next()) != NULL) {
+    // Nil and non-pointer values are skipped in VisitSlot
+    VisitSlot(slot, NULL);
   }
 }
 
 
 void GC::HandleWeakReferences() {
-  HValueWeakRefMap::Item* item = heap()->weak_references()->head();
-  HValueWeakRefMap::Item* next;
-  for (; item != NULL; item = next) {
+  // Map is keyed by value, dead and moved references are taken out of it
+  // first, callbacks may add or remove weak references
+  HValueWeakRefMap* weak_references = heap()->weak_references();
+  HValueWeakRefList dead;
+  HValueWeakRefList moved;
+  HValueWeakRefMap::Item* item = weak_references->head();
+  for (; item != NULL; item = weak_references->next(item)) {
     HValueWeakRef* ref = item->value();
-    next = item->next_scalar();
-
-    if (!ref->value()->IsGCMarked()) {
-      if (IsInCurrentSpace(ref->value())) {
-        // Value is in GC space and wasn't marked
-        // call callback as it was GCed
-        ref->callback()(ref->value());
-        heap()->weak_references()->RemoveOne(item->key());
-      }
-    } else {
+
+    if (!IsAlive(ref->value())) {
+      // Value is in GC space and wasn't marked
+      dead.Push(weak_references->Take(item->key()));
+    } else if (ref->value()->IsGCMarked()) {
       // Value wasn't GCed, but was moved
-      ref->value(reinterpret_cast<HValue*>(ref->value()->GetGCMark()));
+      moved.Push(weak_references->Take(item->key()));
     }
   }
 
-  while (weak_items()->length() != 0) {
-    GCValue* value = weak_items()->Shift();
+  HValueWeakRef* ref;
+  while ((ref = moved.Shift()) != NULL) {
+    ref->value(reinterpret_cast<HValue*>(ref->value()->GetGCMark()));
+    weak_references->Set(NumberKey::New(ref->value()), ref);
+  }
 
-    // Skip ICs zap values and everything unboxed
-    if (HValue::IsUnboxed(reinterpret_cast<char*>(value->value()))) continue;
+  // Call callbacks as values were GCed
+  while ((ref = dead.Shift()) != NULL) {
+    ref->callback()(ref->value());
+    delete ref;
+  }
+}
 
-    if (!value->value()->IsGCMarked()) {
-      if (IsInCurrentSpace(value->value())) {
-        // Value was GCed
-        value->Relocate(NULL);
-      }
-    } else {
-      // Value wasn't GCed, but was relocated
-      value->Relocate(value->value()->GetGCMark());
+
+void GC::ProcessGrey() {
+  do {
+    while (grey_objects()->length() != 0) {
+      VisitValue(grey_objects()->Pop());
+    }
+  } while ((tmp_space() != NULL && ScanSpace(tmp_space())) ||
+           grey_objects()->length() != 0);
+}
+
+
+void GC::ParallelScavenge() {
+  uint32_t count = scavenger_threads();
+
+  workers_ = new GC*[count];
+  for (uint32_t i = 0; i < count; i++) {
+    GC* worker = new GC(heap());
+    worker->parent_ = this;
+    worker->gc_type(gc_type());
+    worker->tmp_space(tmp_space());
+    worker->marking_ = marking_;
+    workers_[i] = worker;
+  }
+  idle_workers_ = 0;
+
+  // Distribute objects evacuated from roots between workers
+  uint32_t index = 0;
+  Space::PageList::Item* item = tmp_space()->pages()->head();
+  for (; item != NULL; item = item->next()) {
+    Space::Page* page = item->value();
+
+    while (page->scan_ < page->top_) {
+      HValue* value = HValue::Cast(page->scan_);
+      page->scan_ += RoundUp(value->Size(), HValue::kPointerSize);
+      workers_[index++ % count]->grey_objects()->Push(value);
+    }
+  }
+  while (grey_objects()->length() != 0) {
+    workers_[index++ % count]->grey_objects()->Push(grey_objects()->Pop());
+  }
+  for (uint32_t i = 0; i < count; i++) {
+    workers_[i]->shared_grey_ = workers_[i]->grey_objects()->length();
+  }
+
+  // Current thread is a worker too
+  pthread_t* threads = new pthread_t[count - 1];
+  for (uint32_t i = 1; i < count; i++) {
+    if (pthread_create(&threads[i - 1], NULL, ScavengeThread, workers_[i])) {
+      abort();
     }
   }
+  workers_[0]->Scavenge();
+  for (uint32_t i = 1; i < count; i++) {
+    pthread_join(threads[i - 1], NULL);
+  }
+  delete[] threads;
+
+  // Collect workers' results
+  for (uint32_t i = 0; i < count; i++) {
+    GC* worker = workers_[i];
+
+    worker->CloseLocal(tmp_space(), &worker->new_buffer_);
+    worker->CloseLocal(heap()->old_space(), &worker->old_buffer_);
+
+    while (worker->marking_objects()->length() != 0) {
+      marking_objects()->Push(worker->marking_objects()->Pop());
+    }
+    while (worker->remembered_set_.length() != 0) {
+      heap()->remembered_set()->Push(worker->remembered_set_.Shift());
+    }
+    bytes_copied_ += worker->bytes_copied_;
+    bytes_promoted_ += worker->bytes_promoted_;
+
+    delete worker;
+  }
+  delete[] workers_;
+  workers_ = NULL;
 }
 
 
-void GC::ProcessGrey() {
-  while (grey_items()->length() != 0) {
-    GCValue* value = grey_items()->Shift();
+void* GC::ScavengeThread(void* worker) {
+  reinterpret_cast<GC*>(worker)->Scavenge();
+  return NULL;
+}
+
+
+void GC::Scavenge() {
+  int32_t count = parent_->scavenger_threads();
+  int32_t* idle = &parent_->idle_workers_;
 
-    // Skip unboxed address
-    if (value->value() == HValue::Cast(HNil::New()) ||
-        HValue::IsUnboxed(value->value()->addr())) {
+  while (true) {
+    HValue* value = PopGrey();
+    if (value == NULL) value = StealGrey();
+    if (value != NULL) {
+      VisitValue(value);
       continue;
     }
 
-    if (!value->value()->IsGCMarked()) {
-      // Object is in not in current space, don't move it
-      if (!IsInCurrentSpace(value->value())) {
-        if (!value->value()->IsSoftGCMarked()) {
-          // Set soft mark and add item to black list to reset mark later
-          value->value()->SetSoftGCMark();
-          black_items()->Push(value);
+    // Nothing to do: finish when all workers are idle, or resume
+    // if someone has published more objects.
+    // NOTE: Increment is sequentially consistent with publisher's update of
+    // its grey count, so either we see published objects, or publisher sees
+    // us idle and wakes us up
+    pthread_mutex_lock(&parent_->idle_lock_);
+    __atomic_add_fetch(idle, 1, __ATOMIC_SEQ_CST);
+    while (true) {
+      if (__atomic_load_n(idle, __ATOMIC_SEQ_CST) == count) {
+        pthread_cond_broadcast(&parent_->idle_cond_);
+        pthread_mutex_unlock(&parent_->idle_lock_);
+        return;
+      }
 
-          GC::VisitValue(value->value());
-        }
-        continue;
+      bool has_work = false;
+      for (int32_t i = 0; !has_work && i < count; i++) {
+        has_work = parent_->workers_[i]->shared_grey() != 0;
       }
-      assert(!value->value()->IsSoftGCMarked());
+      if (has_work) break;
 
-      HValue* hvalue;
+      pthread_cond_wait(&parent_->idle_cond_, &parent_->idle_lock_);
+    }
+    __atomic_sub_fetch(idle, 1, __ATOMIC_SEQ_CST);
+    pthread_mutex_unlock(&parent_->idle_lock_);
+  }
+}
 
-      if (gc_type() == kNewSpace) {
-        // New space GC
-        hvalue = value->value()->CopyTo(heap()->old_space(), tmp_space());
-      } else {
-        // Old space GC
-        hvalue = value->value()->CopyTo(tmp_space(), heap()->new_space());
-      }
 
-      value->Relocate(hvalue->addr());
-      GC::VisitValue(hvalue);
+void GC::PushGrey(HValue* value) {
+  local_grey_objects_.Push(value);
+
+  // Share part of work with others if they have stolen everything
+  if (local_grey_objects_.length() < static_cast<int32_t>(kPublishSize) ||
+      shared_grey() != 0) {
+    return;
+  }
+
+  pthread_mutex_lock(&grey_lock_);
+  for (uint32_t i = 0; i < kPublishSize / 2; i++) {
+    grey_objects()->Push(local_grey_objects_.Pop());
+  }
+  __atomic_store_n(&shared_grey_, grey_objects()->length(), __ATOMIC_SEQ_CST);
+  pthread_mutex_unlock(&grey_lock_);
+
+  // Wake up idle workers
+  if (__atomic_load_n(&parent_->idle_workers_, __ATOMIC_SEQ_CST) != 0) {
+    pthread_mutex_lock(&parent_->idle_lock_);
+    pthread_cond_broadcast(&parent_->idle_cond_);
+    pthread_mutex_unlock(&parent_->idle_lock_);
+  }
+}
+
+
+HValue* GC::PopGrey() {
+  if (local_grey_objects_.length() != 0) return local_grey_objects_.Pop();
+  if (shared_grey() == 0) return NULL;
+
+  pthread_mutex_lock(&grey_lock_);
+  HValue* value = grey_objects()->Pop();
+  __atomic_store_n(&shared_grey_, grey_objects()->length(), __ATOMIC_SEQ_CST);
+  pthread_mutex_unlock(&grey_lock_);
+
+  return value;
+}
+
+
+HValue* GC::StealGrey() {
+  uint32_t count = parent_->scavenger_threads();
+
+  // Take half of other worker's shared objects
+  for (uint32_t i = 0; i < count; i++) {
+    GC* victim = parent_->workers_[i];
+    if (victim == this || victim->shared_grey() == 0) continue;
+
+    pthread_mutex_lock(&victim->grey_lock_);
+    HValueStack* grey = victim->grey_objects();
+    int32_t steal = (grey->length() + 1) >> 1;
+    while (steal-- > 0) {
+      local_grey_objects_.Push(grey->Pop());
+    }
+    __atomic_store_n(&victim->shared_grey_, grey->length(), __ATOMIC_SEQ_CST);
+    pthread_mutex_unlock(&victim->grey_lock_);
+
+    if (local_grey_objects_.length() != 0) return local_grey_objects_.Pop();
+  }
+
+  return NULL;
+}
+
+
+char* GC::Evacuate(HValue* value) {
+  // NOTE: Headers aren't aligned, so only mark byte is updated atomically
+  // (locked operation on word crossing cache line is very slow)
+  volatile uint8_t* mark = reinterpret_cast<uint8_t*>(
+      value->addr() + HValue::kGCMarkOffset);
+
+  // Only one thread may copy value, others are waiting for it
+  while (true) {
+    uint8_t qmark = *mark;
+    if ((qmark & 0x80) != 0) {
+      __sync_synchronize();
+      return value->GetGCMark();
+    }
+    if ((qmark & HValue::kBusyMark) != 0) {
+      sched_yield();
+      continue;
+    }
+    if (value->Generation() >= Heap::kMinOldSpaceGeneration) return NULL;
+
+    uint8_t busy = qmark | HValue::kBusyMark;
+    if (__sync_bool_compare_and_swap(mark, qmark, busy)) break;
+  }
+
+  // Large objects aren't copied, they're promoted in place
+  if (value->IsLarge()) {
+    pthread_mutex_lock(&parent_->space_lock_);
+    heap()->large_space()->Promote(value);
+    pthread_mutex_unlock(&parent_->space_lock_);
+    bytes_promoted_ += value->Size();
+
+    if (is_marking()) MarkValue(value);
+    PushGrey(value);
+
+    // Value may be already visited (and remembered) by other thread
+    __sync_synchronize();
+    __sync_fetch_and_and(mark, ~HValue::kBusyMark);
+
+    return value->addr();
+  }
+
+  RecordSurvivor(value);
+
+  // NOTE: Original's generation isn't changed, other threads are using it
+  uint32_t size = value->Size();
+  uint8_t generation = value->Generation() + 1;
+  if (generation >= heap()->tenure_generation()) {
+    generation = Heap::kMinOldSpaceGeneration;
+  }
+
+  char* result;
+  if (generation >= Heap::kMinOldSpaceGeneration) {
+    result = AllocateLocal(heap()->old_space(), &old_buffer_, size);
+    bytes_promoted_ += size;
+  } else {
+    result = AllocateLocal(tmp_space(), &new_buffer_, size);
+    bytes_copied_ += size;
+  }
+  memcpy(result + HValue::kTagOffset, value->addr() + HValue::kTagOffset, size);
+
+  HValue* hresult = HValue::Cast(result);
+  *reinterpret_cast<uint8_t*>(result + HValue::kGCMarkOffset) &=
+      ~HValue::kBusyMark;
+  *reinterpret_cast<uint8_t*>(result + HValue::kGenerationOffset) = generation;
+
+  // Promoted objects should survive incremental marking
+  if (generation >= Heap::kMinOldSpaceGeneration && is_marking()) {
+    MarkValue(hresult);
+  }
+  PushGrey(hresult);
+
+  // Publish new address (it should be visible before the mark)
+  *reinterpret_cast<char**>(value->addr() + HValue::kGCForwardOffset) = result;
+  __sync_synchronize();
+  *mark = (*mark | 0x80) & ~HValue::kBusyMark;
+
+  return result;
+}
+
+
+void GC::RecordSurvivor(HValue* value) {
+  // Only literals have site index in their header
+  if (value->tag() != Heap::kTagObject && value->tag() != Heap::kTagArray) {
+    return;
+  }
+
+  // Only first survival is interesting
+  uint16_t index = value->AllocationSiteIndex();
+  if (index == 0 || value->Generation() != 0) return;
+
+  AllocationSite* site = heap()->allocation_site(index);
+  if (site == NULL) return;
+  if (is_worker()) {
+    __sync_fetch_and_add(&site->survived_, 1);
+  } else {
+    site->survived_++;
+  }
+}
+
+
+char* GC::AllocateLocal(Space* space, LocalBuffer* buffer, uint32_t bytes) {
+  uint32_t aligned_bytes = RoundUp(bytes, HValue::kPointerSize);
+
+  if (buffer->top_ == NULL || buffer->top_ + aligned_bytes > buffer->limit_) {
+    pthread_mutex_lock(&parent_->space_lock_);
+
+    // Big objects are allocated directly in space
+    if (aligned_bytes > kLocalBufferSize / 4) {
+      char* result = space->Allocate(aligned_bytes);
+      pthread_mutex_unlock(&parent_->space_lock_);
+      return result;
+    }
+
+    CloseLocal(space, buffer);
+    buffer->top_ = space->Allocate(kLocalBufferSize);
+    buffer->limit_ = buffer->top_ + kLocalBufferSize;
+
+    pthread_mutex_unlock(&parent_->space_lock_);
+  }
+
+  char* result = buffer->top_;
+  buffer->top_ += aligned_bytes;
+
+  return result;
+}
+
+
+void GC::CloseLocal(Space* space, LocalBuffer* buffer) {
+  if (buffer->top_ == NULL) return;
+
+  space->AddFiller(buffer->top_, buffer->limit_ - buffer->top_);
+  buffer->top_ = NULL;
+  buffer->limit_ = NULL;
+}
+
+
+void GC::RecordWriteLocal(HValue* holder, char* value) {
+  // Same as Heap::RecordWrite(), but holders are collected locally
+  // (promoted values are already marked by Evacuate())
+  if (holder->Generation() < Heap::kMinOldSpaceGeneration) return;
+  if (HValue::Cast(value)->Generation() >= Heap::kMinOldSpaceGeneration) {
+    return;
+  }
+  if (holder->IsRemembered()) return;
+
+  holder->SetRemembered();
+  remembered_set_.Push(holder);
+}
+
+
+bool GC::ScanSpace(Space* space) {
+  bool visited = false;
+
+  // NOTE: Visiting objects may add pages to the end of the list,
+  // or fill gaps in previous pages
+  Space::PageList::Item* item = space->pages()->head();
+  for (; item != NULL; item = item->next()) {
+    Space::Page* page = item->value();
+
+    while (page->scan_ < page->top_) {
+      HValue* value = HValue::Cast(page->scan_);
+      page->scan_ += RoundUp(value->Size(), HValue::kPointerSize);
+
+      VisitValue(value);
+      visited = true;
+    }
+  }
+
+  return visited;
+}
+
+
+void GC::VisitSlot(char** slot, HValue* holder) {
+  char* addr = *slot;
+
+  // Skip unboxed address
+  if (addr == HNil::New() || HValue::IsUnboxed(addr)) return;
+
+  HValue* value = HValue::Cast(addr);
+
+  // Old space GC doesn't move objects, only marks them
+  if (gc_type() == kIncrementalMarking) {
+    // New space objects may move between steps,
+    // they're visited in the final pause
+    if (IsInCurrentSpace(value)) MarkValue(value);
+    return;
+  } else if (gc_type() == kOldSpace) {
+    if (!value->IsSoftGCMarked()) {
+      value->SetSoftGCMark();
+      grey_objects()->Push(value);
+
+      // Marks of old space objects are reset by sweeping,
+      // add others to black list to reset mark later
+      if (!IsInCurrentSpace(value)) black_items()->Push(value);
+    }
+    return;
+  }
+
+  // Parallel scavenge worker
+  if (is_worker()) {
+    char* result = Evacuate(value);
+    if (result == NULL) return;
+
+    *slot = result;
+    if (holder != NULL) RecordWriteLocal(holder, result);
+    return;
+  }
+
+  if (value->IsGCMarked()) {
+    *slot = value->GetGCMark();
+  } else if (!IsInCurrentSpace(value)) {
+    // Old objects referencing new space are in the remembered set,
+    // no need to visit them during new space GC
+    return;
+  } else if (value->IsLarge()) {
+    // Large objects aren't copied, they're promoted in place
+    heap()->large_space()->Promote(value);
+    grey_objects()->Push(value);
+    if (is_marking()) MarkValue(value);
+    bytes_promoted_ += value->Size();
+  } else {
+    RecordSurvivor(value);
+    HValue* hvalue = value->CopyTo(heap()->old_space(), tmp_space());
+
+    // Promoted objects won't be reached by scan
+    if (hvalue->Generation() >= Heap::kMinOldSpaceGeneration) {
+      grey_objects()->Push(hvalue);
+
+      // And they should survive incremental marking
+      if (is_marking()) MarkValue(hvalue);
+      bytes_promoted_ += hvalue->Size();
     } else {
-      value->Relocate(value->value()->GetGCMark());
+      bytes_copied_ += hvalue->Size();
     }
+
+    value->SetGCMark(hvalue->addr());
+    *slot = hvalue->addr();
+  }
+
+  if (holder != NULL) heap()->RecordWrite(holder->addr(), *slot);
+}
+
+
+bool GC::IsAlive(HValue* value) {
+  if (!IsInCurrentSpace(value)) return true;
+
+  if (gc_type() == kNewSpace) {
+    return value->IsGCMarked();
+  } else {
+    return value->IsSoftGCMarked();
   }
 }
 
 
 bool GC::IsInCurrentSpace(HValue* value) {
-  return (gc_type() == kOldSpace &&
-         value->Generation() >= Heap::kMinOldSpaceGeneration) ||
+  return ((gc_type() == kOldSpace || gc_type() == kIncrementalMarking) &&
+          value->Generation() >= Heap::kMinOldSpaceGeneration) ||
          (gc_type() == kNewSpace &&
-         value->Generation() < Heap::kMinOldSpaceGeneration);
+          value->Generation() < Heap::kMinOldSpaceGeneration);
 }
 
 
@@ -267,12 +1249,14 @@ void GC::VisitValue(HValue* value) {
       return VisitArray(value->As<HArray>());
     case Heap::kTagMap:
       return VisitMap(value->As<HMap>());
+    case Heap::kTagShape:
+      return VisitShape(value->As<HShape>());
 
       // non-cons strings and numbers ain't referencing anyone
     case Heap::kTagString:
       {
         HString::Representation r;
-        r = HValue::GetRepresentation<HString::Representation>(value->addr());
+        r = HString::Repr(value->addr());
         switch (r) {
           case HString::kNormal:
             break;
@@ -292,13 +1276,13 @@ void GC::VisitValue(HValue* value) {
 
 void GC::VisitContext(HContext* context) {
   if (context->has_parent()) {
-    push_grey(HValue::Cast(context->parent()), context->parent_slot());
+    VisitSlot(context->parent_slot(), context);
   }
 
   for (uint32_t i = 0; i < context->slots(); i++) {
     if (!context->HasSlot(i)) continue;
 
-    push_grey(context->GetSlot(i), context->GetSlotAddress(i));
+    VisitSlot(context->GetSlotAddress(i), context);
   }
 }
 
@@ -306,25 +1290,24 @@ void GC::VisitContext(HContext* context) {
 void GC::VisitFunction(HFunction* fn) {
   if (fn->parent_slot() != NULL &&
       fn->parent() != reinterpret_cast<char*>(Heap::kBindingContextTag)) {
-    push_grey(HValue::Cast(fn->parent()), fn->parent_slot());
+    VisitSlot(fn->parent_slot(), fn);
   }
   if (fn->root_slot() != NULL) {
-    push_grey(HValue::Cast(fn->root()), fn->root_slot());
+    VisitSlot(fn->root_slot(), fn);
   }
 }
 
 
 void GC::VisitObject(HObject* obj) {
-  if (obj->proto() != NULL) {
-    push_weak(HValue::Cast(obj->proto()), obj->proto_slot());
-  }
+  VisitSlot(obj->map_slot(), obj);
 
-  push_grey(HValue::Cast(obj->map()), obj->map_slot());
+  // Shape (dictionary mode marker is unboxed and is skipped)
+  VisitSlot(obj->proto_slot(), obj);
 }
 
 
 void GC::VisitArray(HArray* arr) {
-  push_grey(HValue::Cast(arr->map()), arr->map_slot());
+  VisitSlot(arr->map_slot(), arr);
 }
 
 
@@ -334,16 +1317,21 @@ void GC::VisitMap(HMap* map) {
   for (uint32_t i = 0; i < size; i++) {
     if (map->IsEmptySlot(i)) continue;
 
-    push_grey(map->GetSlot(i), map->GetSlotAddress(i));
+    VisitSlot(map->GetSlotAddress(i), map);
   }
 }
 
 
+void GC::VisitShape(HShape* shape) {
+  // Transitions are weak (see ClearDeadTransitions)
+  VisitSlot(shape->table_slot(), shape);
+  VisitSlot(shape->parent_slot(), shape);
+}
+
+
 void GC::VisitString(HValue* value) {
-  push_grey(HValue::Cast(HString::LeftCons(value->addr())),
-            HString::LeftConsSlot(value->addr()));
-  push_grey(HValue::Cast(HString::RightCons(value->addr())),
-            HString::RightConsSlot(value->addr()));
+  VisitSlot(HString::LeftConsSlot(value->addr()), value);
+  VisitSlot(HString::RightConsSlot(value->addr()), value);
 }
 
 }  // namespace internal
@@ -23,7 +23,11 @@
 #ifndef _SRC_GC_H_
 #define _SRC_GC_H_
 
-#include "zone.h"  // ZoneObject
+#include <stdint.h>  // uint32_t
+#include <unistd.h>  // intptr_t
+#include <pthread.h>  // pthread_mutex_t
+
+#include "candor.h"  // GCStatistics, GCEvent
 #include "utils.h"  // List
 
 namespace candor {
@@ -38,65 +42,145 @@ class HFunction;
 class HObject;
 class HArray;
 class HMap;
+class HShape;
+
+typedef GenericList<HValue*, EmptyClass, NopPolicy> HValueList;
 
+// Mark stacks are only pushed and popped, order of visiting doesn't matter
+typedef SegmentedStack<HValue*> HValueStack;
+
+// New space is collected by copying: roots (handles, frames and remembered
+// set) are evacuated first, after that objects copied into the temporary
+// space are visited sequentially using a scan pointer (Cheney's algorithm),
+// so no per-edge allocations are needed. Only objects that are not placed
+// into the temporary space (promoted to the old space) are pushed to
+// `grey_objects_`.
+//
+// Old space is collected by marking reachable objects in place (using soft
+// marks) and sweeping dead ones into the space's free list.
+//
+// New space GC may be parallel: after roots are evacuated, reachable objects
+// are copied by worker threads (each one is a GC instance). Workers allocate
+// copies in their own local buffers, install forwarding addresses atomically
+// and steal objects to visit from each other's shared grey stacks.
+//
+// Marking may be incremental: it is started instead of stop-the-world old
+// space GC and is performed in steps of limited size (in bytes) on the
+// allocation slow path. Write barrier marks old values that are stored in old
+// objects while marking is in progress, new space objects are visited only in
+// the final pause (together with roots).
+//
+// Marking may be concurrent too: steps are performed by a background thread
+// (one more GC instance) while mutator is running. Barrier-marked objects are
+// passed to it through the locked `marking_objects_` stack, and the thread is
+// paused during every GC pause. When everything is visited it requests a
+// step, and the final pause remarks frames, handles and remembered set.
 class GC {
  public:
-  class GCValue : public ZoneObject {
+  enum GCType {
+    kNone,
+    kOldSpace,
+    kNewSpace,
+    kIncrementalMarking
+  };
+
+  // Default amount of bytes to mark in one step
+  static const uint32_t kDefaultMarkingStepSize = 256 * 1024;
+
+  // Size of chunk that parallel GC thread allocates copies in
+  static const uint32_t kLocalBufferSize = 32 * 1024;
+
+  // Parallel GC thread shares half of its objects when it has kPublishSize
+  // of them and its shared stack is empty
+  static const uint32_t kPublishSize = 64;
+
+  // Memory in space that is used by only one thread
+  class LocalBuffer {
    public:
-    GCValue(HValue* value, char** slot) : value_(value), slot_(slot) {
+    LocalBuffer() : top_(NULL), limit_(NULL) {
     }
 
-    void Relocate(char* address);
+    char* top_;
+    char* limit_;
+  };
 
-    inline HValue* value() { return value_; }
+  // Invoked after every pause
+  typedef void (*TraceHandler)(Heap* heap, const GCEvent& event);
 
-   protected:
-    HValue* value_;
-    char** slot_;
-  };
+  explicit GC(Heap* heap);
+  ~GC();
 
-  enum GCType {
-    kNone,
-    kOldSpace,
-    kNewSpace
-  };
+  // `stack_top` and `frame` are stack and frame pointers of the innermost
+  // candor frame (see FrameIterator)
+  void CollectGarbage(char* stack_top, char* frame);
 
-  typedef ZoneList<GCValue*> GCList;
+  // Pause requested outside of allocation (see Isolate::CollectGarbage)
+  void CollectGarbage(GCEvent::Type type, char* stack_top, char* frame);
 
-  explicit GC(Heap* heap) : heap_(heap), gc_type_(kNone) {
-  }
+  // Perform pauses that are expected to fit into `deadline` microseconds
+  // (estimated by the last pauses of the same type), returns true if
+  // there's nothing worth collecting
+  bool IdleNotification(uint64_t deadline, char* stack_top, char* frame);
+
+  // Incremental marking, step returns true if there's nothing left to visit
+  void StartMarking(char* stack_top, char* frame);
+  bool MarkingStep();
 
-  void CollectGarbage(char* stack_top);
+  // Marking write barrier (and promotion while marking)
+  void MarkValue(HValue* value);
+
+  // Background marking thread is paused for any GC pause,
+  // and stopped before the final one
+  void PauseMarker();
+  void ResumeMarker();
+  void StopMarker();
+
+  // Block until marking thread has visited everything it was given
+  void WaitForMarker();
 
   void ColourPersistentHandles();
+  void ColourLocalHandles();
   void RelocateWeakHandles();
 
-  void ColourFrames(char* stack_top);
+  void ColourFrames(char* stack_top, char* frame);
+  void ColourRememberedSet();
+  void FilterRememberedSet();
   void HandleWeakReferences();
 
+  // Remove transitions to dead shapes from the tree starting at `shape`
+  // (old space GC), returns number of live shapes in it
+  uint32_t ClearDeadTransitions(char* shape);
+
+  // Visit all reachable objects
   void ProcessGrey();
 
+  // Visit all reachable objects using worker threads (new space only)
+  void ParallelScavenge();
+
+  // Visit objects that were copied into space since last scan,
+  // returns true if at least one object was visited
+  bool ScanSpace(Space* space);
+
+  // Evacuate value referenced by slot and update slot
+  // (holder is NULL for stack and handles)
+  void VisitSlot(char** slot, HValue* holder);
+
   void VisitValue(HValue* value);
   void VisitContext(HContext* context);
   void VisitFunction(HFunction* fn);
   void VisitObject(HObject* obj);
   void VisitArray(HArray* arr);
   void VisitMap(HMap* map);
+  void VisitShape(HShape* shape);
   void VisitString(HValue* value);
 
   bool IsInCurrentSpace(HValue* value);
 
-  inline void push_grey(HValue* value, char** reference) {
-    grey_items()->Push(new GCValue(value, reference));
-  }
+  // False if value is in current space and wasn't reached by GC
+  bool IsAlive(HValue* value);
 
-  inline void push_weak(HValue* value, char** reference) {
-    weak_items()->Push(new GCValue(value, reference));
-  }
-
-  inline GCList* grey_items() { return &grey_items_; }
-  inline GCList* weak_items() { return &weak_items_; }
-  inline GCList* black_items() { return &black_items_; }
+  inline HValueStack* grey_objects() { return &grey_objects_; }
+  inline HValueStack* black_items() { return &black_items_; }
   inline Heap* heap() { return heap_; }
   inline void tmp_space(Space* space) { tmp_space_ = space; }
   inline Space* tmp_space() { return tmp_space_; }
@@ -104,14 +188,147 @@ class GC {
   inline GCType gc_type() { return gc_type_; }
   inline void gc_type(GCType value) { gc_type_ = value; }
 
+  inline bool is_marking() { return marking_ != 0; }
+  inline intptr_t* marking_addr() { return &marking_; }
+  inline HValueStack* marking_objects() { return &marking_objects_; }
+
+  // Zero step size disables incremental marking
+  inline uint32_t marking_step_size() { return marking_step_size_; }
+  inline void marking_step_size(uint32_t size) { marking_step_size_ = size; }
+
+  // One thread means that new space GC isn't parallel
+  inline uint32_t scavenger_threads() { return scavenger_threads_; }
+  inline void scavenger_threads(uint32_t threads) {
+    scavenger_threads_ = threads == 0 ? 1 : threads;
+  }
+  inline bool is_worker() { return parent_ != NULL; }
+
+  // Perform incremental marking steps in background thread
+  inline bool concurrent_marking() { return concurrent_marking_; }
+  inline void concurrent_marking(bool value) { concurrent_marking_ = value; }
+
+  // Let marking thread finish its work before every pause (for tests, work
+  // done by marker doesn't depend on thread scheduling then)
+  inline void wait_for_marker(bool value) { wait_for_marker_ = value; }
+
+  inline GCStatistics* stats() { return &stats_; }
+  inline void trace_handler(TraceHandler handler) { trace_handler_ = handler; }
+
+  static void EnableLogging();
+  static void DisableLogging();
+
  protected:
-  GCList grey_items_;
-  GCList weak_items_;
-  GCList black_items_;
+  // Parallel scavenge worker's routines
+  static void* ScavengeThread(void* worker);
+  void Scavenge();
+  void PushGrey(HValue* value);
+  HValue* PopGrey();
+  HValue* StealGrey();
+  inline int32_t shared_grey() {
+    return __atomic_load_n(&shared_grey_, __ATOMIC_SEQ_CST);
+  }
+
+  // Copy value or return its new address (NULL for old values)
+  char* Evacuate(HValue* value);
+
+  // Allocation site feedback (for pretenuring)
+  void RecordSurvivor(HValue* value);
+  char* AllocateLocal(Space* space, LocalBuffer* buffer, uint32_t bytes);
+  void CloseLocal(Space* space, LocalBuffer* buffer);
+  void RecordWriteLocal(HValue* holder, char* value);
+
+  // Concurrent marker's routines
+  static void* MarkingThread(void* marker);
+  void ConcurrentMark();
+  inline bool marker_paused() {
+    return __atomic_load_n(&marker_paused_, __ATOMIC_SEQ_CST);
+  }
+
+  // Pause accounting: phases are measured sequentially, each one ends where
+  // the next one starts
+  void StartPause();
+  void EndPhase(GCStatistics::Phase phase);
+  void EndPause(GCEvent::Type type);
+  static void Record(uint32_t* histogram, uint64_t time);
+
+  // Objects that are out of temporary space and wasn't visited yet
+  HValueStack grey_objects_;
+
+  // Soft marked objects (their marks should be reset after GC)
+  HValueStack black_items_;
+
+  // Marked, but not yet visited old objects
+  // (they are kept between incremental marking steps)
+  HValueStack marking_objects_;
+
   Heap* heap_;
   Space* tmp_space_;
 
   GCType gc_type_;
+
+  // Non-zero while incremental marking is in progress (checked by generated
+  // code's write barrier)
+  intptr_t marking_;
+
+  // Old space size at which marking is finished without waiting for steps
+  uint32_t marking_limit_;
+
+  // Old space GC isn't replaced by incremental marking (explicit full GC)
+  bool full_gc_;
+  uint32_t marking_step_size_;
+
+  uint32_t scavenger_threads_;
+
+  // Concurrent marking: marker's state is protected by `marking_lock_`,
+  // `marker_paused_` is also read without it by marking thread (so all
+  // accesses to it are atomic)
+  bool concurrent_marking_;
+  GC* marker_;
+  pthread_t marker_thread_;
+  bool marker_paused_;
+  bool marker_busy_;
+  bool marker_exit_;
+  bool wait_for_marker_;
+  pthread_mutex_t marking_lock_;
+  pthread_cond_t marking_cond_;
+
+  // Parallel scavenge: state shared by all workers lives in parent
+  GC* parent_;
+  GC** workers_;
+
+  // Modified under `idle_lock_`, but read without it by publishing workers
+  // (so all accesses are atomic)
+  int32_t idle_workers_;
+
+  // Length of `grey_objects_`: the stack itself is accessed under
+  // `grey_lock_`, count is read without locking by idle and stealing workers
+  int32_t shared_grey_;
+  pthread_mutex_t grey_lock_;
+  pthread_mutex_t space_lock_;
+  pthread_mutex_t idle_lock_;
+  pthread_cond_t idle_cond_;
+
+  // Worker's objects that can't be stolen by others
+  HValueStack local_grey_objects_;
+
+  // Worker's local allocation buffers and old holders of new values
+  LocalBuffer new_buffer_;
+  LocalBuffer old_buffer_;
+  HValueList remembered_set_;
+
+  // Evacuated by this instance during current pause (workers' counters are
+  // added to parent's)
+  uint32_t bytes_copied_;
+  uint32_t bytes_promoted_;
+
+  GCStatistics stats_;
+  GCEvent event_;
+  uint64_t last_pause_[3];
+  uint64_t pause_start_;
+  uint64_t phase_start_;
+  TraceHandler trace_handler_;
+
+  static bool log_;
 };
 
 }  // namespace internal
@@ -66,27 +66,82 @@ inline void HValue::SetGCMark(char* new_addr) {
 
 inline bool HValue::IsSoftGCMarked() {
   if (IsUnboxed(addr())) return false;
-  return (*reinterpret_cast<uint8_t*>(addr() + kGCMarkOffset) & 0x40) != 0;
+  return (*reinterpret_cast<uint8_t*>(addr() + kGCMarkOffset) & kSoftGCMark) != 0;
 }
 
 
 inline void HValue::SetSoftGCMark() {
-  *reinterpret_cast<uint8_t*>(addr() + kGCMarkOffset) |= 0x40;
+  *reinterpret_cast<uint8_t*>(addr() + kGCMarkOffset) |= kSoftGCMark;
+}
+
+
+inline bool HValue::TrySetSoftGCMark() {
+  uint8_t* mark = reinterpret_cast<uint8_t*>(addr() + kGCMarkOffset);
+  return (__sync_fetch_and_or(mark, kSoftGCMark) & kSoftGCMark) == 0;
 }
 
 
 inline void HValue::ResetSoftGCMark() {
   if (IsSoftGCMarked()) {
-    *reinterpret_cast<uint8_t*>(addr() + kGCMarkOffset) ^= 0x40;
+    *reinterpret_cast<uint8_t*>(addr() + kGCMarkOffset) ^= kSoftGCMark;
   }
 }
 
 
-inline void HValue::IncrementGeneration() {
+inline bool HValue::IsLarge() {
+  return (*reinterpret_cast<uint8_t*>(addr() + kGCMarkOffset) &
+          kLargeMark) != 0;
+}
+
+
+inline bool HValue::IsRemembered() {
+  return (*reinterpret_cast<uint8_t*>(addr() + kGCMarkOffset) &
+          kRememberedMark) != 0;
+}
+
+
+inline void HValue::SetRemembered() {
+  // Mark byte may be updated by concurrent marking thread
+  uint8_t* mark = reinterpret_cast<uint8_t*>(addr() + kGCMarkOffset);
+  __sync_fetch_and_or(mark, kRememberedMark);
+}
+
+
+inline void HValue::ResetRemembered() {
+  *reinterpret_cast<uint8_t*>(addr() + kGCMarkOffset) &= ~kRememberedMark;
+}
+
+
+inline void Heap::RecordWrite(char* holder, char* value) {
+  if (value == HNil::New() || HValue::IsUnboxed(value)) return;
+
+  // New space holders are visited by every GC anyway
+  HValue* hholder = HValue::Cast(holder);
+  if (hholder->Generation() < kMinOldSpaceGeneration) return;
+
+  HValue* hvalue = HValue::Cast(value);
+  if (hvalue->Generation() >= kMinOldSpaceGeneration) {
+    // Old -> old references are interesting only for incremental marking:
+    // holder may be already visited, so value should be marked here
+    if (gc()->is_marking()) gc()->MarkValue(hvalue);
+    return;
+  }
+
+  if (hholder->IsRemembered()) return;
+
+  hholder->SetRemembered();
+  remembered_set()->Push(hholder);
+}
+
+
+inline void HValue::IncrementGeneration(uint8_t tenure_generation) {
   // tag, generation, reserved, GC mark
   if (Generation() < Heap::kMinOldSpaceGeneration) {
     uint8_t* slot = reinterpret_cast<uint8_t*>(addr() + kGenerationOffset);
     *slot = *slot + 1;
+
+    // Object has survived enough GCs
+    if (*slot >= tenure_generation) *slot = Heap::kMinOldSpaceGeneration;
   }
 }
 
@@ -96,6 +151,15 @@ inline uint8_t HValue::Generation() {
 }
 
 
+inline uint16_t HValue::AllocationSiteIndex() {
+#if CANDOR_ARCH_x64
+  return *reinterpret_cast<uint16_t*>(addr() + kAllocationSiteOffset);
+#else
+  return 0;
+#endif
+}
+
+
 inline bool HContext::HasSlot(uint32_t index) {
   return *GetSlotAddress(index) != HNil::New();
 }
@@ -194,6 +258,7 @@ inline void HFunction::SetContext(char* addr, char* context) {
 
   char** root_slot = hroot->GetSlotAddress(Heap::kRootGlobalIndex);
   *root_slot = context;
+  Heap::Current()->RecordWrite(hroot->addr(), context);
 }
 
 }  // namespace internal
@@ -0,0 +1,287 @@
+/**
+ * Copyright (c) 2012, Fedor Indutny.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "heap-snapshot.h"
+
+#include <stdio.h>  // fopen, fprintf
+#include <stdint.h>  // intptr_t
+
+#include "heap.h"
+#include "heap-inl.h"
+#include "safepoint.h"  // FrameIterator
+#include "utils.h"  // RoundUp
+
+namespace candor {
+namespace internal {
+
+// Indexed by Heap::HeapTag
+static const char* tag_names[] = {
+  "",
+  "nil",
+  "context",
+  "boolean",
+  "number",
+  "string",
+  "object",
+  "array",
+  "function",
+  "cdata",
+  "map",
+  "shape"
+};
+
+// Indexed by HeapSnapshot::EdgeType
+static const char* edge_type_names[] = {
+  "parent",
+  "slot",
+  "root",
+  "map",
+  "shape",
+  "key",
+  "value",
+  "left",
+  "right",
+  "transitions"
+};
+
+
+static inline unsigned long ToId(char* addr) {
+  return static_cast<unsigned long>(reinterpret_cast<intptr_t>(addr));
+}
+
+
+bool HeapSnapshot::Write(const char* path) {
+  out_ = fopen(path, "w");
+  if (out_ == NULL) return false;
+
+  fprintf(out_, "{\"tags\":[");
+  for (uint32_t i = 0; i < sizeof(tag_names) / sizeof(*tag_names); i++) {
+    fprintf(out_, "%s\"%s\"", i == 0 ? "" : ",", tag_names[i]);
+  }
+  fprintf(out_, "],\n\"edge_types\":[");
+  for (uint32_t i = 0;
+       i < sizeof(edge_type_names) / sizeof(*edge_type_names);
+       i++) {
+    fprintf(out_, "%s\"%s\"", i == 0 ? "" : ",", edge_type_names[i]);
+  }
+
+  fprintf(out_, "],\n\"nodes\":[\n");
+  first_ = true;
+  IterateObjects(&HeapSnapshot::WriteNode);
+
+  fprintf(out_, "],\n\"edges\":[\n");
+  first_ = true;
+  IterateObjects(&HeapSnapshot::WriteEdges);
+
+  fprintf(out_, "],\n\"roots\":[\n");
+  first_ = true;
+  WriteRoots();
+  fprintf(out_, "]}\n");
+
+  bool result = ferror(out_) == 0;
+  if (fclose(out_) != 0) result = false;
+  out_ = NULL;
+
+  return result;
+}
+
+
+void HeapSnapshot::IterateObjects(ObjectCallback callback) {
+  IterateSpace(heap_->new_space(), callback);
+  IterateSpace(heap_->old_space(), callback);
+
+  LargeSpace::ObjectList::Item* item = heap_->large_space()->objects()->head();
+  for (; item != NULL; item = item->next()) {
+    (this->*callback)(HValue::Cast(item->value()));
+  }
+}
+
+
+void HeapSnapshot::IterateSpace(Space* space, ObjectCallback callback) {
+  Space::PageList::Item* item = space->pages()->head();
+  for (; item != NULL; item = item->next()) {
+    Space::Page* page = item->value();
+
+    char* pos = page->data_ + 1;
+    while (pos < page->top_) {
+      HValue* value = HValue::Cast(pos);
+      if (value->tag() != Heap::kTagFree) (this->*callback)(value);
+      pos += RoundUp(value->Size(), HValue::kPointerSize);
+    }
+  }
+}
+
+
+void HeapSnapshot::WriteNode(HValue* value) {
+  Separate();
+  fprintf(out_,
+          "%lu,%d,%u,%d",
+          ToId(value->addr()),
+          value->tag(),
+          value->Size(),
+          value->Generation());
+}
+
+
+void HeapSnapshot::WriteEdges(HValue* value) {
+  switch (value->tag()) {
+    case Heap::kTagContext:
+      {
+        HContext* context = value->As<HContext>();
+        if (context->has_parent()) {
+          WriteEdge(value, context->parent(), kParent);
+        }
+        for (uint32_t i = 0; i < context->slots(); i++) {
+          if (!context->HasSlot(i)) continue;
+          WriteEdge(value, *context->GetSlotAddress(i), kSlot);
+        }
+      }
+      break;
+    case Heap::kTagFunction:
+      {
+        HFunction* fn = value->As<HFunction>();
+        if (fn->parent() != reinterpret_cast<char*>(Heap::kBindingContextTag)) {
+          WriteEdge(value, fn->parent(), kParent);
+        }
+        WriteEdge(value, fn->root(), kRoot);
+      }
+      break;
+    case Heap::kTagObject:
+      {
+        HObject* obj = value->As<HObject>();
+        WriteEdge(value, obj->map(), kMap);
+        WriteEdge(value, obj->proto(), kShape);
+      }
+      break;
+    case Heap::kTagArray:
+      WriteEdge(value, value->As<HArray>()->map(), kMap);
+      break;
+    case Heap::kTagMap:
+      {
+        HMap* map = value->As<HMap>();
+        uint32_t size = map->size();
+        for (uint32_t i = 0; i < size << 1; i++) {
+          if (map->IsEmptySlot(i)) continue;
+          WriteEdge(value, *map->GetSlotAddress(i), i < size ? kKey : kValue);
+        }
+      }
+      break;
+    case Heap::kTagShape:
+      WriteEdge(value, HShape::Table(value->addr()), kMap);
+      WriteEdge(value, HShape::Transitions(value->addr()), kTransitions);
+      WriteEdge(value, HShape::Parent(value->addr()), kParent);
+      break;
+    case Heap::kTagString:
+      if (HString::Repr(value->addr()) == HString::kCons) {
+        WriteEdge(value, HString::LeftCons(value->addr()), kLeftCons);
+        WriteEdge(value, HString::RightCons(value->addr()), kRightCons);
+      }
+      break;
+    default:
+      break;
+  }
+}
+
+
+void HeapSnapshot::WriteEdge(HValue* from, char* to, EdgeType type) {
+  if (to == NULL || to == HNil::New() || HValue::IsUnboxed(to)) return;
+
+  Separate();
+  fprintf(out_, "%lu,%lu,%d", ToId(from->addr()), ToId(to), type);
+}
+
+
+void HeapSnapshot::WriteRoots() {
+  HValueRefMap* references = heap_->references();
+  HValueRefMap::Item* item = references->head();
+  for (; item != NULL; item = references->next(item)) {
+    HValueReference* ref = item->value();
+    if (!ref->is_persistent()) continue;
+
+    WriteRoot(reinterpret_cast<char*>(*ref->reference()));
+    WriteRoot(reinterpret_cast<char*>(ref->value()));
+  }
+
+  HandleArena* handles = heap_->handles();
+  for (int i = 0; i <= handles->block(); i++) {
+    char** end = handles->block_end(i);
+    for (char** slot = handles->block_start(i); slot < end; slot++) {
+      WriteRoot(*slot);
+    }
+  }
+
+  // Candor frames (see GC::ColourFrames)
+  FrameIterator it(heap_, *heap_->last_stack(), *heap_->last_frame(), false);
+
+  char** slot;
+  while ((slot = it.Next()) != NULL) WriteRoot(*slot);
+}
+
+
+void HeapSnapshot::WriteRoot(char* value) {
+  if (!IsHeapValue(value)) return;
+
+  Separate();
+  fprintf(out_, "%lu", ToId(value));
+}
+
+
+bool HeapSnapshot::IsHeapValue(char* value) {
+  if (value == NULL || value == HNil::New() || HValue::IsUnboxed(value)) {
+    return false;
+  }
+
+  Space* spaces[] = { heap_->new_space(), heap_->old_space() };
+  for (uint32_t i = 0; i < sizeof(spaces) / sizeof(*spaces); i++) {
+    Space::PageList::Item* item = spaces[i]->pages()->head();
+    for (; item != NULL; item = item->next()) {
+      Space::Page* page = item->value();
+      if (value <= page->data_ || value >= page->top_) continue;
+
+      // Interior pointers aren't values, walk objects as in IterateSpace
+      char* pos = page->data_ + 1;
+      while (pos < value) {
+        pos += RoundUp(HValue::Cast(pos)->Size(), HValue::kPointerSize);
+      }
+      return pos == value && HValue::Cast(pos)->tag() != Heap::kTagFree;
+    }
+  }
+
+  LargeSpace::ObjectList::Item* item = heap_->large_space()->objects()->head();
+  for (; item != NULL; item = item->next()) {
+    if (item->value() == value) return true;
+  }
+
+  return false;
+}
+
+
+void HeapSnapshot::Separate() {
+  if (first_) {
+    first_ = false;
+  } else {
+    fprintf(out_, ",\n");
+  }
+}
+
+}  // namespace internal
+}  // namespace candor
@@ -0,0 +1,97 @@
+/**
+ * Copyright (c) 2012, Fedor Indutny.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef _SRC_HEAP_SNAPSHOT_H_
+#define _SRC_HEAP_SNAPSHOT_H_
+
+#include <stdio.h>  // FILE
+
+namespace candor {
+namespace internal {
+
+// Forward declarations
+class Heap;
+class Space;
+class HValue;
+
+// Writes all objects of new, old and large object spaces (including dead
+// ones, they're just unreachable from roots) into JSON file:
+//
+//   {
+//     "tags": [ tag names ],
+//     "edge_types": [ edge type names ],
+//     "nodes": [ address, tag, size, generation, ... ],
+//     "edges": [ from address, to address, edge type, ... ],
+//     "roots": [ address, ... ]
+//   }
+//
+// Roots are persistent handles and values on the stack of candor frames (if
+// snapshot is written from C++ function called by candor code).
+// See tools/heap-snapshot.py for analysis.
+class HeapSnapshot {
+ public:
+  enum EdgeType {
+    kParent,
+    kSlot,
+    kRoot,
+    kMap,
+    kShape,
+    kKey,
+    kValue,
+    kLeftCons,
+    kRightCons,
+    kTransitions
+  };
+
+  explicit HeapSnapshot(Heap* heap) : heap_(heap), out_(NULL), first_(true) {
+  }
+
+  // Returns false if file can't be written
+  bool Write(const char* path);
+
+ protected:
+  typedef void (HeapSnapshot::*ObjectCallback)(HValue* value);
+
+  void IterateObjects(ObjectCallback callback);
+  void IterateSpace(Space* space, ObjectCallback callback);
+
+  void WriteNode(HValue* value);
+  void WriteEdges(HValue* value);
+  void WriteEdge(HValue* from, char* to, EdgeType type);
+  void WriteRoots();
+  void WriteRoot(char* value);
+
+  // Values on stack aren't guaranteed to be pointers to start of objects
+  bool IsHeapValue(char* value);
+
+  // Comma separated list items
+  void Separate();
+
+  Heap* heap_;
+  FILE* out_;
+  bool first_;
+};
+
+}  // namespace internal
+}  // namespace candor
+
+#endif  // _SRC_HEAP_SNAPSHOT_H_
@@ -24,9 +24,11 @@
 
 #include <stdint.h>  // uint32_t, intptr_t
 #include <stdlib.h>  // NULL
+#include <stdio.h>  // fprintf
 #include <string.h>  // memcpy
 #include <zone.h>  // Zone::Allocate
 #include <assert.h>  // assert
+#include <sys/mman.h>  // mmap
 
 #include "heap-inl.h"
 #include "runtime.h"  // RuntimeLookupProperty
@@ -36,12 +38,93 @@ namespace internal {
 
 Heap* Heap::current_ = NULL;
 
+PagePool::PagePool(uint32_t page_size) : page_size_(page_size),
+                                         mapped_count_(0),
+                                         huge_pages_(false) {
+}
+
+
+PagePool::~PagePool() {
+  while (released_.length() != 0) munmap(released_.Shift(), page_size());
+  while (cached_.length() != 0) munmap(cached_.Shift(), page_size());
+  while (clean_.length() != 0) munmap(clean_.Shift(), page_size());
+}
+
+
+char* PagePool::Allocate(uint32_t size) {
+  if (size == page_size()) {
+    // Recently used pages first (their memory is probably still resident)
+    if (released_.length() != 0) return released_.Pop();
+    if (cached_.length() != 0) return cached_.Pop();
+    if (clean_.length() != 0) return clean_.Pop();
+  }
+
+  return Map(size);
+}
+
+
+void PagePool::Release(char* data, uint32_t size) {
+  uint32_t pooled = released_.length() + cached_.length() + clean_.length();
+  if (size != page_size() || pooled >= kMaxPooledPages) {
+    munmap(data, size);
+    return;
+  }
+
+  released_.Push(data);
+}
+
+
+void PagePool::Trim() {
+  while (cached_.length() != 0) {
+    char* data = cached_.Shift();
+    madvise(data, page_size(), MADV_DONTNEED);
+    clean_.Push(data);
+  }
+  while (released_.length() != 0) cached_.Push(released_.Shift());
+}
+
+
+char* PagePool::Map(uint32_t size) {
+  // Map more than needed and unmap unaligned head and tail
+  uint32_t map_size = size + page_size();
+  char* region = reinterpret_cast<char*>(mmap(0,
+                                              map_size,
+                                              PROT_READ | PROT_WRITE,
+                                              MAP_ANON | MAP_PRIVATE,
+                                              -1,
+                                              0));
+  if (region == MAP_FAILED) abort();
+  mapped_count_++;
+
+  uint32_t head = page_size() -
+      reinterpret_cast<intptr_t>(region) % page_size();
+  if (head == page_size()) head = 0;
+  char* result = region + head;
+
+  if (head != 0) munmap(region, head);
+  if (map_size - head - size != 0) {
+    munmap(result + size, map_size - head - size);
+  }
+
+#ifdef MADV_HUGEPAGE
+  if (huge_pages()) madvise(result, size, MADV_HUGEPAGE);
+#endif  // MADV_HUGEPAGE
+
+  return result;
+}
+
+
 Space::Space(Heap* heap, uint32_t page_size) : heap_(heap),
                                                root_(NULL),
                                                page_size_(page_size),
-                                               size_(0) {
+                                               current_(NULL),
+                                               size_(0),
+                                               used_(0),
+                                               initial_size_(0),
+                                               max_size_(0),
+                                               growth_factor_(2.0) {
   // Create the first page
-  pages_.Push(new Page(page_size));
+  pages_.Push(new Page(heap->page_pool(), page_size));
 
   select(pages_.head()->value());
 
@@ -49,15 +132,58 @@ Space::Space(Heap* heap, uint32_t page_size) : heap_(heap),
 }
 
 
+void Space::compute_size_limit() {
+  double limit = size_ * growth_factor_;
+
+  if (max_size_ != 0 && limit > max_size_) limit = max_size_;
+  if (limit < initial_size_) limit = initial_size_;
+  size_limit_ = static_cast<uint32_t>(limit);
+}
+
+
 void Space::select(Page* page) {
+  // Free memory at the end of current page may be used later
+  if (current_ != NULL && current_ != page) IndexPage(current_);
+
+  current_ = page;
   top_ = &page->top_;
   limit_ = &page->limit_;
 }
 
 
+void Space::IndexPage(Page* page) {
+  uint32_t free_bytes = page->limit_ - page->top_;
+  if (free_bytes < HValue::kMinFreeSize) return;
+
+  page_index_[Log2(free_bytes)].Push(page);
+}
+
+
+void Space::ReindexPages() {
+  for (uint32_t i = 0; i < kSizeClasses; i++) {
+    while (page_index_[i].length() != 0) page_index_[i].Shift();
+  }
+
+  PageList::Item* item = pages_.head();
+  for (; item != NULL; item = item->next()) {
+    if (item->value() != current_) IndexPage(item->value());
+  }
+}
+
+
+Space::Page* Space::FindPage(uint32_t bytes) {
+  // Every page in the class above `bytes`'s one has enough free memory
+  for (uint32_t i = Log2(bytes) + 1; i < kSizeClasses; i++) {
+    if (page_index_[i].length() != 0) return page_index_[i].Pop();
+  }
+
+  return NULL;
+}
+
+
 void Space::AddPage(uint32_t size) {
   uint32_t real_size = RoundUp(size, page_size());
-  Page* page = new Page(real_size);
+  Page* page = new Page(heap()->page_pool(), real_size);
   pages_.Push(page);
   size_ += real_size;
 
@@ -66,34 +192,58 @@ void Space::AddPage(uint32_t size) {
 
 
 char* Space::Allocate(uint32_t bytes) {
+  // Objects are pointer aligned: slots could be read by marking thread
+  // while mutator is writing them
+  uint32_t aligned_bytes = RoundUp(bytes, HValue::kPointerSize);
+
   // If current page was exhausted - run GC
-  uint32_t even_bytes = bytes + (bytes & 0x01);
-  bool place_in_current = *top_ + even_bytes <= *limit_;
+  bool place_in_current = *top_ + aligned_bytes <= *limit_;
 
   if (!place_in_current) {
-    // Go through all pages to find gap
-    List<Page*, EmptyClass>::Item* item = pages_.head();
-    for (;*top_ + even_bytes > *limit_ && item != NULL; item = item->next()) {
-      select(item->value());
+    // Reuse memory of dead objects
+    char* result = AllocateFromFreeList(aligned_bytes);
+    if (result != NULL) {
+      used_ += aligned_bytes;
+      return result;
     }
 
-    // No gap was found - allocate new page
-    if (item == NULL) {
-      if (size() > size_limit()) {
+    // Find page with enough free memory at the end
+    Page* page = FindPage(aligned_bytes);
+    if (page != NULL) {
+      select(page);
+    } else {
+      // No gap was found - allocate new page
+      if (size() > size_limit() || heap()->IsOverLimit()) {
         heap()->needs_gc(this == heap()->new_space() ?
             Heap::kGCNewSpace
             :
             Heap::kGCOldSpace);
+      } else if (heap()->gc()->is_marking() &&
+                 heap()->needs_gc() == Heap::kGCNone) {
+        // Perform incremental marking step on slow path
+        heap()->needs_gc(Heap::kGCMarkingStep);
       }
 
       // Including tagging byte offset
-      AddPage(even_bytes + 1);
+      AddPage(aligned_bytes + 1);
     }
   }
 
   char* result = *top_;
-  *top_ += even_bytes;
+  *top_ += aligned_bytes;
+  used_ += aligned_bytes;
+
+  return result;
+}
 
+
+uint32_t Space::allocated() {
+  uint32_t result = 0;
+  PageList::Item* item = pages_.head();
+  for (; item != NULL; item = item->next()) {
+    Page* page = item->value();
+    result += page->top_ - page->data_ - 1;
+  }
   return result;
 }
 
@@ -106,31 +256,430 @@ void Space::Swap(Space* space) {
     pages_.Push(space->pages_.Shift());
     size_ += pages_.tail()->value()->size_;
   }
+  used_ = space->used_;
 
   select(pages_.head()->value());
+  ReindexPages();
+  compute_size_limit();
+}
+
+
+char* Space::AllocateFromFreeList(uint32_t bytes) {
+  for (uint32_t i = Log2(bytes); i < kSizeClasses; i++) {
+    FreeList* list = &free_lists_[i];
+    if (list->length() == 0) continue;
+
+    // Only first block of each class is checked, blocks from classes above
+    // `bytes + kMinFreeSize`'s one always fit
+    char* block = list->head()->value();
+    uint32_t size = HValue::Cast(block)->Size();
+
+    // Remainder should be big enough to hold free block
+    if (size != bytes && size < bytes + HValue::kMinFreeSize) continue;
+
+    list->Shift();
+    if (size != bytes) AddFreeBlock(block + bytes, size - bytes);
+
+    return block;
+  }
+
+  return NULL;
+}
+
+
+void Space::AddFreeBlock(char* addr, uint32_t size) {
+  assert(size >= HValue::kMinFreeSize);
+
+  *reinterpret_cast<intptr_t*>(addr + HValue::kTagOffset) = Heap::kTagFree;
+  *reinterpret_cast<uint32_t*>(addr + HValue::kFreeSizeOffset) = size;
+
+  free_lists_[Log2(size)].Push(addr);
+}
+
+
+void Space::ClearFreeList() {
+  for (uint32_t i = 0; i < kSizeClasses; i++) {
+    while (free_lists_[i].length() != 0) free_lists_[i].Shift();
+  }
+}
+
+
+void Space::AddFiller(char* addr, uint32_t size) {
+  if (size >= HValue::kMinFreeSize) return AddFreeBlock(addr, size);
+  if (size == 0) return;
+
+  *reinterpret_cast<uint8_t*>(addr + HValue::kTagOffset) = Heap::kTagFree;
+  HValue::SetRepresentation<uint8_t>(addr, size);
+}
+
+
+void Space::Sweep() {
+  // Free list will be rebuilt, existing blocks are merged with dead objects
+  ClearFreeList();
+  used_ = 0;
+
+  PageList::Item* item = pages_.head();
+  PageList::Item* next;
+  for (; item != NULL; item = next) {
+    Page* page = item->value();
+    next = item->next();
+
+    // Start of continuous block of dead objects
+    char* dead = NULL;
+    char* pos = page->data_ + 1;
+    while (pos < page->top_) {
+      HValue* value = HValue::Cast(pos);
+      uint32_t size = RoundUp(value->Size(), HValue::kPointerSize);
+
+      if (value->tag() != Heap::kTagFree && value->IsSoftGCMarked()) {
+        value->ResetSoftGCMark();
+        used_ += size;
+        if (dead != NULL) {
+          AddFreeBlock(dead, pos - dead);
+          dead = NULL;
+        }
+      } else {
+        if (value->tag() != Heap::kTagFree) heap()->RecordOldDeath(value);
+        if (dead == NULL) dead = pos;
+      }
+      pos += size;
+    }
+
+    // Free space at the end of page could be reused by bump allocation
+    if (dead != NULL) page->top_ = dead;
+
+    // Release empty pages (except the first and the current one)
+    if (page->top_ == page->data_ + 1 &&
+        item != pages_.head() &&
+        top_ != &page->top_) {
+      size_ -= page->size_;
+      pages_.Remove(item);
+    }
+  }
+
+  // Free memory at the end of pages has changed
+  ReindexPages();
   compute_size_limit();
 }
 
 
 void Space::Clear() {
+  ClearFreeList();
+  for (uint32_t i = 0; i < kSizeClasses; i++) {
+    while (page_index_[i].length() != 0) page_index_[i].Shift();
+  }
+  current_ = NULL;
+
   size_ = 0;
+  used_ = 0;
   while (pages_.length() != 0) {
     delete pages_.Shift();
   }
 }
 
 
-Heap::Heap(uint32_t page_size) : new_space_(this, page_size),
+LargeSpace::LargeSpace(Heap* heap) : heap_(heap),
+                                     new_size_(0),
+                                     old_size_(0),
+                                     old_size_limit_(Heap::kLargeObjectSize) {
+}
+
+
+LargeSpace::~LargeSpace() {
+  while (objects_.length() != 0) Free(objects_.Shift());
+}
+
+
+char* LargeSpace::Allocate(uint32_t bytes, bool tenured) {
+  uint32_t size = RoundUp(kHeaderSize + bytes, GetPageSize());
+
+  char* region = reinterpret_cast<char*>(mmap(0,
+                                              size,
+                                              PROT_READ | PROT_WRITE,
+                                              MAP_ANON | MAP_PRIVATE,
+                                              -1,
+                                              0));
+  if (region == MAP_FAILED) abort();
+  *reinterpret_cast<uint32_t*>(region) = size;
+
+  // Large objects should be collected as often as spaces they belong to
+  if (tenured) {
+    old_size_ += size;
+    if (old_size_ > old_size_limit_ || heap()->IsOverLimit()) {
+      heap()->needs_gc(Heap::kGCOldSpace);
+    }
+  } else {
+    new_size_ += size;
+    if (new_size_ > heap()->new_space()->page_size() &&
+        heap()->needs_gc() == Heap::kGCNone) {
+      heap()->needs_gc(Heap::kGCNewSpace);
+    }
+  }
+
+  char* result = region + kHeaderSize + 1;
+  objects_.Push(result);
+
+  return result;
+}
+
+
+void LargeSpace::Promote(HValue* value) {
+  assert(value->IsLarge());
+
+  uint32_t size = RegionSize(value->addr());
+  new_size_ -= size;
+  old_size_ += size;
+  if (old_size_ > old_size_limit_) heap()->needs_gc(Heap::kGCOldSpace);
+
+  *reinterpret_cast<uint8_t*>(value->addr() + HValue::kGenerationOffset) =
+      Heap::kMinOldSpaceGeneration;
+}
+
+
+void LargeSpace::SweepNew() {
+  ObjectList::Item* item = objects_.head();
+  ObjectList::Item* next;
+  for (; item != NULL; item = next) {
+    next = item->next();
+
+    HValue* value = HValue::Cast(item->value());
+    if (value->Generation() >= Heap::kMinOldSpaceGeneration) continue;
+
+    new_size_ -= RegionSize(value->addr());
+    Free(value->addr());
+    objects_.Remove(item);
+  }
+}
+
+
+void LargeSpace::SweepOld() {
+  ObjectList::Item* item = objects_.head();
+  ObjectList::Item* next;
+  for (; item != NULL; item = next) {
+    next = item->next();
+
+    HValue* value = HValue::Cast(item->value());
+    if (value->Generation() < Heap::kMinOldSpaceGeneration) continue;
+
+    if (value->IsSoftGCMarked()) {
+      value->ResetSoftGCMark();
+      continue;
+    }
+
+    old_size_ -= RegionSize(value->addr());
+    Free(value->addr());
+    objects_.Remove(item);
+  }
+
+  old_size_limit_ = static_cast<uint32_t>(
+      old_size_ * heap()->old_space()->growth_factor());
+  if (old_size_limit_ < Heap::kLargeObjectSize) {
+    old_size_limit_ = Heap::kLargeObjectSize;
+  }
+}
+
+
+void LargeSpace::Free(char* addr) {
+  munmap(addr - 1 - kHeaderSize, RegionSize(addr));
+}
+
+
+Heap::Heap(uint32_t page_size) : page_pool_(page_size),
+                                 new_space_(this, page_size),
                                  old_space_(this, page_size),
+                                 large_space_(this),
                                  last_stack_(NULL),
                                  last_frame_(NULL),
                                  pending_exception_(NULL),
                                  needs_gc_(kGCNone),
+                                 tenure_generation_(kMinOldSpaceGeneration),
+                                 limit_(0),
+                                 out_of_memory_handler_(NULL),
+                                 shape_count_(0),
+                                 allocation_sites_(NULL),
+                                 allocation_site_count_(0),
+                                 allocation_site_capacity_(0),
                                  gc_(this),
-                                 code_space_(NULL) {
+                                 code_space_(NULL),
+                                 isolate_(NULL),
+                                 string_table_(this) {
   current_ = this;
-  factory_ = HValue::Cast(HObject::NewEmpty(this, kMinFactorySize));
+  root_shape_ = HShape::New(this, 0);
+  Reference(Heap::kRefPersistent,
+            reinterpret_cast<HValue**>(&root_shape_),
+            HValue::Cast(root_shape_));
+
+  // Factory has too many keys for shapes
+  factory_ = HValue::Cast(HObject::NewEmpty(this));
+  HObject::Normalize(this, factory_->addr(), kMinFactorySize);
   Reference(Heap::kRefPersistent, &factory_, factory_);
+
+  // The only boolean values in heap
+  true_value_ = ToFactory(HBoolean::New(this, Heap::kTenureOld, true));
+  false_value_ = ToFactory(HBoolean::New(this, Heap::kTenureOld, false));
+  Reference(Heap::kRefPersistent,
+            reinterpret_cast<HValue**>(&true_value_),
+            HValue::Cast(true_value_));
+  Reference(Heap::kRefPersistent,
+            reinterpret_cast<HValue**>(&false_value_),
+            HValue::Cast(false_value_));
+
+  // Shared site
+  NewAllocationSite();
+}
+
+
+Heap::~Heap() {
+  for (uint32_t i = 0; i < allocation_site_count_; i++) {
+    delete allocation_sites_[i];
+  }
+  delete[] allocation_sites_;
+}
+
+
+AllocationSite::AllocationSite(uint16_t index) : allocated_(0),
+                                                 tenured_(0),
+                                                 header_(0),
+                                                 survived_(0),
+                                                 died_(0),
+                                                 index_(index) {
+#if CANDOR_ARCH_x64
+  int bit_offset = (HValue::kAllocationSiteOffset -
+                    HValue::interior_offset(0)) << 3;
+  header_ = static_cast<intptr_t>(index) << bit_offset;
+#endif
+}
+
+
+HandleArena::HandleArena() : top_(NULL),
+                             limit_(NULL),
+                             block_(-1),
+                             blocks_(NULL),
+                             block_count_(0),
+                             block_capacity_(0) {
+}
+
+
+HandleArena::~HandleArena() {
+  for (int i = 0; i < block_count_; i++) delete[] blocks_[i];
+  delete[] blocks_;
+}
+
+
+void HandleArena::Grow() {
+  if (++block_ == block_count_) {
+    if (block_count_ == block_capacity_) {
+      block_capacity_ = block_capacity_ == 0 ? 16 : block_capacity_ << 1;
+      char*** blocks = new char**[block_capacity_];
+      if (block_count_ != 0) {
+        memcpy(blocks, blocks_, block_count_ * sizeof(*blocks));
+      }
+      delete[] blocks_;
+      blocks_ = blocks;
+    }
+    blocks_[block_count_++] = new char*[kBlockSize];
+  }
+
+  top_ = blocks_[block_];
+  limit_ = top_ + kBlockSize;
+}
+
+
+void HandleArena::Restore(char** top, int block) {
+  assert(block <= block_);
+  top_ = top;
+  block_ = block;
+  limit_ = block == -1 ? NULL : blocks_[block] + kBlockSize;
+}
+
+
+AllocationSite* Heap::NewAllocationSite() {
+  if (allocation_site_count_ == kMaxAllocationSites) {
+    return allocation_sites_[0];
+  }
+
+  // Sites are referenced by generated code, only index is reallocated
+  if (allocation_site_count_ == allocation_site_capacity_) {
+    allocation_site_capacity_ = allocation_site_capacity_ == 0 ?
+        64
+        :
+        allocation_site_capacity_ << 1;
+    AllocationSite** sites = new AllocationSite*[allocation_site_capacity_];
+    if (allocation_site_count_ != 0) {
+      memcpy(sites,
+             allocation_sites_,
+             allocation_site_count_ * sizeof(*sites));
+    }
+    delete[] allocation_sites_;
+    allocation_sites_ = sites;
+  }
+
+  AllocationSite* site = new AllocationSite(allocation_site_count_);
+  allocation_sites_[allocation_site_count_++] = site;
+
+  return site;
+}
+
+
+void Heap::UpdateAllocationSites() {
+  for (uint32_t i = 1; i < allocation_site_count_; i++) {
+    AllocationSite* site = allocation_sites_[i];
+    if (site->is_tenured()) continue;
+    if (site->allocated_ < static_cast<intptr_t>(kMinSiteAllocations)) {
+      continue;
+    }
+
+    if (site->survived_ * 100 >= site->allocated_ * kPretenureRatio) {
+      site->tenured_ = 1;
+    }
+    site->allocated_ = 0;
+    site->survived_ = 0;
+  }
+}
+
+
+void Heap::RecordOldDeath(HValue* value) {
+  // Only literals have site index in their header
+  if (value->tag() != kTagObject && value->tag() != kTagArray) return;
+
+  AllocationSite* site = allocation_site(value->AllocationSiteIndex());
+  if (site == NULL || !site->is_tenured()) return;
+  site->died_++;
+}
+
+
+void Heap::UpdateTenuredSites() {
+  for (uint32_t i = 1; i < allocation_site_count_; i++) {
+    AllocationSite* site = allocation_sites_[i];
+    if (!site->is_tenured()) continue;
+    if (site->allocated_ < static_cast<intptr_t>(kMinSiteAllocations)) {
+      continue;
+    }
+
+    // Site's objects became short-lived, sample them in new space again
+    if (site->died_ * 100 >= site->allocated_ * kDetenureRatio) {
+      site->tenured_ = 0;
+    }
+    site->allocated_ = 0;
+    site->survived_ = 0;
+    site->died_ = 0;
+  }
+}
+
+
+uint32_t Heap::size() {
+  return new_space()->size() + old_space()->used() +
+         large_space()->new_size() + large_space()->old_size();
+}
+
+
+void Heap::OutOfMemory() {
+  if (out_of_memory_handler_ != NULL) out_of_memory_handler_(this);
+
+  fprintf(stderr, "Out of memory: heap size %u over limit %u\n",
+          size(),
+          limit());
+  abort();
 }
 
 
@@ -141,6 +690,7 @@ char* Heap::ToFactory(char* key) {
                                         1);
   if (*slot == HNil::New()) {
     *slot = key;
+    RecordWrite(HObject::Map(reinterpret_cast<char*>(factory_)), key);
   } else {
     key = *slot;
   }
@@ -150,7 +700,8 @@ char* Heap::ToFactory(char* key) {
 
 
 char* Heap::CreateString(const char* key, uint32_t size) {
-  return ToFactory(HString::New(this, Heap::kTenureOld, key, size));
+  return ToFactory(
+      string_table()->Intern(HString::New(this, Heap::kTenureOld, key, size)));
 }
 
 
@@ -160,7 +711,7 @@ char* Heap::CreateNumber(double num) {
 
 
 char* Heap::CreateBoolean(bool value) {
-  return ToFactory(HBoolean::New(this, Heap::kTenureOld, value));
+  return value ? true_value_ : false_value_;
 }
 
 
@@ -181,13 +732,25 @@ const char* Heap::ErrorToString(Error err) {
 
 
 char* Heap::AllocateTagged(HeapTag tag, TenureType tenure, uint32_t bytes) {
-  char* result = space(tenure)->Allocate(bytes + 8);
+  bool large = bytes + 8 >= kLargeObjectSize;
+  char* result;
+  if (large) {
+    result = large_space()->Allocate(bytes + 8, tenure == kTenureOld);
+  } else {
+    result = space(tenure)->Allocate(bytes + 8);
+  }
+
   intptr_t qtag = tag;
   if (tenure == kTenureOld) {
     int bit_offset = (HValue::kGenerationOffset -
                       HValue::interior_offset(0)) << 3;
     qtag = qtag | (kMinOldSpaceGeneration << bit_offset);
   }
+  if (large) {
+    int bit_offset = (HValue::kGCMarkOffset -
+                      HValue::interior_offset(0)) << 3;
+    qtag = qtag | (static_cast<intptr_t>(HValue::kLargeMark) << bit_offset);
+  }
   *reinterpret_cast<intptr_t*>(result + HValue::kTagOffset) = qtag;
 
   return result;
@@ -220,11 +783,16 @@ void Heap::RemoveWeak(HValue* value) {
 }
 
 
-HValue* HValue::CopyTo(Space* old_space, Space* new_space) {
+uint32_t HValue::Size() {
   assert(!IsUnboxed(addr()));
 
   uint32_t size = kPointerSize;
   switch (tag()) {
+    case Heap::kTagFree:
+      if (GetRepresentation<uint8_t>(addr()) != 0) {
+        return GetRepresentation<uint8_t>(addr());
+      }
+      return *reinterpret_cast<uint32_t*>(addr() + kFreeSizeOffset);
     case Heap::kTagContext:
       // parent + slots
       size += (2 + As<HContext>()->slots()) * kPointerSize;
@@ -242,14 +810,14 @@ HValue* HValue::CopyTo(Space* old_space, Space* new_space) {
     case Heap::kTagString:
       // hash + length
       size += 2 * kPointerSize;
-      switch (GetRepresentation<HString::Representation>(addr())) {
+      switch (HString::Repr(addr())) {
         case HString::kNormal:
-          // + bytes
-          size += As<HString>()->length();
+          // + bytes + padding (should match HString::New)
+          size += As<HString>()->length() + kPointerSize;
           break;
         case HString::kCons:
           // + lhs + rhs + scratch_slot (for traversing)
-          size += 2 * kPointerSize;
+          size += 3 * kPointerSize;
           break;
         default:
           UNEXPECTED
@@ -268,6 +836,11 @@ HValue* HValue::CopyTo(Space* old_space, Space* new_space) {
       // size + space ( keys + values )
       size += (1 + (As<HMap>()->size() << 1)) * kPointerSize;
       break;
+    case Heap::kTagShape:
+      // count + table + mask + transitions + transition mask and count +
+      // parent
+      size += 7 * kPointerSize;
+      break;
     case Heap::kTagCData:
       // size + data
       size += kPointerSize + As<HCData>()->size();
@@ -276,7 +849,14 @@ HValue* HValue::CopyTo(Space* old_space, Space* new_space) {
       UNEXPECTED
   }
 
-  IncrementGeneration();
+  return size;
+}
+
+
+HValue* HValue::CopyTo(Space* old_space, Space* new_space) {
+  uint32_t size = Size();
+
+  IncrementGeneration(old_space->heap()->tenure_generation());
   char* result;
   if (Generation() >= Heap::kMinOldSpaceGeneration) {
     result = old_space->Allocate(size);
@@ -306,6 +886,7 @@ char* HContext::New(Heap* heap,
   char** slot = reinterpret_cast<char**>(result + GetIndexDisp(0));
   while (values->length() != 0) {
     *slot = values->Shift();
+    heap->RecordWrite(result, *slot);
     slot++;
   }
 
@@ -378,6 +959,8 @@ char* HString::NewCons(Heap* heap,
   // Set lhs and rhs
   *LeftConsSlot(result) = left;
   *RightConsSlot(result) = right;
+  heap->RecordWrite(result, left);
+  heap->RecordWrite(result, right);
 
   return result;
 }
@@ -385,7 +968,7 @@ char* HString::NewCons(Heap* heap,
 
 char* HString::FlattenCons(char* addr, char* buffer) {
   while (addr != NULL) {
-    switch (GetRepresentation<Representation>(addr)) {
+    switch (Repr(addr)) {
       case kNormal:
         {
           uint32_t len = HString::Length(addr);
@@ -422,7 +1005,7 @@ char* HString::FlattenCons(char* addr, char* buffer) {
 
 
 char* HString::Value(Heap* heap, char* addr) {
-  switch (GetRepresentation<Representation>(addr)) {
+  switch (Repr(addr)) {
     case kNormal:
       return addr + kValueOffset;
     case kCons:
@@ -441,6 +1024,7 @@ char* HString::Value(Heap* heap, char* addr) {
 
         *RightConsSlot(addr) = HNil::New();
         *LeftConsSlot(addr) = result;
+        heap->RecordWrite(addr, result);
 
         return value;
       }
@@ -472,19 +1056,60 @@ char* HObject::NewEmpty(Heap* heap, uint32_t size) {
 }
 
 
-void HObject::Init(Heap* heap, char* obj, uint32_t size) {
+void HObject::Init(Heap* heap,
+                   char* obj,
+                   uint32_t size,
+                   Heap::TenureType tenure) {
   // Set mask
   *reinterpret_cast<intptr_t*>(obj + kMaskOffset) = (size - 1) * kPointerSize;
   // Set map
-  char* map = HMap::NewEmpty(heap, size);
+  char* map = HMap::NewEmpty(heap, size, tenure);
   *reinterpret_cast<char**>(obj + kMapOffset) = map;
-  // Set proto
-  *reinterpret_cast<char**>(obj + kProtoOffset) = map;
+  // Set shape (arrays are never cached by IC)
+  if (GetTag(obj) == Heap::kTagObject) {
+    *reinterpret_cast<char**>(obj + kProtoOffset) = *heap->root_shape();
+  } else {
+    SetDictionary(obj);
+  }
+}
+
+
+void HObject::Normalize(Heap* heap, char* addr, uint32_t min_size) {
+  if (IsDictionary(addr)) return;
+
+  char* shape = Proto(addr);
+  char* table = HShape::Table(shape);
+  HMap* values = HValue::As<HMap>(Map(addr));
+  uint32_t count = HShape::Count(shape);
+
+  uint32_t size = PowerOfTwo(count + 1) << 1;
+  if (size < min_size) size = min_size;
+
+  *reinterpret_cast<intptr_t*>(addr + kMaskOffset) = (size - 1) * kPointerSize;
+  *MapSlot(addr) = HMap::NewEmpty(heap, size);
+  heap->RecordWrite(addr, Map(addr));
+  SetDictionary(addr);
+
+  // Move properties into dictionary
+  HMap* htable = HValue::As<HMap>(table);
+  uint32_t table_size = htable->size();
+  for (uint32_t i = 0; i < table_size; i++) {
+    if (htable->IsEmptySlot(i)) continue;
+
+    char* key = *htable->GetSlotAddress(i);
+    intptr_t index = HNumber::Untag(
+        reinterpret_cast<intptr_t>(*htable->GetSlotAddress(i + table_size)));
+    char* value = *values->GetSlotAddress(index);
+
+    *LookupProperty(heap, addr, key, 1) = value;
+    heap->RecordWrite(Map(addr), value);
+  }
 }
 
 
 char** HObject::LookupProperty(Heap* heap, char* addr, char* key, int insert) {
   intptr_t offset = RuntimeLookupProperty(heap, addr, key, insert);
+  if (offset == Heap::kTagNil) return NULL;
   return reinterpret_cast<char**>(HObject::Map(addr) + offset);
 }
 
@@ -520,7 +1145,7 @@ int64_t HArray::Length(char* obj, bool shrink) {
       shrinked--;
       shrinkedptr = reinterpret_cast<char*>(HNumber::Tag(shrinked));
       slot = HObject::LookupProperty(NULL, obj, shrinkedptr, 0);
-    } while (*slot == HNil::New());
+    } while (slot == NULL || *slot == HNil::New());
 
     // If array was shrinked - change length
     if (result != (shrinked + 1)) {
@@ -533,9 +1158,9 @@ int64_t HArray::Length(char* obj, bool shrink) {
 }
 
 
-char* HMap::NewEmpty(Heap* heap, uint32_t size) {
+char* HMap::NewEmpty(Heap* heap, uint32_t size, Heap::TenureType tenure) {
   char* map = heap->AllocateTagged(Heap::kTagMap,
-                                   Heap::kTenureNew,
+                                   tenure,
                                    ((size << 1) + 1) * kPointerSize);
 
   // Set map's size
@@ -552,6 +1177,144 @@ char* HMap::NewEmpty(Heap* heap, uint32_t size) {
 }
 
 
+char* HShape::New(Heap* heap, uint32_t count) {
+  char* shape = heap->AllocateTagged(Heap::kTagShape,
+                                     Heap::kTenureOld,
+                                     7 * kPointerSize);
+
+  // Keep table at most half full
+  uint32_t size = PowerOfTwo(count << 1);
+  char* table = HMap::NewEmpty(heap, size, Heap::kTenureOld);
+  heap->shape_count(heap->shape_count() + 1);
+
+  *reinterpret_cast<intptr_t*>(shape + kCountOffset) = count;
+  *TableSlot(shape) = table;
+  *reinterpret_cast<intptr_t*>(shape + kMaskOffset) =
+      (size - 1) * kPointerSize;
+  *TransitionsSlot(shape) = HNil::New();
+  *reinterpret_cast<intptr_t*>(shape + kTransitionMaskOffset) = 0;
+  *reinterpret_cast<intptr_t*>(shape + kTransitionCountOffset) = 0;
+  *ParentSlot(shape) = HNil::New();
+  heap->RecordWrite(shape, table);
+
+  return shape;
+}
+
+
+char** HShape::FindKey(Heap* heap, char* table, char* key) {
+  HMap* map = HValue::As<HMap>(table);
+  uint32_t mask = map->size() - 1;
+
+  // Start at the same slot as LookupPropertyStub does
+  uint32_t index = (HString::Hash(heap, key) & (mask * kPointerSize)) /
+                   kPointerSize;
+
+  // Tables are never full
+  while (true) {
+    char** slot = map->GetSlotAddress(index);
+    if (*slot == HNil::New() || *slot == key) return slot;
+
+    // Different internalized strings can't be equal
+    if (!(HString::IsInternalized(*slot) && HString::IsInternalized(key)) &&
+        RuntimeStrictCompare(heap, *slot, key) == 0) {
+      return slot;
+    }
+    index = (index + 1) & mask;
+  }
+}
+
+
+intptr_t HShape::Lookup(Heap* heap, char* addr, char* key) {
+  char* table = Table(addr);
+  char** slot = FindKey(heap, table, key);
+  if (*slot == HNil::New()) return -1;
+
+  uint32_t size = HValue::As<HMap>(table)->size();
+  return HNumber::Untag(reinterpret_cast<intptr_t>(slot[size]));
+}
+
+
+char* HShape::Transition(Heap* heap, char* addr, char* key) {
+  char* transitions = Transitions(addr);
+  if (transitions != HNil::New()) {
+    char** slot = FindKey(heap, transitions, key);
+    if (*slot != HNil::New()) {
+      return slot[HValue::As<HMap>(transitions)->size()];
+    }
+  }
+
+  uint32_t count = Count(addr);
+  uint32_t transition_count =
+      *reinterpret_cast<intptr_t*>(addr + kTransitionCountOffset);
+  if (count >= kMaxProperties ||
+      transition_count >= kMaxTransitions ||
+      heap->shape_count() >= kMaxShapes) {
+    return NULL;
+  }
+
+  // Copy keys and add a new one
+  char* result = New(heap, count + 1);
+  *ParentSlot(result) = addr;
+  heap->RecordWrite(result, addr);
+  char* table = Table(addr);
+  char* result_table = Table(result);
+  uint32_t size = HValue::As<HMap>(table)->size();
+  uint32_t result_size = HValue::As<HMap>(result_table)->size();
+  for (uint32_t i = 0; i < size; i++) {
+    char* table_key = *HValue::As<HMap>(table)->GetSlotAddress(i);
+    if (table_key == HNil::New()) continue;
+
+    char** slot = FindKey(heap, result_table, table_key);
+    slot[0] = table_key;
+    slot[result_size] = *HValue::As<HMap>(table)->GetSlotAddress(i + size);
+    heap->RecordWrite(result_table, table_key);
+  }
+
+  char** slot = FindKey(heap, result_table, key);
+  slot[0] = key;
+  slot[result_size] = reinterpret_cast<char*>(HNumber::Tag(count));
+  heap->RecordWrite(result_table, key);
+
+  // Grow transitions table (keeping it at most half full)
+  uint32_t transitions_size = transitions == HNil::New() ?
+      0
+      :
+      HValue::As<HMap>(transitions)->size();
+  if ((transition_count + 1) << 1 > transitions_size) {
+    uint32_t new_size = transitions_size == 0 ? 4 : transitions_size << 1;
+    char* new_transitions = HMap::NewEmpty(heap, new_size, Heap::kTenureOld);
+    for (uint32_t i = 0; i < transitions_size; i++) {
+      char* transition_key = *HValue::As<HMap>(transitions)->GetSlotAddress(i);
+      if (transition_key == HNil::New()) continue;
+
+      char** slot = FindKey(heap, new_transitions, transition_key);
+      slot[0] = transition_key;
+      slot[new_size] =
+          *HValue::As<HMap>(transitions)->GetSlotAddress(i + transitions_size);
+      heap->RecordWrite(new_transitions, transition_key);
+      heap->RecordWrite(new_transitions, slot[new_size]);
+    }
+
+    transitions = new_transitions;
+    transitions_size = new_size;
+    *TransitionsSlot(addr) = transitions;
+    *reinterpret_cast<intptr_t*>(addr + kTransitionMaskOffset) =
+        (new_size - 1) * kPointerSize;
+    heap->RecordWrite(addr, transitions);
+  }
+
+  slot = FindKey(heap, transitions, key);
+  slot[0] = key;
+  slot[transitions_size] = result;
+  *reinterpret_cast<intptr_t*>(addr + kTransitionCountOffset) =
+      transition_count + 1;
+  heap->RecordWrite(transitions, key);
+  heap->RecordWrite(transitions, result);
+
+  return result;
+}
+
+
 char* HFunction::New(Heap* heap, char* parent, char* addr, char* root) {
   char* fn = heap->AllocateTagged(Heap::kTagFunction,
                                   Heap::kTenureOld,
@@ -569,6 +1332,9 @@ char* HFunction::New(Heap* heap, char* parent, char* addr, char* root) {
   // Set argc
   *reinterpret_cast<char**>(fn + kArgcOffset) = NULL;
 
+  heap->RecordWrite(fn, parent);
+  heap->RecordWrite(fn, root);
+
   return fn;
 }
 
@@ -29,7 +29,28 @@
 //  * new space - all objects will be allocated here
 //  * old space - tenured objects will be placed here
 //
-// Both spaces are lists of allocated buffers(pages) with a stack structure
+// Both spaces are lists of allocated buffers(pages) with a stack structure.
+// New space is collected by copying, old space by mark and sweep: memory of
+// dead old objects is put into the free list and reused by allocation.
+//
+// Old objects that are referencing new space objects are recorded by write
+// barrier in the remembered set, which serves as a root set for
+// new space GC (so it won't need to visit the whole old space).
+//
+// Pages are mmap'd (aligned to page size) by the page pool, which keeps
+// released pages for reuse by the next GC and returns memory of ones that
+// weren't reused for a whole GC cycle to OS with madvise().
+//
+// Objects bigger than Heap::kLargeObjectSize are allocated in the large
+// object space: every one of them is placed into its own mmap'd region and
+// is never copied. New space GC promotes reachable large objects by changing
+// their generation and unmaps others, old space GC unmaps unmarked ones.
+//
+// Object and array literals are allocated through allocation sites (one per
+// literal in generated code). Site's index is stored in the object's header
+// (x64 only) and new space GC counts objects surviving their first scavenge.
+// Sites with high survival rate are switched to old space allocation
+// (pretenured), so long-lived objects aren't copied again and again.
 //
 
 #include <stdint.h>  // uint32_t
@@ -39,37 +60,99 @@
 #include "zone.h"  // ZoneObject
 #include "gc.h"  // GC
 #include "source-map.h"  // SourceMap
+#include "safepoint.h"  // SafepointTable
+#include "stub-cache.h"  // StubCache
+#include "string-table.h"  // StringTable
 #include "utils.h"
 
 namespace candor {
+
+// Forward declarations
+class Isolate;
+
 namespace internal {
 
 // Forward declarations
 class Heap;
+class HValue;
 class HValueReference;
 class HValueWeakRef;
 class CodeSpace;
 
+class PagePool {
+ public:
+  explicit PagePool(uint32_t page_size);
+  ~PagePool();
+
+  // Memory is aligned to page size, only chunks of exactly one page are
+  // reused (bigger ones are unmapped on release)
+  char* Allocate(uint32_t size);
+  void Release(char* data, uint32_t size);
+
+  // Called after each GC: pages that were released before the previous call
+  // and weren't reused since then are given back to OS
+  void Trim();
+
+  // Maximum number of pages kept in the pool
+  static const uint32_t kMaxPooledPages = 32;
+
+  inline uint32_t page_size() { return page_size_; }
+
+  // Pages released since last Trim(), released before it, returned to OS
+  inline uint32_t released_count() { return released_.length(); }
+  inline uint32_t cached_count() { return cached_.length(); }
+  inline uint32_t clean_count() { return clean_.length(); }
+
+  // Number of chunks mapped from OS so far
+  inline uint32_t mapped_count() { return mapped_count_; }
+
+  // Advise kernel to back pages with transparent huge pages
+  inline bool huge_pages() { return huge_pages_; }
+  inline void huge_pages(bool value) { huge_pages_ = value; }
+
+ protected:
+  char* Map(uint32_t size);
+
+  typedef GenericList<char*, EmptyClass, NopPolicy> ChunkList;
+
+  // Released since last Trim(), released before it, returned to OS
+  ChunkList released_;
+  ChunkList cached_;
+  ChunkList clean_;
+
+  uint32_t page_size_;
+  uint32_t mapped_count_;
+  bool huge_pages_;
+};
+
 class Space {
  public:
   class Page {
    public:
-    explicit Page(uint32_t size) : size_(size) {
-      data_ = new char[size];
+    Page(PagePool* pool, uint32_t size) : size_(size), pool_(pool) {
+      data_ = pool->Allocate(size);
       // Make all offsets odd (pointers are tagged with 1 at last bit)
       top_ = data_ + 1;
+      scan_ = top_;
       limit_ = data_ + size;
     }
     ~Page() {
-      delete[] data_;
+      pool_->Release(data_, size_);
     }
 
     char* data_;
     char* top_;
     char* limit_;
     uint32_t size_;
+
+    // Used by GC to visit objects copied into page
+    char* scan_;
+
+    PagePool* pool_;
   };
 
+  typedef List<Page*, EmptyClass> PageList;
+
   Space(Heap* heap, uint32_t page_size);
 
   // Adds empty page of specific size
@@ -82,10 +165,18 @@ class Space {
   // Deallocate all pages and take all from the `space`
   void Swap(Space* space);
 
+  // Free all objects that weren't marked by GC and reset marks of others
+  void Sweep();
+
+  // Mark unused memory as free block (to keep pages iterable),
+  // blocks that are big enough will be reused by allocation
+  void AddFiller(char* addr, uint32_t size);
+
   // Remove all pages
   void Clear();
 
   inline Heap* heap() { return heap_; }
+  inline PageList* pages() { return &pages_; }
 
   // Both top and limit are always pointing to current page's
   // top and limit.
@@ -99,9 +190,26 @@ class Space {
 
   inline uint32_t size() { return size_; }
   inline uint32_t size_limit() { return size_limit_; }
-  inline void compute_size_limit() {
-    size_limit_ = size_ << 1;
-  }
+
+  // Bytes of live (at last GC) and allocated objects, memory in free lists
+  // isn't counted
+  inline uint32_t used() { return used_; }
+
+  // Bytes between start and top of all pages (generated code is allocating
+  // without updating `used`)
+  uint32_t allocated();
+
+  // GC is requested when space grows over `size * growth_factor`
+  // (limit is never lower than initial size and higher than max size)
+  void compute_size_limit();
+
+  inline void initial_size(uint32_t size) { initial_size_ = size; }
+  inline void max_size(uint32_t size) { max_size_ = size; }
+  inline double growth_factor() { return growth_factor_; }
+  inline void growth_factor(double factor) { growth_factor_ = factor; }
+
+  // Free blocks and pages are indexed by log2 of their free bytes
+  static const uint32_t kSizeClasses = 32;
 
  protected:
   Heap* heap_;
@@ -111,18 +219,155 @@ class Space {
 
   char* root_;
 
+  // Previously selected page is put into the page index
   inline void select(Page* page);
 
+  // Index pages that have free memory at the end (all except current one)
+  void IndexPage(Page* page);
+  void ReindexPages();
+  Page* FindPage(uint32_t bytes);
+
+  char* AllocateFromFreeList(uint32_t bytes);
+  void AddFreeBlock(char* addr, uint32_t size);
+  void ClearFreeList();
+
   List<Page*, EmptyClass> pages_;
   uint32_t page_size_;
+  Page* current_;
+
+  // Pages that may be selected for bump allocation, by size class
+  typedef GenericList<Page*, EmptyClass, NopPolicy> PageIndex;
+  PageIndex page_index_[kSizeClasses];
+
+  // Gaps between live objects (odd addresses, as ordinary objects),
+  // by size class
+  typedef GenericList<char*, EmptyClass, NopPolicy> FreeList;
+  FreeList free_lists_[kSizeClasses];
 
   uint32_t size_;
   uint32_t size_limit_;
+  uint32_t used_;
+
+  uint32_t initial_size_;
+  uint32_t max_size_;
+  double growth_factor_;
 };
 
-typedef HashMap<NumberKey, HValueReference, EmptyClass> HValueRefMap;
+class LargeSpace {
+ public:
+  explicit LargeSpace(Heap* heap);
+  ~LargeSpace();
+
+  // Map region for object (address is odd, as ones returned by Space)
+  char* Allocate(uint32_t bytes, bool tenured);
+
+  // Move object reached by new space GC to the old generation
+  void Promote(HValue* value);
+
+  // Unmap young objects that weren't promoted
+  void SweepNew();
+
+  // Unmap old objects that weren't marked by GC and reset marks of others
+  void SweepOld();
+
+  typedef GenericList<char*, EmptyClass, NopPolicy> ObjectList;
+
+  inline Heap* heap() { return heap_; }
+  inline ObjectList* objects() { return &objects_; }
+  inline uint32_t new_size() { return new_size_; }
+  inline uint32_t old_size() { return old_size_; }
+
+  // Region header (contains region's size) + object's tag byte offset
+  static const uint32_t kHeaderSize = 16;
+
+ protected:
+  static inline uint32_t RegionSize(char* addr) {
+    return *reinterpret_cast<uint32_t*>(addr - 1 - kHeaderSize);
+  }
+  void Free(char* addr);
+
+  Heap* heap_;
+
+  ObjectList objects_;
+
+  uint32_t new_size_;
+  uint32_t old_size_;
+
+  // Old space GC is requested when old objects are taking more
+  uint32_t old_size_limit_;
+};
+
+// Feedback of literal allocation site, fields are accessed by generated code
+class AllocationSite {
+ public:
+  explicit AllocationSite(uint16_t index);
+
+  static const int kAllocatedOffset = 0;
+  static const int kTenuredOffset = kAllocatedOffset + sizeof(intptr_t);
+  static const int kHeaderOffset = kTenuredOffset + sizeof(intptr_t);
+
+  inline uint16_t index() { return index_; }
+  inline bool is_tenured() { return tenured_ != 0; }
+
+  // Objects allocated since last decision
+  intptr_t allocated_;
+  intptr_t tenured_;
+
+  // Index shifted to its position in the object's header (zero on ia32)
+  intptr_t header_;
+
+  // Objects that survived their first new space GC
+  uint32_t survived_;
+
+  // Objects of tenured site that were found dead by old space sweep
+  uint32_t died_;
+  uint16_t index_;
+};
+
+// Slots of local handles (see candor::HandleScope), allocated in blocks and
+// released by scopes in LIFO order
+class HandleArena {
+ public:
+  HandleArena();
+  ~HandleArena();
+
+  inline char** Allocate(char* value) {
+    if (top_ == limit_) Grow();
+    *top_ = value;
+    return top_++;
+  }
+
+  // Scope saves top slot and block on entering and restores them on leave,
+  // blocks are kept for reuse
+  void Restore(char** top, int block);
+
+  inline char** top() { return top_; }
+  inline int block() { return block_; }
+
+  // All slots of blocks below the current one are used
+  inline char** block_start(int index) { return blocks_[index]; }
+  inline char** block_end(int index) {
+    return index == block_ ? top_ : blocks_[index] + kBlockSize;
+  }
+
+  static const int kBlockSize = 1024;
+
+ protected:
+  void Grow();
+
+  char** top_;
+  char** limit_;
+  int block_;
+
+  char*** blocks_;
+  int block_count_;
+  int block_capacity_;
+};
+
+typedef OpenHashMap<NumberKey, HValueReference> HValueRefMap;
 typedef List<HValueReference, EmptyClass> HValueRefList;
-typedef HashMap<NumberKey, HValueWeakRef, EmptyClass> HValueWeakRefMap;
+typedef OpenHashMap<NumberKey, HValueWeakRef> HValueWeakRefMap;
+typedef GenericList<HValueWeakRef*, EmptyClass, NopPolicy> HValueWeakRefList;
 
 class Heap {
  public:
@@ -139,7 +384,11 @@ class Heap {
     kTagFunction,
     kTagCData,
 
-    kTagMap
+    kTagMap,
+    kTagShape,
+
+    // Free memory in old space (left by sweeping)
+    kTagFree
   };
 
   enum TenureType {
@@ -150,7 +399,8 @@ class Heap {
   enum GCType {
     kGCNone     = 0,
     kGCNewSpace = 1,
-    kGCOldSpace = 2
+    kGCOldSpace = 2,
+    kGCMarkingStep = 3
   };
 
   enum Error {
@@ -183,13 +433,25 @@ class Heap {
 
   // Tenure configuration (GC)
   static const int8_t kMinOldSpaceGeneration = 5;
+  static const uint32_t kLargeObjectSize = 64 * 1024;
   static const uint32_t kMinFactorySize = 128;
+
+  // Allocation site is pretenured when at least kPretenureRatio percents of
+  // (at least kMinSiteAllocations) its objects are surviving new space GC
+  static const uint32_t kMaxAllocationSites = 0xffff;
+  static const uint32_t kMinSiteAllocations = 100;
+  static const uint32_t kPretenureRatio = 85;
+
+  // Tenured site is allocating in new space again when at least
+  // kDetenureRatio percents of its objects are dying in old space
+  static const uint32_t kDetenureRatio = 50;
   static const uint32_t kBindingContextTag = 0x0DEC0DEC;
   static const uint32_t kEnterFrameTag = 0xFEEDBEEE;
   static const uint32_t kICDisabledValue = 0xABBAABBA;
   static const uint32_t kICZapValue = 0xABBADEEC;
 
   explicit Heap(uint32_t page_size);
+  ~Heap();
 
   // TODO(indutny): Use thread id
   static inline Heap* Current() { return current_; }
@@ -210,8 +472,13 @@ class Heap {
   void AddWeak(HValue* value, WeakCallback callback);
   void RemoveWeak(HValue* value);
 
+  // Write barrier: should be called after storing `value` in `holder`'s slot
+  inline void RecordWrite(char* holder, char* value);
+
+  inline PagePool* page_pool() { return &page_pool_; }
   inline Space* new_space() { return &new_space_; }
   inline Space* old_space() { return &old_space_; }
+  inline LargeSpace* large_space() { return &large_space_; }
 
   inline Space* space(TenureType type) {
     if (type == kTenureOld) {
@@ -232,13 +499,71 @@ class Heap {
   inline void needs_gc(GCType value) { needs_gc_ = value; }
   inline HValueRefMap* references() { return &references_; }
   inline HValueWeakRefMap* weak_references() { return &weak_references_; }
+  inline HandleArena* handles() { return &handles_; }
+  inline HValueList* remembered_set() { return &remembered_set_; }
 
   inline GC* gc() { return &gc_; }
+
+  // Number of new space GCs that object should survive to be promoted
+  inline uint8_t tenure_generation() { return tenure_generation_; }
+  inline void tenure_generation(uint8_t generation) {
+    if (generation < 1) generation = 1;
+    if (generation > kMinOldSpaceGeneration) {
+      generation = kMinOldSpaceGeneration;
+    }
+    tenure_generation_ = generation;
+  }
+
+  // Hard limit of heap size (zero - no limit), handler is called if
+  // heap is still bigger after full GC. Old space is accounted by used
+  // memory, fragmentation isn't a reason to fail.
+  typedef void (*OutOfMemoryHandler)(Heap* heap);
+
+  uint32_t size();
+  inline bool IsOverLimit() { return limit_ != 0 && size() > limit_; }
+  void OutOfMemory();
+
+  inline uint32_t limit() { return limit_; }
+  inline void limit(uint32_t limit) { limit_ = limit; }
+  inline void out_of_memory_handler(OutOfMemoryHandler handler) {
+    out_of_memory_handler_ = handler;
+  }
+
+  // Site with zero index is shared by all literals that didn't get their own
+  // (it is never pretenured)
+  AllocationSite* NewAllocationSite();
+  inline AllocationSite* allocation_site(uint16_t index) {
+    if (index >= allocation_site_count_) return NULL;
+    return allocation_sites_[index];
+  }
+
+  // Pretenure sites with high survival rate (after new space GC)
+  void UpdateAllocationSites();
+
+  // Called by old space sweep for every dead object, and after it
+  // (reverts pretenuring of sites whose objects aren't long-lived anymore)
+  void RecordOldDeath(HValue* value);
+  void UpdateTenuredSites();
+
   inline CodeSpace* code_space() { return code_space_; }
   inline void code_space(CodeSpace* code_space) { code_space_ = code_space; }
+
+  // Isolate owning the heap (receives out of memory and GC trace events)
+  inline Isolate* isolate() { return isolate_; }
+  inline void isolate(Isolate* isolate) { isolate_ = isolate; }
   inline SourceMap* source_map() { return &source_map_; }
+  inline SafepointTable* safepoints() { return &safepoints_; }
+  inline StubCache* stub_cache() { return &stub_cache_; }
+  inline StringTable* string_table() { return &string_table_; }
+
+  // Shape of empty objects (root of transition tree)
+  inline char** root_shape() { return &root_shape_; }
+
+  // Number of shapes created so far (shapes are never collected)
+  inline uint32_t shape_count() { return shape_count_; }
+  inline void shape_count(uint32_t count) { shape_count_ = count; }
 
-  // Factory methods
+  // Factory methods (booleans are canonical, these are never allocating)
   char* CreateString(const char* key, uint32_t size);
   char* CreateNumber(double num);
   char* CreateBoolean(bool value);
@@ -246,8 +571,10 @@ class Heap {
  private:
   char* ToFactory(char* key);
 
+  PagePool page_pool_;
   Space new_space_;
   Space old_space_;
+  LargeSpace large_space_;
 
   // Support reentering candor after invoking C++ side
   char* last_stack_;
@@ -257,13 +584,31 @@ class Heap {
 
   intptr_t needs_gc_;
 
+  uint8_t tenure_generation_;
+  uint32_t limit_;
+  OutOfMemoryHandler out_of_memory_handler_;
+
   HValueRefMap references_;
   HValueWeakRefMap weak_references_;
+  HandleArena handles_;
+  HValueList remembered_set_;
   HValue* factory_;
+  char* root_shape_;
+  uint32_t shape_count_;
+  char* true_value_;
+  char* false_value_;
+
+  AllocationSite** allocation_sites_;
+  uint32_t allocation_site_count_;
+  uint32_t allocation_site_capacity_;
 
   GC gc_;
   CodeSpace* code_space_;
+  Isolate* isolate_;
   SourceMap source_map_;
+  SafepointTable safepoints_;
+  StubCache stub_cache_;
+  StringTable string_table_;
 
   static Heap* current_;
 };
@@ -291,6 +636,8 @@ class HValue {
     return Cast(addr)->As<T>();
   }
 
+  // Size of object including header
+  uint32_t Size();
   HValue* CopyTo(Space* old_space, Space* new_space);
 
   inline bool IsGCMarked();
@@ -299,11 +646,23 @@ class HValue {
 
   inline bool IsSoftGCMarked();
   inline void SetSoftGCMark();
+  // Atomic version of SetSoftGCMark(), returns false if value was marked
+  inline bool TrySetSoftGCMark();
   inline void ResetSoftGCMark();
 
-  inline void IncrementGeneration();
+  // Object is placed in large object space
+  inline bool IsLarge();
+
+  inline bool IsRemembered();
+  inline void SetRemembered();
+  inline void ResetRemembered();
+
+  inline void IncrementGeneration(uint8_t tenure_generation);
   inline uint8_t Generation();
 
+  // Index of literal's allocation site (zero if unknown)
+  inline uint16_t AllocationSiteIndex();
+
   template <typename Representation>
   static inline Representation GetRepresentation(char* addr) {
     return static_cast<Representation>(*reinterpret_cast<uint8_t*>(
@@ -326,6 +685,27 @@ class HValue {
   static const int kGCForwardOffset = HINTERIOR_OFFSET(1);
   static const int kRepresentationOffset = HINTERIOR_OFFSET(0) + 1;
   static const int kGenerationOffset = HINTERIOR_OFFSET(0) + 2;
+#if CANDOR_ARCH_x64
+  // ia32's header has no free bytes for it
+  static const int kAllocationSiteOffset = HINTERIOR_OFFSET(0) + 4;
+#endif
+
+  // Bit in GC mark byte, set on objects reached by old space marking
+  static const int kSoftGCMark = 0x40;
+
+  // Bit in GC mark byte, set on old objects that are in remembered set
+  static const int kRememberedMark = 0x20;
+
+  // Bit in GC mark byte, set while object is copied by parallel GC thread
+  static const int kBusyMark = 0x10;
+
+  // Bit in GC mark byte, set on objects in large object space
+  static const int kLargeMark = 0x08;
+
+  // Free block's size (including header), blocks that are smaller than
+  // kMinFreeSize are keeping size in the representation byte
+  static const int kFreeSizeOffset = HINTERIOR_OFFSET(1);
+  static const uint32_t kMinFreeSize = 2 * kPointerSize;
 
   static inline int interior_offset(int offset) {
     return HINTERIOR_OFFSET(offset);
@@ -467,6 +847,10 @@ class HString : public HValue {
     kCons   = 0x01
   };
 
+  // Bit in representation byte, set on strings from heap's string table
+  // (they are always flat)
+  static const int kInternalizedMark = 0x80;
+
   static char* New(Heap* heap,
                    Heap::TenureType tenure,
                    uint32_t length);
@@ -490,6 +874,20 @@ class HString : public HValue {
     return *reinterpret_cast<uint32_t*>(addr + kLengthOffset);
   }
 
+  static inline Representation Repr(char* addr) {
+    return static_cast<Representation>(
+        GetRepresentation<uint8_t>(addr) & ~kInternalizedMark);
+  }
+
+  static inline bool IsInternalized(char* addr) {
+    return (GetRepresentation<uint8_t>(addr) & kInternalizedMark) != 0;
+  }
+
+  static inline void SetInternalized(char* addr) {
+    SetRepresentation<uint8_t>(addr, GetRepresentation<uint8_t>(addr) |
+                                     kInternalizedMark);
+  }
+
   static inline char* LeftCons(char* addr) { return *LeftConsSlot(addr); }
   static inline char* RightCons(char* addr) { return *RightConsSlot(addr); }
 
@@ -514,10 +912,19 @@ class HString : public HValue {
 };
 
 
+// Objects are starting in shape mode: proto slot contains object's shape
+// (hidden class, shared by objects that were getting the same keys in the same
+// order) and map contains only values, at indexes assigned by shape. Objects
+// that are getting too many keys, non-string keys or deletes are switched to
+// dictionary mode: map contains both keys and values (hashed) and proto slot
+// contains kICDisabledValue.
 class HObject : public HValue {
  public:
-  static char* NewEmpty(Heap* heap, uint32_t size = 16);
-  static void Init(Heap* heap, char* obj, uint32_t size);
+  static char* NewEmpty(Heap* heap, uint32_t size = kDefaultSize);
+  static void Init(Heap* heap,
+                   char* obj,
+                   uint32_t size,
+                   Heap::TenureType tenure = Heap::kTenureNew);
 
   inline char* map() { return *map_slot(); }
   inline char** map_slot() { return MapSlot(addr()); }
@@ -539,12 +946,42 @@ class HObject : public HValue {
   }
   static inline char* Proto(char* addr) { return *ProtoSlot(addr); }
 
+  // Generated code stores sign-extended value
+  static inline bool IsDictionary(char* addr) {
+    return static_cast<uint32_t>(reinterpret_cast<intptr_t>(Proto(addr))) ==
+           Heap::kICDisabledValue;
+  }
+  static inline void SetDictionary(char* addr) {
+    *reinterpret_cast<intptr_t*>(ProtoSlot(addr)) =
+        static_cast<int32_t>(Heap::kICDisabledValue);
+  }
+
+  // Value slots in shape mode (map of size N contains 2 * N slots)
+  static inline uint32_t Capacity(char* addr) {
+    return ((Mask(addr) / kPointerSize) + 1) << 1;
+  }
+
+  // Map size for object that will get `count` properties (and one more)
+  static inline uint32_t SizeFor(uint32_t count) {
+    return RoundUp(PowerOfTwo(count + 1), kDefaultSize << 1) >> 1;
+  }
+
+  // Switch object to dictionary mode
+  static void Normalize(Heap* heap,
+                        char* addr,
+                        uint32_t min_size = kMinDictionarySize);
+
+  // Returns NULL if there's no such property and `insert` is 0 (missing
+  // keys of objects in shape mode have no slot)
   static char** LookupProperty(Heap* heap, char* addr, char* key, int insert);
 
   static const int kMaskOffset = HINTERIOR_OFFSET(1);
   static const int kMapOffset = HINTERIOR_OFFSET(2);
   static const int kProtoOffset = HINTERIOR_OFFSET(3);
 
+  static const uint32_t kDefaultSize = 2;
+  static const uint32_t kMinDictionarySize = 16;
+
   static const Heap::HeapTag class_tag = Heap::kTagObject;
 };
 
@@ -568,7 +1005,9 @@ class HArray : public HObject {
 
 class HMap : public HValue {
  public:
-  static char* NewEmpty(Heap* heap, uint32_t size);
+  static char* NewEmpty(Heap* heap,
+                        uint32_t size,
+                        Heap::TenureType tenure = Heap::kTenureNew);
 
   inline bool IsEmptySlot(uint32_t index);
   inline HValue* GetSlot(uint32_t index);
@@ -586,6 +1025,67 @@ class HMap : public HValue {
 };
 
 
+// Keys of shape are mapped to indexes of value slots by hash table (in the
+// same format as dictionary's map). Transitions to shapes with one more key
+// are weak: old space GC removes transitions to shapes that aren't used by
+// live objects (or their descendants, parent references are strong).
+// Shapes are tenured and not moving.
+class HShape : public HValue {
+ public:
+  static char* New(Heap* heap, uint32_t count);
+
+  // Index of key's value slot (-1 if there is no such key)
+  static intptr_t Lookup(Heap* heap, char* addr, char* key);
+
+  // Shape with one more key (NULL if object should be switched to
+  // dictionary mode)
+  static char* Transition(Heap* heap, char* addr, char* key);
+
+  static inline uint32_t Count(char* addr) {
+    return *reinterpret_cast<intptr_t*>(addr + kCountOffset);
+  }
+  static inline char** TableSlot(char* addr) {
+    return reinterpret_cast<char**>(addr + kTableOffset);
+  }
+  static inline char* Table(char* addr) { return *TableSlot(addr); }
+  static inline char** TransitionsSlot(char* addr) {
+    return reinterpret_cast<char**>(addr + kTransitionsOffset);
+  }
+  static inline char* Transitions(char* addr) {
+    return *TransitionsSlot(addr);
+  }
+  static inline char** ParentSlot(char* addr) {
+    return reinterpret_cast<char**>(addr + kParentOffset);
+  }
+  static inline char* Parent(char* addr) { return *ParentSlot(addr); }
+
+  inline char** table_slot() { return TableSlot(addr()); }
+  inline char** parent_slot() { return ParentSlot(addr()); }
+
+  // Slot of key in table (or empty one, where key should be inserted),
+  // value slot follows key slots at `mask + kPointerSize`
+  static char** FindKey(Heap* heap, char* table, char* key);
+
+  // Masks are stored for generated code
+  static const int kCountOffset = HINTERIOR_OFFSET(1);
+  static const int kTableOffset = HINTERIOR_OFFSET(2);
+  static const int kMaskOffset = HINTERIOR_OFFSET(3);
+  static const int kTransitionsOffset = HINTERIOR_OFFSET(4);
+  static const int kTransitionMaskOffset = HINTERIOR_OFFSET(5);
+  static const int kTransitionCountOffset = HINTERIOR_OFFSET(6);
+  static const int kParentOffset = HINTERIOR_OFFSET(7);
+
+  static const uint32_t kMaxProperties = 32;
+  static const uint32_t kMaxTransitions = 32;
+
+  // Objects with generated keys switch to dictionary mode once the heap has
+  // this many live shapes (dead ones are collected by old space GC)
+  static const uint32_t kMaxShapes = 8192;
+
+  static const Heap::HeapTag class_tag = Heap::kTagShape;
+};
+
+
 class HFunction : public HValue {
  public:
   static char* New(Heap* heap, char* parent, char* addr, char* root);
@@ -143,6 +143,11 @@ inline Root* HIRGen::root() {
 }
 
 
+inline void HIRGen::feedback(TypeFeedback* feedback) {
+  feedback_ = feedback;
+}
+
+
 inline int HIRGen::block_id() {
   return block_id_++;
 }
@@ -116,6 +116,26 @@ inline bool HIRInstruction::IsBoolean() {
 }
 
 
+inline bool HIRInstruction::IsDouble() {
+  return double_;
+}
+
+
+inline void HIRInstruction::MarkDouble() {
+  double_ = true;
+}
+
+
+inline bool HIRInstruction::HasDoubleArgs() {
+  return double_args_;
+}
+
+
+inline void HIRInstruction::MarkDoubleArgs() {
+  double_args_ = true;
+}
+
+
 inline bool HIRInstruction::IsPinned() {
   return pinned_;
 }
@@ -275,6 +295,16 @@ inline BinOp::BinOpType HIRBinOp::binop_type() {
 }
 
 
+inline bool HIRBinOp::HasSmiFeedback() {
+  return smi_feedback_;
+}
+
+
+inline void HIRBinOp::MarkSmiFeedback() {
+  smi_feedback_ = true;
+}
+
+
 inline ScopeSlot* HIRLoadContext::context_slot() {
   return context_slot_;
 }
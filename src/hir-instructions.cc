@@ -34,6 +34,7 @@ HIRInstruction::HIRInstruction(Type type)
       gvn_visited(0),
       alias_visited(0),
       is_live(0),
+      is_unboxable(0),
       type_(type),
       slot_(NULL),
       ast_(NULL),
@@ -42,7 +43,9 @@ HIRInstruction::HIRInstruction(Type type)
       hash_(0),
       removed_(false),
       pinned_(true),
-      representation_(kHoleRepresentation) {
+      representation_(kHoleRepresentation),
+      double_(false),
+      double_args_(false) {
 }
 
 
@@ -52,6 +55,7 @@ HIRInstruction::HIRInstruction(Type type, ScopeSlot* slot)
       gvn_visited(0),
       alias_visited(0),
       is_live(0),
+      is_unboxable(0),
       type_(type),
       slot_(slot),
       ast_(NULL),
@@ -60,7 +64,9 @@ HIRInstruction::HIRInstruction(Type type, ScopeSlot* slot)
       hash_(0),
       removed_(false),
       pinned_(true),
-      representation_(kHoleRepresentation) {
+      representation_(kHoleRepresentation),
+      double_(false),
+      double_args_(false) {
 }
 
 
@@ -415,7 +421,8 @@ bool HIRGetStackTrace::HasSideEffects() {
 
 
 HIRBinOp::HIRBinOp(BinOp::BinOpType type) : HIRInstruction(kBinOp),
-                                            binop_type_(type) {
+                                            binop_type_(type),
+                                            smi_feedback_(false) {
 }
 
 
@@ -533,7 +540,7 @@ bool HIRDeleteProperty::Effects(HIRInstruction* instr) {
 
 HIRAllocateObject::HIRAllocateObject(int size)
     : HIRInstruction(kAllocateObject),
-      size_(RoundUp(PowerOfTwo(size + 1), 64)) {
+      size_(HObject::SizeFor(size)) {
 }
 
 
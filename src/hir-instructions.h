@@ -112,6 +112,7 @@ class HIRInstruction : public ZoneObject {
   int gvn_visited;
   int alias_visited;
   int is_live;
+  int is_unboxable;
 
   virtual void ReplaceArg(HIRInstruction* o, HIRInstruction* n);
   virtual bool HasSideEffects();
@@ -140,6 +141,12 @@ class HIRInstruction : public ZoneObject {
   inline bool IsString();
   inline bool IsBoolean();
 
+  // Unboxed doubles (see HIRGen::InferDoubles())
+  inline bool IsDouble();
+  inline void MarkDouble();
+  inline bool HasDoubleArgs();
+  inline void MarkDoubleArgs();
+
   inline bool IsPinned();
   inline HIRInstruction* Unpin();
   inline HIRInstruction* Pin();
@@ -181,6 +188,10 @@ class HIRInstruction : public ZoneObject {
   // Cached representation
   Representation representation_;
 
+  // Value is kept in double register, and/or arguments are unboxed
+  bool double_;
+  bool double_args_;
+
   HIRInstructionList args_;
   HIRInstructionList uses_;
   HIRInstructionList effects_in_;
@@ -345,12 +356,17 @@ class HIRBinOp : public HIRInstruction {
   void CalculateRepresentation();
   inline BinOp::BinOpType binop_type();
 
+  // Baseline code has seen only small integers as operands
+  inline bool HasSmiFeedback();
+  inline void MarkSmiFeedback();
+
   HIR_DEFAULT_METHODS(BinOp)
 
  protected:
   bool IsGVNEqual(HIRInstruction* to);
 
   BinOp::BinOpType binop_type_;
+  bool smi_feedback_;
 };
 
 class HIRLoadContext : public HIRInstruction {
@@ -25,6 +25,7 @@
 #include <string.h>  // memset, memcpy
 
 #include "hir-inl.h"
+#include "lir.h"  // kLIRDoubleRegisterCount
 #include "macroassembler.h"  // Label
 #include "splay-tree.h"
 
@@ -40,6 +41,7 @@ HIRGen::HIRGen(Heap* heap, Root* root, const char* filename)
       break_continue_info_(NULL),
       root_(root),
       filename_(filename),
+      feedback_(NULL),
       loop_depth_(0),
       block_id_(0),
       instr_id_(-2),
@@ -84,6 +86,9 @@ void HIRGen::Build(AstNode* root) {
   GlobalValueNumbering();
   GlobalCodeMotion();
 
+  // Only backends with allocatable double registers can keep them unboxed
+  if (kLIRDoubleRegisterCount > 0) InferDoubles();
+
   if (log_) {
     PrintBuffer p(stdout);
     p.Print("## HIR %s Start ##\n", filename_ == NULL ? "unknown" : filename_);
@@ -646,6 +651,118 @@ HIRBlock* HIRGen::FindLCA(HIRBlock* a, HIRBlock* b) {
 }
 
 
+static inline bool IsNumberLiteral(HIRInstruction* instr) {
+  if (!instr->Is(HIRInstruction::kLiteral)) return false;
+
+  HIRInstruction::Representation r = instr->representation();
+  return r == HIRInstruction::kSmiRepresentation ||
+         r == HIRInstruction::kHeapNumberRepresentation;
+}
+
+
+static inline bool IsDoubleSource(HIRInstruction* instr) {
+  return instr->IsDouble() ||
+         (instr->Is(HIRInstruction::kLiteral) &&
+          instr->representation() == HIRInstruction::kHeapNumberRepresentation);
+}
+
+
+// Finds values that can live in double registers: results of math operations
+// and phis that are always numbers and at least one of the operands is
+// a heap number (or result of division). Type of phi depends on its inputs
+// (and in loops - on itself), so everything is assumed to be a number first
+// and then assumptions are refuted until fixed point.
+void HIRGen::InferDoubles() {
+  HIRInstructionList values;
+
+  HIRBlockList::Item* bhead = blocks_.head();
+  for (; bhead != NULL; bhead = bhead->next()) {
+    HIRInstructionList::Item* ihead = bhead->value()->instructions()->head();
+    for (; ihead != NULL; ihead = ihead->next()) {
+      HIRInstruction* instr = ihead->value();
+
+      if (IsNumberLiteral(instr) ||
+          instr->Is(HIRInstruction::kPhi) ||
+          (instr->Is(HIRInstruction::kBinOp) &&
+           BinOp::is_math(HIRBinOp::Cast(instr)->binop_type()))) {
+        instr->is_unboxable = 1;
+        values.Push(instr);
+      }
+    }
+  }
+
+  // Value is a number only if all its inputs are numbers
+  bool change;
+  HIRInstructionList::Item* vhead;
+  do {
+    change = false;
+
+    for (vhead = values.head(); vhead != NULL; vhead = vhead->next()) {
+      HIRInstruction* instr = vhead->value();
+      if (!instr->is_unboxable) continue;
+
+      HIRInstructionList::Item* ahead = instr->args()->head();
+      for (; ahead != NULL; ahead = ahead->next()) {
+        if (ahead->value()->is_unboxable) continue;
+
+        instr->is_unboxable = 0;
+        change = true;
+        break;
+      }
+    }
+  } while (change);
+
+  // Numbers that are produced from heap numbers are doubles
+  do {
+    change = false;
+
+    for (vhead = values.head(); vhead != NULL; vhead = vhead->next()) {
+      HIRInstruction* instr = vhead->value();
+      if (!instr->is_unboxable ||
+          instr->IsDouble() ||
+          instr->Is(HIRInstruction::kLiteral)) {
+        continue;
+      }
+
+      bool is_double = instr->Is(HIRInstruction::kBinOp) &&
+                       HIRBinOp::Cast(instr)->binop_type() == BinOp::kDiv;
+
+      HIRInstructionList::Item* ahead = instr->args()->head();
+      for (; !is_double && ahead != NULL; ahead = ahead->next()) {
+        is_double = IsDoubleSource(ahead->value());
+      }
+      if (!is_double) continue;
+
+      instr->MarkDouble();
+      instr->MarkDoubleArgs();
+      change = true;
+    }
+  } while (change);
+
+  // Comparisons of doubles and branches on them don't need boxed values too
+  bhead = blocks_.head();
+  for (; bhead != NULL; bhead = bhead->next()) {
+    HIRInstructionList::Item* ihead = bhead->value()->instructions()->head();
+    for (; ihead != NULL; ihead = ihead->next()) {
+      HIRInstruction* instr = ihead->value();
+
+      if (instr->Is(HIRInstruction::kIf)) {
+        if (instr->left()->IsDouble()) instr->MarkDoubleArgs();
+      } else if (instr->Is(HIRInstruction::kBinOp) &&
+                 BinOp::is_logic(HIRBinOp::Cast(instr)->binop_type())) {
+        HIRInstruction* left = instr->left();
+        HIRInstruction* right = instr->right();
+
+        if (left->is_unboxable && right->is_unboxable &&
+            (IsDoubleSource(left) || IsDoubleSource(right))) {
+          instr->MarkDoubleArgs();
+        }
+      }
+    }
+  }
+}
+
+
 HIRInstruction* HIRGen::Visit(AstNode* stmt) {
   // Do not generate code for functions in the ends of the graph
   if (current_block()->IsEnded()) return Add(new HIRNil());
@@ -920,6 +1037,7 @@ HIRInstruction* HIRGen::VisitUnOp(AstNode* stmt) {
           BinOp::kAdd : BinOp::kSub;
 
     AstNode* wrap = new BinOp(type, op->lhs(), one);
+    wrap->id = stmt->id;
 
     if (op->subtype() == UnOp::kPreInc || op->subtype() == UnOp::kPreDec) {
       res = Visit(wrap);
@@ -936,6 +1054,7 @@ HIRInstruction* HIRGen::VisitUnOp(AstNode* stmt) {
           ->AddArg(ione);
 
       bin->ast(wrap);
+      ApplyTypeFeedback(bin);
       value = bin;
     }
 
@@ -972,6 +1091,7 @@ HIRInstruction* HIRGen::VisitUnOp(AstNode* stmt) {
     type = op->subtype() == UnOp::kPlus ? BinOp::kAdd : BinOp::kSub;
 
     AstNode* wrap = new BinOp(type, zero, op->lhs());
+    wrap->id = stmt->id;
 
     return Visit(wrap);
   } else if (op->subtype() == UnOp::kNot) {
@@ -1028,10 +1148,23 @@ HIRInstruction* HIRGen::VisitBinOp(AstNode* stmt) {
   }
 
   res->ast(stmt);
+  ApplyTypeFeedback(res);
   return res;
 }
 
 
+void HIRGen::ApplyTypeFeedback(HIRInstruction* instr) {
+  if (feedback_ == NULL) return;
+
+  TypeFeedback::Site* site = feedback_->Lookup(instr->ast()->id);
+  if (site == NULL) return;
+
+  // Specialize operation for small integers, it'll still fallback to the
+  // generic stub if the guess was wrong
+  if (site->IsSmi()) HIRBinOp::Cast(instr)->MarkSmiFeedback();
+}
+
+
 HIRInstruction* HIRGen::VisitObjectLiteral(AstNode* stmt) {
   ObjectLiteral* obj = ObjectLiteral::Cast(stmt);
   HIRInstruction* res = Add(new HIRAllocateObject(obj->keys()->length()));
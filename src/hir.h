@@ -35,6 +35,7 @@
 #include "visitor.h"  // Visitor
 #include "zone.h"  // ZoneObject
 #include "utils.h"  // PrintBuffer
+#include "type-feedback.h"  // TypeFeedback
 
 namespace candor {
 namespace internal {
@@ -204,6 +205,7 @@ class HIRGen : public Visitor<HIRInstruction> {
   void ScheduleEarly(HIRInstruction* instr, HIRBlock* root);
   void ScheduleLate(HIRInstruction* instr);
   HIRBlock* FindLCA(HIRBlock* a, HIRBlock* b);
+  void InferDoubles();
 
   void Replace(HIRInstruction* o, HIRInstruction* n);
 
@@ -272,6 +274,10 @@ class HIRGen : public Visitor<HIRInstruction> {
 
   inline Root* root();
 
+  // Types recorded by baseline code (optional)
+  inline void feedback(TypeFeedback* feedback);
+  void ApplyTypeFeedback(HIRInstruction* instr);
+
   inline int block_id();
   inline int instr_id();
   inline int dfs_id();
@@ -287,6 +293,7 @@ class HIRGen : public Visitor<HIRInstruction> {
   HIRBlockList blocks_;
   Root* root_;
   const char* filename_;
+  TypeFeedback* feedback_;
   int loop_depth_;
 
   int block_id_;
@@ -202,6 +202,13 @@ void Assembler::testb(Register dst, const Immediate src) {
 }
 
 
+void Assembler::testb(const Operand& dst, const Immediate src) {
+  emitb(0xF6);
+  emit_modrm(dst, 0);
+  emitb(src.value());
+}
+
+
 void Assembler::testl(Register dst, const Immediate src) {
   assert(dst != esi && dst != edi);
   emitb(0xF7);
@@ -241,6 +248,12 @@ void Assembler::jmp(Condition cond, Label* label) {
 }
 
 
+void Assembler::jmp(Register dst) {
+  emitb(0xFF);
+  emit_modrm(dst, 4);
+}
+
+
 void Assembler::mov(Register dst, Register src) {
   emitb(0x8B);
   emit_modrm(dst, src);
@@ -407,6 +420,12 @@ void Assembler::inc(Register dst) {
 }
 
 
+void Assembler::inc(const Operand& dst) {
+  emitb(0xFF);
+  emit_modrm(dst, 0x00);
+}
+
+
 void Assembler::dec(Register dst) {
   emitb(0xFF);
   emit_modrm(dst, 0x01);
@@ -292,6 +292,7 @@ class Assembler {
   void bind(Label* label);
   void jmp(Label* label);
   void jmp(Condition cond, Label* label);
+  void jmp(Register dst);
 
   void cmpl(Register dst, Register src);
   void cmpl(Register dst, const Operand& src);
@@ -303,6 +304,7 @@ class Assembler {
   void cmpb(const Operand& dst, const Immediate src);
 
   void testb(Register dst, const Immediate src);
+  void testb(const Operand& dst, const Immediate src);
   void testl(Register dst, const Immediate src);
 
   void mov(Register dst, Register src);
@@ -335,6 +337,7 @@ class Assembler {
   void xorl(Register dst, Register src);
 
   void inc(Register dst);
+  void inc(const Operand& dst);
   void dec(Register dst);
   void shl(Register dst, const Immediate src);
   void shr(Register dst, const Immediate src);
@@ -58,6 +58,48 @@ void FLabel::Generate(Masm* masm) {
 
 
 void FEntry::Generate(Masm* masm) {
+  if (site_ != NULL) {
+    Label optimized, baseline;
+    Immediate site(reinterpret_cast<intptr_t>(site_));
+    Immediate root_addr(
+        reinterpret_cast<intptr_t>(masm->heap()->old_space()->root()));
+    Operand code(scratch, Tiering::Site::kCodeOffset);
+    Operand root(scratch, Tiering::Site::kRootOffset);
+    Operand calls(scratch, Tiering::Site::kCallsOffset);
+    Operand scratch_op(scratch, 0);
+
+    __ mov(scratch, site);
+    __ cmpl(code, Immediate(0));
+    __ jmp(kNe, &optimized);
+
+    // Count invocation and request optimization once function is hot
+    __ inc(calls);
+    __ cmpl(calls, Immediate(Tiering::kCallThreshold));
+    __ jmp(kNe, &baseline);
+
+    __ push(scratch);
+    __ Call(masm->stubs()->GetOptimizeStub());
+    __ addlb(esp, Immediate(4));
+
+    // Optimization may fail, continue in baseline code then
+    __ mov(scratch, site);
+    __ cmpl(code, Immediate(0));
+    __ jmp(kEq, &baseline);
+
+    // Enter optimized code with its own root
+    __ bind(&optimized);
+    __ push(eax);
+    __ mov(eax, root);
+    __ mov(scratch, root_addr);
+    __ mov(scratch_op, eax);
+    __ pop(eax);
+    __ mov(scratch, site);
+    __ mov(scratch, code);
+    __ jmp(scratch);
+
+    __ bind(&baseline);
+  }
+
   __ push(ebp);
   __ mov(ebp, esp);
 
@@ -141,6 +183,7 @@ void FStoreContext::Generate(Masm* masm) {
   Operand res(scratch, HContext::GetIndexDisp(inputs[0]->index()));
   __ mov(eax, *inputs[1]->ToOperand());
   __ mov(res, eax);
+  __ RecordWrite(scratch, eax);
 }
 
 
@@ -201,6 +244,7 @@ void FStoreProperty::Generate(Masm* masm) {
 
   Operand slot(eax, 0);
   __ mov(slot, ecx);
+  __ RecordWrite(ebx, ecx);
 
   __ bind(&done);
 }
@@ -364,6 +408,10 @@ void FBinOp::Generate(Masm* masm) {
   // ebx <- rhs
   __ mov(eax, *inputs[0]->ToOperand());
   __ mov(ebx, *inputs[1]->ToOperand());
+  if (site_ != NULL) {
+    __ RecordTypeFeedback(eax, site_);
+    __ RecordTypeFeedback(ebx, site_);
+  }
   __ Call(stub);
   // result -> eax
   __ mov(*result->ToOperand(), eax);
@@ -560,6 +608,24 @@ void FCall::Generate(Masm* masm) {
 }
 
 
+void FBackEdge::Generate(Masm* masm) {
+  Label done;
+  Operand back_edges(scratch, Tiering::Site::kBackEdgesOffset);
+
+  __ mov(scratch, Immediate(reinterpret_cast<intptr_t>(site_)));
+  __ inc(back_edges);
+  __ cmpl(back_edges, Immediate(Tiering::kBackEdgeThreshold));
+  __ jmp(kNe, &done);
+
+  // Loop is hot, optimized code will be used on the next call
+  __ push(scratch);
+  __ Call(masm->stubs()->GetOptimizeStub());
+  __ addlb(esp, Immediate(4));
+
+  __ bind(&done);
+}
+
+
 void FCollectGarbage::Generate(Masm* masm) {
   __ Call(masm->stubs()->GetCollectGarbageStub());
 }
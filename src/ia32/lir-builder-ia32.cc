@@ -29,6 +29,13 @@
 namespace candor {
 namespace internal {
 
+LInstruction* LGen::BoxDouble(HIRInstruction* instr) {
+  // Doubles are always boxed on ia32
+  UNEXPECTED
+  return NULL;
+}
+
+
 void LGen::VisitNop(HIRInstruction* instr) {
 }
 
@@ -101,8 +108,13 @@ void LGen::VisitBinOp(HIRInstruction* instr) {
   LInterval* rhs = ToFixed(instr->right(), ebx);
   HIRBinOp* hir = HIRBinOp::Cast(instr);
 
-  if (instr->right()->IsNumber() && instr->left()->IsNumber() &&
-      BinOp::is_math(hir->binop_type()) && hir->binop_type() != BinOp::kDiv) {
+  // Use inlined smi fast path if operands are known to be numbers or
+  // if baseline code has seen only smis there
+  BinOp::BinOpType type = hir->binop_type();
+  bool numbers = hir->HasSmiFeedback() ||
+                 (instr->right()->IsNumber() && instr->left()->IsNumber());
+  if (numbers && (BinOp::is_logic(type) ||
+                  (BinOp::is_math(type) && type != BinOp::kDiv))) {
     op = Bind(new LBinOpNumber())
         ->MarkHasCall()
         ->AddScratch(CreateVirtual())
@@ -27,6 +27,8 @@
 #include "lir-instructions.h"
 #include "lir-instructions-inl.h"
 #include "macroassembler.h"
+#include "code-space.h"  // CodeSpace
+#include "pic.h"  // PIC
 #include "stubs.h"  // Stubs
 
 namespace candor {
@@ -40,6 +42,13 @@ Register LUse::ToRegister() {
 }
 
 
+DoubleRegister LUse::ToDoubleRegister() {
+  // Doubles are always boxed on ia32
+  UNEXPECTED
+  return xmm0;
+}
+
+
 Operand* LUse::ToOperand() {
   assert(is_stackslot());
 
@@ -195,16 +204,50 @@ void LBranchNumber::Generate(Masm* masm) {
 
 
 
+// Jumps to `miss` if object in eax doesn't have shape cached by PIC's inline
+// entry, otherwise puts object's map into ebx and address of value's slot
+// into edx (eax, ebx and ecx are preserved on miss)
+static void GenerateInlineCache(Masm* masm, PIC* pic, Label* miss) {
+  Operand qproto(eax, HObject::kProtoOffset);
+  Operand qmap(eax, HObject::kMapOffset);
+  Operand cached_shape(scratch, PIC::kShapeOffset);
+  Operand cached_offset(scratch, PIC::kOffsetOffset);
+
+  __ IsUnboxed(eax, NULL, miss);
+  __ IsNil(eax, NULL, miss);
+  __ IsHeapObject(Heap::kTagObject, eax, miss, NULL);
+
+  __ mov(scratch, Immediate(reinterpret_cast<intptr_t>(pic)));
+  __ mov(edx, cached_shape);
+  __ cmpl(edx, qproto);
+  __ jmp(kNe, miss);
+
+  __ mov(edx, cached_offset);
+  __ mov(ebx, qmap);
+  __ addl(edx, ebx);
+}
+
+
 void LLoadProperty::Generate(Masm* masm) {
-  Label done;
+  Label miss, done;
   Masm::Spill eax_s(masm, eax);
 
   // eax <- object
   // ebx <- propery
-  __ mov(ecx, Immediate(0));
   if (HasMonomorphicProperty()) {
-    __ Call(masm->space()->CreatePIC());
+    PIC* pic = masm->space()->CreatePIC();
+    GenerateInlineCache(masm, pic, &miss);
+
+    Operand inline_slot(edx, 0);
+    __ mov(eax, inline_slot);
+    __ xorl(edx, edx);
+    __ jmp(&done);
+
+    __ bind(&miss);
+    __ mov(ecx, Immediate(0));
+    __ Call(pic->addr());
   } else {
+    __ mov(ecx, Immediate(0));
     __ Call(masm->stubs()->GetLookupPropertyStub());
   }
 
@@ -222,17 +265,28 @@ void LLoadProperty::Generate(Masm* masm) {
 
 
 void LStoreProperty::Generate(Masm* masm) {
-  Label done;
+  Label barrier, done;
   Masm::Spill eax_s(masm, eax);
   Masm::Spill ecx_s(masm, ecx);
 
   // eax <- object
   // ebx <- propery
   // ecx <- value
-  __ mov(ecx, Immediate(1));
   if (HasMonomorphicProperty()) {
-    __ Call(masm->space()->CreatePIC());
+    Label miss;
+    PIC* pic = masm->space()->CreatePIC();
+    GenerateInlineCache(masm, pic, &miss);
+
+    Operand inline_slot(edx, 0);
+    __ mov(inline_slot, ecx);
+    __ xorl(edx, edx);
+    __ jmp(&barrier);
+
+    __ bind(&miss);
+    __ mov(ecx, Immediate(1));
+    __ Call(pic->addr());
   } else {
+    __ mov(ecx, Immediate(1));
     __ Call(masm->stubs()->GetLookupPropertyStub());
   }
 
@@ -251,6 +305,9 @@ void LStoreProperty::Generate(Masm* masm) {
   Operand slot(eax, 0);
   __ mov(slot, ecx);
 
+  __ bind(&barrier);
+  __ RecordWrite(ebx, ecx);
+
   // ebx <- object
   __ bind(&done);
 }
@@ -315,29 +372,46 @@ void LBinOpNumber::Generate(Masm* masm) {
   __ IsUnboxed(left, &stub_call, NULL);
   __ IsUnboxed(right, &stub_call, NULL);
 
-  // Save left side in case of overflow
-  __ mov(scratch, left);
+  if (BinOp::is_logic(type)) {
+    Heap* heap = masm->heap();
+    Immediate root(reinterpret_cast<intptr_t>(heap->old_space()->root()));
+    Operand scratch_op(scratch, 0);
+    Operand truev(scratch, HContext::GetIndexDisp(Heap::kRootTrueIndex));
+    Operand falsev(scratch, HContext::GetIndexDisp(Heap::kRootFalseIndex));
 
-  switch (type) {
-    case BinOp::kAdd:
-      __ addl(left, right);
-      break;
-    case BinOp::kSub:
-      __ subl(left, right);
-      break;
-    case BinOp::kMul:
-      __ Untag(left);
-      __ imull(right);
-      break;
-    default:
-      UNEXPECTED
+    // Tagged smis are compared as integers, mov doesn't affect flags
+    __ mov(scratch, root);
+    __ mov(scratch, scratch_op);
+    __ cmpl(left, right);
+    __ mov(left, truev);
+    __ jmp(masm->BinOpToCondition(type, Masm::kIntegral), &done);
+    __ mov(left, falsev);
+    __ jmp(&done);
+  } else {
+    // Save left side in case of overflow
+    __ mov(scratch, left);
+
+    switch (type) {
+      case BinOp::kAdd:
+        __ addl(left, right);
+        break;
+      case BinOp::kSub:
+        __ subl(left, right);
+        break;
+      case BinOp::kMul:
+        __ Untag(left);
+        __ imull(right);
+        break;
+      default:
+        UNEXPECTED
+    }
+
+    __ jmp(kNoOverflow, &done);
+
+    // Restore left side
+    __ mov(left, scratch);
   }
 
-  __ jmp(kNoOverflow, &done);
-
-  // Restore left side
-  __ mov(left, scratch);
-
   __ bind(&stub_call);
 
   char* stub = NULL;
@@ -358,6 +432,33 @@ void LBinOpNumber::Generate(Masm* masm) {
 #undef BINARY_SUB_ENUM
 #undef BINARY_SUB_TYPES
 
+// Doubles are always boxed on ia32
+
+void LBinOpDouble::Generate(Masm* masm) {
+  UNEXPECTED
+}
+
+
+void LCompareDouble::Generate(Masm* masm) {
+  UNEXPECTED
+}
+
+
+void LBoxDouble::Generate(Masm* masm) {
+  UNEXPECTED
+}
+
+
+void LUnboxDouble::Generate(Masm* masm) {
+  UNEXPECTED
+}
+
+
+void LBranchDouble::Generate(Masm* masm) {
+  UNEXPECTED
+}
+
+
 void LFunction::Generate(Masm* masm) {
   // Get function's body address from relocation info
   __ mov(scratches[0]->ToRegister(), Immediate(0));
@@ -556,6 +657,7 @@ void LStoreContext::Generate(Masm* masm) {
   Operand res(scratches[0]->ToRegister(),
               HContext::GetIndexDisp(slot()->index()));
   __ mov(res, inputs[0]->ToRegister());
+  __ RecordWrite(scratches[0]->ToRegister(), inputs[0]->ToRegister());
 }
 
 
@@ -31,6 +31,9 @@ namespace internal {
 
 const int kLIRRegisterCount = 4;
 
+// Doubles are always boxed
+const int kLIRDoubleRegisterCount = 0;
+
 }  // namespace internal
 }  // namespace candor
 
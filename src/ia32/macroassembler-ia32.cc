@@ -38,7 +38,9 @@ Masm::Masm(CodeSpace* space) : space_(space),
                                spill_offset_(4),
                                spill_index_(0),
                                spills_(0),
-                               spill_operand_(ebp, 0) {
+                               spill_operand_(ebp, 0),
+                               live_slots_(NULL),
+                               raw_slots_(NULL) {
 }
 
 
@@ -175,7 +177,9 @@ void Masm::AllocateSpills() {
 void Masm::FinalizeSpills() {
   if (spill_reloc_ == NULL) return;
 
-  spill_reloc_->target(RoundUp(spill_offset_ + ((spills_ + 1) << 2), 16) + 8);
+  uint32_t frame_size = RoundUp(spill_offset_ + ((spills_ + 1) << 2), 16) + 8;
+  spill_reloc_->target(frame_size);
+  FinalizeSafepoints(frame_size);
 }
 
 
@@ -242,8 +246,18 @@ void Masm::AllocateContext(uint32_t slots) {
 
 
 void Masm::AllocateNumber(DoubleRegister value, Register result) {
+  // Runtime allocation clobbers double registers, keep raw value on stack
+  Operand spill(scratch, 0);
+  sublb(esp, Immediate(8));
+  mov(scratch, esp);
+  movd(spill, value);
+
   Allocate(Heap::kTagNumber, reg_nil, HNumber::kDoubleSize, result);
 
+  mov(scratch, esp);
+  movd(value, spill);
+  addlb(esp, Immediate(8));
+
   Operand qvalue(result, HNumber::kValueOffset);
   movd(qvalue, value);
 }
@@ -270,6 +284,9 @@ void Masm::AllocateObjectLiteral(Heap::HeapTag tag,
     // Set length
     if (tag == Heap::kTagArray) {
       mov(qlength, Immediate(0));
+      mov(qproto, Immediate(Heap::kICDisabledValue));
+    } else {
+      LoadRootShape(qproto);
     }
   } else {
     Label array, allocate_map;
@@ -278,12 +295,14 @@ void Masm::AllocateObjectLiteral(Heap::HeapTag tag,
     jmp(kEq, &array);
 
     Allocate(Heap::kTagObject, reg_nil, 3 * HValue::kPointerSize, result);
+    LoadRootShape(qproto);
 
     jmp(&allocate_map);
     bind(&array);
 
     Allocate(Heap::kTagArray, reg_nil, 4 * HValue::kPointerSize, result);
     mov(qlength, Immediate(0));
+    mov(qproto, Immediate(Heap::kICDisabledValue));
 
     bind(&allocate_map);
   }
@@ -311,7 +330,6 @@ void Masm::AllocateObjectLiteral(Heap::HeapTag tag,
 
   Allocate(Heap::kTagMap, size, 0, scratch);
   mov(qmap, scratch);
-  mov(qproto, scratch);
 
   size_s.Unspill();
   mov(result, scratch);
@@ -335,6 +353,16 @@ void Masm::AllocateObjectLiteral(Heap::HeapTag tag,
 }
 
 
+void Masm::LoadRootShape(const Operand& dst) {
+  Immediate root_shape(reinterpret_cast<uint32_t>(heap()->root_shape()));
+  Operand shape(scratch, 0);
+
+  mov(scratch, root_shape);
+  mov(scratch, shape);
+  mov(dst, scratch);
+}
+
+
 void Masm::Fill(Register start, Register end, Immediate value) {
   Push(start);
   mov(scratch, value);
@@ -442,6 +470,23 @@ void Masm::ExitFrameEpilogue() {
 }
 
 
+void Masm::StubCacheEntry(Register shape, Register key, Register result) {
+  assert(!shape.is(scratch) && !key.is(scratch) && !result.is(scratch));
+
+  // result = entries + ((shape ^ key) & mask) * 3
+  mov(result, shape);
+  xorl(result, key);
+  mov(scratch, Immediate(StubCache::kMask));
+  andl(result, scratch);
+  mov(scratch, result);
+  shl(result, Immediate(1));
+  addl(result, scratch);
+  mov(scratch, Immediate(reinterpret_cast<intptr_t>(
+      heap()->stub_cache()->entries())));
+  addl(result, scratch);
+}
+
+
 void Masm::StringHash(Register str, Register result) {
   Operand hash_field(str, HString::kHashOffset);
   Operand repr_field(str, HValue::kRepresentationOffset);
@@ -454,10 +499,7 @@ void Masm::StringHash(Register str, Register result) {
   jmp(kNe, &done);
 
   // Check if string is a cons string
-  push(str);
-  movzxb(str, repr_field);
-  cmpb(str, Immediate(HString::kNormal));
-  pop(str);
+  testb(repr_field, Immediate(HString::kCons));
   jmp(kNe, &call_runtime);
 
   // Compute new hash
@@ -574,6 +616,81 @@ void Masm::CheckGC() {
 }
 
 
+void Masm::RecordWrite(Register holder, Register value) {
+  Operand holder_gen(holder, HValue::kGenerationOffset);
+  Operand value_gen(value, HValue::kGenerationOffset);
+  Operand value_mark(value, HValue::kGCMarkOffset);
+  Operand marking_op(value, 0);
+  Immediate marking_flag(
+      reinterpret_cast<intptr_t>(heap()->gc()->marking_addr()));
+
+  Label record, done;
+
+  // Skip nil and unboxed values
+  IsNil(value, NULL, &done);
+  IsUnboxed(value, NULL, &done);
+
+  // New space holders are visited by every GC anyway
+  cmpb(holder_gen, Immediate(Heap::kMinOldSpaceGeneration));
+  jmp(kLt, &done);
+
+  // Old -> new references should be recorded
+  cmpb(value_gen, Immediate(Heap::kMinOldSpaceGeneration));
+  jmp(kLt, &record);
+
+  // Old -> old references are interesting only during incremental marking
+  // (push/pop aren't affecting flags)
+  push(value);
+  mov(value, marking_flag);
+  cmpb(marking_op, Immediate(0));
+  pop(value);
+  jmp(kEq, &done);
+
+  // Value is already marked
+  testb(value_mark, Immediate(HValue::kSoftGCMark));
+  jmp(kNe, &done);
+
+  bind(&record);
+
+  // Two arguments + alignment
+  push(holder);
+  push(holder);
+  push(holder);
+  push(value);
+  Call(stubs()->GetRecordWriteStub());
+  addlb(esp, Immediate(4 * 4));
+
+  bind(&done);
+}
+
+
+void Masm::RecordTypeFeedback(Register reference, TypeFeedback::Site* site) {
+  assert(!reference.is(scratch));
+
+  Label not_smi, other, done;
+  Operand smi_flag(scratch, TypeFeedback::Site::kSmiOffset);
+  Operand number_flag(scratch, TypeFeedback::Site::kNumberOffset);
+  Operand other_flag(scratch, TypeFeedback::Site::kOtherOffset);
+
+  mov(scratch, Immediate(reinterpret_cast<intptr_t>(site)));
+  IsUnboxed(reference, &not_smi, NULL);
+  movb(smi_flag, Immediate(1));
+  jmp(&done);
+
+  // Check nil first: it has no tag to read
+  bind(&not_smi);
+  IsNil(reference, NULL, &other);
+  IsHeapObject(Heap::kTagNumber, reference, &other, NULL);
+  movb(number_flag, Immediate(1));
+  jmp(&done);
+
+  bind(&other);
+  movb(other_flag, Immediate(1));
+
+  bind(&done);
+}
+
+
 void Masm::IsNil(Register reference, Label* not_nil, Label* is_nil) {
   cmplb(reference, Immediate(Heap::kTagNil));
   if (is_nil != NULL) jmp(kEq, is_nil);
@@ -624,6 +741,7 @@ void Masm::Call(Register addr) {
     nop();
   }
   call(addr);
+  RecordSafepoint();
   nop();
 }
 
@@ -633,6 +751,7 @@ void Masm::Call(const Operand& addr) {
     nop();
   }
   call(addr);
+  RecordSafepoint();
   nop();
 }
 
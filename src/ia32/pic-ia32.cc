@@ -37,11 +37,13 @@ void PIC::Generate(Masm* masm) {
   // Place for spills
   __ pushb(Immediate(Heap::kTagNil));
   __ pushb(Immediate(Heap::kTagNil));
+  __ pushb(Immediate(Heap::kTagNil));
 
   Label miss, end;
   Operand edx_op(edx, 0);
   Operand proto_op(eax, HObject::kProtoOffset);
-  Operand eax_s(ebp, -8), ebx_s(ebp, -12);
+  Operand mask_op(eax, HObject::kMaskOffset);
+  Operand shape_s(ebp, -4), eax_s(ebp, -8), ebx_s(ebp, -12);
 
   __ mov(eax_s, eax);
   __ mov(ebx_s, ebx);
@@ -69,6 +71,26 @@ void PIC::Generate(Masm* masm) {
           masm->offset() - 4));
     __ cmpl(edx, ebx);
     __ jmp(kNe, &local_miss);
+
+    if (transitions_[i] != NULL) {
+      // Map should have space for the new value ((mask + 4) * 2 bytes)
+      __ mov(ebx, mask_op);
+      __ addlb(ebx, Immediate(HValue::kPointerSize));
+      __ shl(ebx, Immediate(1));
+      __ cmpl(ebx, Immediate(results_[i] - HMap::kSpaceOffset));
+      __ jmp(kLe, &local_miss);
+
+      // Next shape may be already collected
+      __ mov(ebx, Immediate(reinterpret_cast<intptr_t>(transitions_[i])));
+      transition_offsets_[i] = reinterpret_cast<char**>(
+          static_cast<intptr_t>(masm->offset() - 4));
+      __ cmpl(ebx, Immediate(Heap::kICZapValue));
+      __ jmp(kEq, &local_miss);
+
+      __ mov(proto_op, ebx);
+      __ RecordWrite(eax, ebx);
+    }
+
     __ mov(eax, Immediate(results_[i]));
     __ xorl(ebx, ebx);
     __ mov(esp, ebp);
@@ -84,12 +106,25 @@ void PIC::Generate(Masm* masm) {
     __ mov(ebx, ebx_s);
     __ mov(eax, eax_s);
   }
+
+  // Remember shape, lookup may add property and change it
+  {
+    Label not_object;
+    __ IsNil(eax, NULL, &not_object);
+    __ IsUnboxed(eax, NULL, &not_object);
+    __ IsHeapObject(Heap::kTagObject, eax, &not_object, NULL);
+    __ mov(edx, proto_op);
+    __ mov(shape_s, edx);
+    __ bind(&not_object);
+  }
+
   __ Call(space_->stubs()->GetLookupPropertyStub());
 
-  // Miss(this, object, result, ip)
+  // Miss(this, object, shape, result, ip)
   Operand caller_ip(ebp, 4);
   __ push(caller_ip);
   __ push(eax);
+  __ push(shape_s);
   __ push(eax_s);
   __ push(Immediate(reinterpret_cast<intptr_t>(this)));
   __ Call(space_->stubs()->GetPICMissStub());
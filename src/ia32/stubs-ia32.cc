@@ -358,12 +358,12 @@ void CollectGarbageStub::Generate() {
   {
     Masm::Align a(masm());
 
-    // RuntimeCollectGarbage(heap, stack_top)
+    // RuntimeCollectGarbage(heap, stack_top, frame)
     __ mov(edi, Immediate(reinterpret_cast<intptr_t>(masm()->heap())));
     __ mov(esi, esp);
 
     __ push(esi);
-    __ push(esi);
+    __ push(ebp);
 
     __ push(esi);
     __ push(edi);
@@ -380,6 +380,57 @@ void CollectGarbageStub::Generate() {
 }
 
 
+void RecordWriteStub::Generate() {
+  GeneratePrologue();
+
+  Operand holder(ebp, 3 * 4);
+  Operand value(ebp, 2 * 4);
+
+  Label runtime, done;
+
+  __ Pushad();
+
+  // Old values should be marked by runtime
+  __ mov(ebx, value);
+  Operand qgen(ebx, HValue::kGenerationOffset);
+  __ cmpb(qgen, Immediate(Heap::kMinOldSpaceGeneration));
+  __ mov(eax, holder);
+  __ jmp(kGe, &runtime);
+
+  // Skip holders that are already in the remembered set
+  Operand qmark(eax, HValue::kGCMarkOffset);
+  __ testb(qmark, Immediate(HValue::kRememberedMark));
+  __ jmp(kNe, &done);
+
+  __ bind(&runtime);
+
+  RuntimeRecordWriteCallback record = &RuntimeRecordWrite;
+
+  {
+    Masm::Align a(masm());
+
+    // RuntimeRecordWrite(heap, holder, value)
+    __ mov(ebx, value);
+    __ mov(ecx, Immediate(reinterpret_cast<intptr_t>(masm()->heap())));
+
+    __ push(ebx);
+    __ push(ebx);
+    __ push(eax);
+    __ push(ecx);
+
+    __ mov(eax, Immediate(*reinterpret_cast<intptr_t*>(&record)));
+    __ Call(eax);
+
+    __ addlb(esp, Immediate(4 * 4));
+  }
+
+  __ bind(&done);
+  __ Popad(reg_nil);
+
+  GenerateEpilogue();
+}
+
+
 void TypeofStub::Generate() {
   GeneratePrologue();
   Heap* heap = masm()->heap();
@@ -500,17 +551,145 @@ void LookupPropertyStub::Generate() {
     __ IsNil(ebx, NULL, &slow_case);
     __ IsHeapObject(Heap::kTagString, ebx, &slow_case, NULL);
 
+    Operand qmask(eax, HObject::kMaskOffset);
+    Operand qmap(eax, HObject::kMapOffset);
+    Operand qproto(eax, HObject::kProtoOffset);
+
+    Label dictionary, cache_miss, shape_miss, shape_insert;
+
+    __ mov(scratch, qproto);
+    __ cmpl(scratch, Immediate(Heap::kICDisabledValue));
+    __ jmp(kEq, &dictionary);
+
+    // Shape mode: probe stub cache first
+    Operand entry_shape(edx, StubCache::kShapeOffset);
+    Operand entry_key(edx, StubCache::kKeyOffset);
+    Operand entry_offset(edx, StubCache::kOffsetOffset);
+    __ mov(esi, scratch);
+    __ StubCacheEntry(esi, ebx, edx);
+
+    __ cmpl(esi, entry_shape);
+    __ jmp(kNe, &cache_miss);
+    __ cmpl(ebx, entry_key);
+    __ jmp(kNe, &cache_miss);
+
+    __ mov(eax, entry_offset);
+    __ xorl(edx, edx);
+    esi_s.Unspill();
+    GenerateEpilogue(0);
+
+    __ bind(&cache_miss);
+
+    // Find key's index in shape's table
+    // (offset = hash & mask + kSpaceOffset, as in dictionary)
     __ StringHash(ebx, edx);
 
-    Operand qmask(eax, HObject::kMaskOffset);
+    // Hashing clobbers scratch
+    __ mov(scratch, qproto);
+    Operand shape_mask(scratch, HShape::kMaskOffset);
+    Operand shape_table(scratch, HShape::kTableOffset);
+    __ mov(esi, shape_mask);
+    __ andl(edx, esi);
+    __ addlb(edx, Immediate(HMap::kSpaceOffset));
+    __ mov(scratch, shape_table);
+    __ addl(scratch, edx);
+
+    Operand shape_key(scratch, 0);
+    __ cmpl(ebx, shape_key);
+    __ jmp(kNe, &shape_miss);
+
+    // Value slot contains tagged index, edx = index * 4 + kSpaceOffset
+    __ addl(scratch, esi);
+    Operand shape_index(scratch, HValue::kPointerSize);
+    __ mov(edx, shape_index);
+    __ shl(edx, Immediate(1));
+    __ addlb(edx, Immediate(HMap::kSpaceOffset));
+
+    // Remember offset in stub cache
+    Operand new_shape(eax, StubCache::kShapeOffset);
+    Operand new_key(eax, StubCache::kKeyOffset);
+    Operand new_offset(eax, StubCache::kOffsetOffset);
+    __ mov(esi, qproto);
+    __ StubCacheEntry(esi, ebx, eax);
+    __ mov(new_shape, esi);
+    __ mov(new_key, ebx);
+    __ mov(new_offset, edx);
+
+    __ mov(eax, edx);
+    __ xorl(edx, edx);
+    esi_s.Unspill();
+    GenerateEpilogue(0);
+
+    // Slot is occupied by other key - let runtime probe further
+    __ bind(&shape_miss);
+    __ mov(scratch, shape_key);
+    __ cmpl(scratch, Immediate(Heap::kTagNil));
+    __ jmp(kNe, &cleanup);
+
+    // There's no such key
+    __ cmpl(ecx, Immediate(0));
+    __ jmp(kNe, &shape_insert);
+
+    __ mov(eax, Immediate(Heap::kTagNil));
+    __ xorl(edx, edx);
+    esi_s.Unspill();
+    GenerateEpilogue(0);
+
+    // Insertion: follow existing transition if object has space for the
+    // new value, everything else is done in runtime
+    __ bind(&shape_insert);
+    __ StringHash(ebx, edx);
+
+    __ mov(scratch, qproto);
+    Operand transitions(scratch, HShape::kTransitionsOffset);
+    Operand transition_mask(scratch, HShape::kTransitionMaskOffset);
+    __ mov(esi, transition_mask);
+    __ mov(scratch, transitions);
+    __ IsNil(scratch, NULL, &cleanup);
+
+    __ andl(edx, esi);
+    __ addlb(edx, Immediate(HMap::kSpaceOffset));
+    __ addl(scratch, edx);
+    __ cmpl(ebx, shape_key);
+    __ jmp(kNe, &cleanup);
+
+    // scratch = next shape
+    __ addl(scratch, esi);
+    Operand next_shape(scratch, HValue::kPointerSize);
+    __ mov(scratch, next_shape);
+
+    // edx = offset of new value from the start of map's space
+    Operand next_count(scratch, HShape::kCountOffset);
+    __ mov(edx, next_count);
+    __ dec(edx);
+    __ shl(edx, Immediate(2));
+
+    // Map contains (mask + 4) * 2 bytes of values
+    __ mov(esi, qmask);
+    __ addlb(esi, Immediate(HValue::kPointerSize));
+    __ shl(esi, Immediate(1));
+    __ cmpl(edx, esi);
+    __ jmp(kGe, &cleanup);
+
+    __ mov(qproto, scratch);
+    __ RecordWrite(eax, scratch);
+
+    __ mov(eax, edx);
+    __ addlb(eax, Immediate(HMap::kSpaceOffset));
+
+    __ xorl(edx, edx);
+    esi_s.Unspill();
+    GenerateEpilogue(0);
+
+    __ bind(&dictionary);
+
+    __ StringHash(ebx, edx);
     __ mov(esi, qmask);
 
     // offset = hash & mask + kSpaceOffset
     __ andl(edx, esi);
     __ addlb(edx, Immediate(HMap::kSpaceOffset));
 
-    Operand qmap(eax, HObject::kMapOffset);
-    Operand qproto(eax, HObject::kProtoOffset);
     __ mov(scratch, qmap);
     __ addl(scratch, edx);
 
@@ -529,27 +708,29 @@ void LookupPropertyStub::Generate() {
     __ cmpl(scratch, Immediate(Heap::kTagNil));
     __ jmp(kNe, &cleanup);
 
+    // Only internalized keys are inserted, others are interned by runtime
+    __ cmpl(ecx, Immediate(0));
+    __ jmp(kEq, &match);
+    Operand key_repr(ebx, HValue::kRepresentationOffset);
+    __ testb(key_repr, Immediate(HString::kInternalizedMark));
+    __ jmp(kEq, &cleanup);
+
     __ bind(&match);
 
-    Label fast_case_end, same_key;
+    Label fast_case_end;
 
     // Insert key if was asked
     __ cmpl(ecx, Immediate(0));
     __ jmp(kEq, &fast_case_end);
 
-    // Inserting key in map is required
-    // invalidate IC if key wasn't the same
-    __ IsNil(scratch, &same_key, NULL);
-
-    __ mov(qproto, Immediate(Heap::kICDisabledValue));
-    __ bind(&same_key);
-
     // Restore map's interior pointer
     __ mov(scratch, qmap);
     __ addl(scratch, edx);
 
     // Put the key into slot
     __ mov(slot, ebx);
+    __ mov(scratch, qmap);
+    __ RecordWrite(scratch, ebx);
 
     __ bind(&fast_case_end);
 
@@ -665,21 +846,23 @@ void PICMissStub::Generate() {
 
   Operand space(ebp, 8);
   Operand object(ebp, 12);
-  Operand result(ebp, 16);
-  Operand ip(ebp, 20);
+  Operand shape(ebp, 16);
+  Operand result(ebp, 20);
+  Operand ip(ebp, 24);
 
   // Amend PIC
   __ Pushad();
 
   __ push(ip);
   __ push(result);
+  __ push(shape);
   __ push(object);
   __ push(space);
 
   PIC::MissCallback miss_cb = &PIC::Miss;
   __ mov(scratch, Immediate(*reinterpret_cast<intptr_t*>(&miss_cb)));
   __ Call(scratch);
-  __ addlb(esp, Immediate(4 * 4));
+  __ addlb(esp, Immediate(5 * 4));
 
   __ Popad(reg_nil);
 
@@ -758,6 +941,8 @@ void CloneObjectStub::Generate() {
   __ IsNil(eax, NULL, &non_object);
   __ IsHeapObject(Heap::kTagObject, eax, &non_object, NULL);
 
+  Masm::Spill eax_s(masm(), eax);
+
   // Get map
   Operand qmap(eax, HObject::kMapOffset);
   __ mov(eax, qmap);
@@ -777,9 +962,12 @@ void CloneObjectStub::Generate() {
   Operand qmap_ebx(ebx, HObject::kMapOffset);
   __ mov(ebx, qmap_ebx);
 
-  // Set proto
+  // Clone has the same shape
   Operand qproto(edx, HObject::kProtoOffset);
-  __ mov(qproto, eax);
+  eax_s.Unspill(scratch);
+  Operand qsource_proto(scratch, HObject::kProtoOffset);
+  __ mov(scratch, qsource_proto);
+  __ mov(qproto, scratch);
 
   // Skip headers
   __ addlb(eax, Immediate(HMap::kSpaceOffset));
@@ -812,7 +1000,7 @@ void CloneObjectStub::Generate() {
   __ jmp(&done);
   __ bind(&non_object);
 
-  __ mov(ecx, Immediate(HNumber::Tag(16)));
+  __ mov(ecx, Immediate(HNumber::Tag(HObject::kDefaultSize)));
 
   // Allocate new object
   __ AllocateObjectLiteral(Heap::kTagObject, reg_nil, ecx, eax);
@@ -912,6 +1100,45 @@ void StackTraceStub::Generate() {
 }
 
 
+void OptimizeStub::Generate() {
+  GeneratePrologue();
+
+  // Arguments
+  Operand site(ebp, 2 * 4);
+
+  RuntimeOptimizeCallback optimize = &RuntimeOptimize;
+  Immediate root(reinterpret_cast<intptr_t>(masm()->heap()->old_space()->root()));
+  Operand scratch_op(scratch, 0);
+
+  __ Pushad();
+
+  // Stub may be called from function's entry, align stack manually
+  // (ebx is preserved by callee)
+  __ mov(ebx, esp);
+  __ mov(scratch, Immediate(-16));
+  __ andl(esp, scratch);
+
+  // RuntimeOptimize(heap, site, root)
+  __ mov(scratch, root);
+  __ mov(scratch, scratch_op);
+  __ mov(eax, site);
+
+  __ push(scratch);
+  __ push(scratch);
+  __ push(eax);
+  __ push(Immediate(reinterpret_cast<intptr_t>(masm()->heap())));
+  __ mov(eax, Immediate(*reinterpret_cast<intptr_t*>(&optimize)));
+  __ call(eax);
+
+  __ mov(esp, ebx);
+
+  __ Popad(reg_nil);
+
+  // Caller will unwind stack
+  GenerateEpilogue();
+}
+
+
 #define BINARY_SUB_TYPES(V)\
     V(Add)\
     V(Sub)\
@@ -1291,6 +1518,7 @@ void LoadVarArgStub::Generate() {
 
   // Put argument in array
   __ mov(slot, offset);
+  __ RecordWrite(arr, offset);
 
   arr_s.Unspill();
 
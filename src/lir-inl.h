@@ -192,6 +192,11 @@ inline bool LUse::is_const() {
 }
 
 
+inline bool LUse::is_double() {
+  return interval()->IsDouble();
+}
+
+
 inline bool LUse::IsEqual(LUse* use) {
   return interval()->IsEqual(use->interval());
 }
@@ -300,6 +305,16 @@ inline bool LInterval::IsFixed() {
 }
 
 
+inline void LInterval::MarkDouble() {
+  double_ = true;
+}
+
+
+inline bool LInterval::IsDouble() {
+  return double_;
+}
+
+
 inline int LInterval::index() {
   return index_;
 }
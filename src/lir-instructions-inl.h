@@ -104,6 +104,12 @@ inline LInstruction* LInstruction::Propagate(HIRInstruction* res) {
   return Propagate(res->lir()->propagated_);
 }
 
+
+inline LInstruction* LInstruction::Propagate(LInstruction* res) {
+  assert(res->propagated_ != NULL);
+  return Propagate(res->propagated_);
+}
+
 #define LIR_INSTRUCTION_TYPE_STR(I) \
     case LInstruction::k##I: res = #I; break;
 
@@ -141,7 +147,8 @@ inline LLabel* LControlInstruction::TargetAt(int i) {
 inline LControlInstruction* LControlInstruction::Cast(LInstruction* instr) {
   assert(instr->type() == kGoto ||
          instr->type() == kBranch ||
-         instr->type() == kBranchNumber);
+         instr->type() == kBranchNumber ||
+         instr->type() == kBranchDouble);
   return reinterpret_cast<LControlInstruction*>(instr);
 }
 
@@ -56,6 +56,10 @@ typedef ZoneList<LInstruction*> LInstructionList;
     V(Not) \
     V(BinOp) \
     V(BinOpNumber) \
+    V(BinOpDouble) \
+    V(CompareDouble) \
+    V(BoxDouble) \
+    V(UnboxDouble) \
     V(Typeof) \
     V(Sizeof) \
     V(Keysof) \
@@ -73,6 +77,7 @@ typedef ZoneList<LInstruction*> LInstructionList;
     V(Literal) \
     V(Branch) \
     V(BranchNumber) \
+    V(BranchDouble) \
     V(LoadProperty) \
     V(StoreProperty) \
     V(AllocateObject) \
@@ -118,6 +123,7 @@ class LInstruction : public ZoneObject {
   inline LInstruction* SetResult(HIRInstruction* res, LUse::Type use_type);
   inline LInstruction* Propagate(LUse* res);
   inline LInstruction* Propagate(HIRInstruction* res);
+  inline LInstruction* Propagate(LInstruction* res);
 
   inline LInstruction* SetSlot(ScopeSlot* slot);
 
@@ -290,6 +296,14 @@ class LBranchNumber : public LControlInstruction {
   INSTRUCTION_METHODS(BranchNumber)
 };
 
+class LBranchDouble : public LControlInstruction {
+ public:
+  LBranchDouble() : LControlInstruction(kBranchDouble) {
+  }
+
+  INSTRUCTION_METHODS(BranchDouble)
+};
+
 class LAccessProperty : public LInstruction {
  public:
   explicit LAccessProperty(Type type) : LInstruction(type),
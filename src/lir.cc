@@ -45,6 +45,7 @@ LGen::LGen(HIRGen* hir, const char* filename, HIRBlock* root)
       virtual_index_(40),
       current_block_(NULL),
       current_instruction_(NULL),
+      register_count_(kLIRRegisterCount),
       intervals_(kIntervalsInitial),
       unhandled_(kIntervalsInitial),
       active_(kIntervalsInitial),
@@ -147,11 +148,38 @@ void LGen::GenerateInstructions() {
     case HIRInstruction::k##V: Visit##V(instr); break;
 
 void LGen::VisitInstruction(HIRInstruction* instr) {
+  // Doubles escape to instructions that work only with boxed values,
+  // box them right before such use (phis are boxed at gotos)
+  HIRInstructionList boxed;
+  if (!instr->HasDoubleArgs() && !instr->Is(HIRInstruction::kPhi)) {
+    HIRInstructionList::Item* ahead = instr->args()->head();
+    for (; ahead != NULL; ahead = ahead->next()) {
+      HIRInstruction* arg = ahead->value();
+      if (!arg->IsDouble()) continue;
+
+      // Instruction may use the same value twice
+      HIRInstructionList::Item* bhead = boxed.head();
+      for (; bhead != NULL; bhead = bhead->next()) {
+        if (bhead->value() == arg) break;
+      }
+      if (bhead != NULL) continue;
+
+      arg->lir()->Propagate(BoxDouble(arg));
+      boxed.Push(arg);
+    }
+  }
+
   switch (instr->type()) {
     HIR_INSTRUCTION_TYPES(LGEN_VISIT_SWITCH)
    default:
     UNEXPECTED
   }
+
+  // Other uses should get unboxed value
+  HIRInstruction* arg;
+  while ((arg = boxed.Shift()) != NULL) {
+    arg->lir()->Propagate(arg->lir()->result);
+  }
 }
 
 // Common functions
@@ -173,7 +201,7 @@ void LGen::VisitGoto(HIRInstruction* instr) {
 
     // Initialize LIR representation of phi
     if (phi->lir() == NULL) {
-      LInterval* iphi = CreateVirtual();
+      LInterval* iphi = phi->IsDouble() ? CreateDouble() : CreateVirtual();
 
       lphi = new LPhi();
       lphi->AddArg(iphi, LUse::kAny)
@@ -189,7 +217,7 @@ void LGen::VisitGoto(HIRInstruction* instr) {
     // Inputs can be not generated yet
     if (input->Is(HIRInstruction::kPhi) && input->lir() == NULL) {
       assert(!input->IsRemoved());
-      LInterval* iphi = CreateVirtual();
+      LInterval* iphi = input->IsDouble() ? CreateDouble() : CreateVirtual();
 
       LPhi* pinput = new LPhi();
       pinput->AddArg(iphi, LUse::kAny)
@@ -198,9 +226,21 @@ void LGen::VisitGoto(HIRInstruction* instr) {
       input->lir(pinput);
     }
 
-    Add(new LMove())
-        ->SetResult(lphi->result->interval(), LUse::kAny)
-        ->AddArg(input, LUse::kAny);
+    if (phi->IsDouble() && !input->IsDouble()) {
+      LInterval* value = ToDouble(input);
+      Add(new LMove())
+          ->SetResult(lphi->result->interval(), LUse::kAny)
+          ->AddArg(value, LUse::kAny);
+    } else if (!phi->IsDouble() && input->IsDouble()) {
+      LInstruction* value = BoxDouble(input);
+      Add(new LMove())
+          ->SetResult(lphi->result->interval(), LUse::kAny)
+          ->AddArg(value, LUse::kAny);
+    } else {
+      Add(new LMove())
+          ->SetResult(lphi->result->interval(), LUse::kAny)
+          ->AddArg(input, LUse::kAny);
+    }
   }
 
   Bind(new LGoto());
@@ -328,7 +368,7 @@ void LGen::BuildIntervals() {
       LInstruction* instr = itail->value();
 
       if (instr->HasCall()) {
-        for (int i = 0; i < kLIRRegisterCount; i++) {
+        for (int i = 0; i < register_count_; i++) {
           if (registers_[i]->Covers(instr->id)) continue;
           registers_[i]->AddRange(instr->id, instr->id + 1);
           registers_[i]->Use(LUse::kRegister, instr);
@@ -482,10 +522,15 @@ void LGen::WalkIntervals() {
 
 
 void LGen::TryAllocateFreeReg(LInterval* current) {
-  int free_pos[kLIRRegisterCount];
+  int free_pos[kLIRRegisterCount + kLIRDoubleRegisterCount];
+
+  // Doubles are allocated only in double registers, other values only in
+  // general purpose ones
+  int first = current->IsDouble() ? kLIRRegisterCount : 0;
+  int last = current->IsDouble() ? register_count_ : kLIRRegisterCount;
 
   // Initially all registers are free for any visible future
-  for (int i = 0; i < kLIRRegisterCount; i++) {
+  for (int i = 0; i < register_count_; i++) {
     free_pos[i] = INT_MAX;
   }
 
@@ -511,8 +556,8 @@ void LGen::TryAllocateFreeReg(LInterval* current) {
 
   // Now we need to find register that is free for maximum time
   int max = -1;
-  int max_reg = 0;
-  for (int i = 0; i < kLIRRegisterCount; i++) {
+  int max_reg = first;
+  for (int i = first; i < last; i++) {
     if (free_pos[i] > max) {
       max = free_pos[i];
       max_reg = i;
@@ -523,7 +568,7 @@ void LGen::TryAllocateFreeReg(LInterval* current) {
   // Prefer register hint if possible
   if (current->register_hint != NULL && current->register_hint->is_register()) {
     int reg = current->register_hint->interval()->index();
-    if (free_pos[reg] - 2 > current->start()) {
+    if (reg >= first && reg < last && free_pos[reg] - 2 > current->start()) {
       max = free_pos[reg];
       max_reg = reg;
     }
@@ -550,10 +595,12 @@ void LGen::AllocateBlockedReg(LInterval* current) {
     return;
   }
 
-  int use_pos[kLIRRegisterCount];
-  int block_pos[kLIRRegisterCount];
+  int use_pos[kLIRRegisterCount + kLIRDoubleRegisterCount];
+  int block_pos[kLIRRegisterCount + kLIRDoubleRegisterCount];
+  int first = current->IsDouble() ? kLIRRegisterCount : 0;
+  int last = current->IsDouble() ? register_count_ : kLIRRegisterCount;
 
-  for (int i = 0; i < kLIRRegisterCount; i++) {
+  for (int i = 0; i < register_count_; i++) {
     use_pos[i] = INT_MAX;
     block_pos[i] = INT_MAX;
   }
@@ -599,8 +646,8 @@ void LGen::AllocateBlockedReg(LInterval* current) {
   }
 
   int use_max = -1;
-  int use_reg = 0;
-  for (int i = 0; i < kLIRRegisterCount; i++) {
+  int use_reg = first;
+  for (int i = first; i < last; i++) {
     if (use_pos[i] > use_max) {
       use_max = use_pos[i];
       use_reg = i;
@@ -653,19 +700,15 @@ void LGen::AllocateBlockedReg(LInterval* current) {
         // Split before current interval
         Split(interval, split_pos);
       } else {
-        int next_pos = next_use->instr()->id;
-
-        if (intersection >= next_pos) {
-          // Interval is used before intersection - it would be ok to split it
-          // at this position
-          Split(interval, intersection);
-        } else {
-          // Split interval right before next use
-          Split(interval, next_pos - 1);
-        }
+        // Register is free only until intersection, values are moved either
+        // in gap before it, or on block's edge when resolving data flow
+        int pos = intersection;
+        if (pos % 2 == 0 && IsBlockStart(pos) == NULL) pos--;
+        Split(interval, pos);
       }
 
-      inactive_.RemoveAt(i--);
+      // Interval may still hold register in lifetime holes of current
+      if (interval->end() <= current->start()) inactive_.RemoveAt(i--);
     }
   }
 }
@@ -712,7 +755,8 @@ void LGen::ResolveDataFlow() {
       LInstruction* control = b->instructions()->tail()->value();
       assert(control->type() == LInstruction::kGoto ||
              control->type() == LInstruction::kBranch ||
-             control->type() == LInstruction::kBranchNumber);
+             control->type() == LInstruction::kBranchNumber ||
+             control->type() == LInstruction::kBranchDouble);
 
       if (control->type() == LInstruction::kGoto &&
           bhead->next()->value()->lir() == succ) {
@@ -804,6 +848,21 @@ void LGen::Generate(Masm* masm, SourceMap* map) {
   // +1 for argc
   masm->stack_slots(spill_index_ + 1);
 
+  // Spilled intervals are reported to safepoints of instructions they're
+  // live at (inputs are live right before instruction)
+  LIntervalList spilled(kSpillsInitial);
+  for (int i = 0; i < intervals_.length(); i++) {
+    LInterval* interval = intervals_.At(i);
+    if (interval->is_stackslot() && interval->index() >= 0) {
+      spilled.Push(interval);
+    }
+  }
+
+  BitField<EmptyClass> live(spill_index_);
+  BitField<EmptyClass> raw(spill_index_);
+  masm->live_slots(&live);
+  masm->raw_slots(&raw);
+
   // Generate all instructions
   HIRBlockList::Item* bhead = blocks_.head();
   for (; bhead != NULL; bhead = bhead->next()) {
@@ -817,11 +876,28 @@ void LGen::Generate(Masm* masm, SourceMap* map) {
           instr->hir()->ast()->offset() >= 0) {
         map->Push(masm->offset(), instr->hir()->ast()->offset());
       }
+
+      live.Reset();
+      raw.Reset();
+      for (int i = 0; i < spilled.length(); i++) {
+        LInterval* interval = spilled.At(i);
+        if (interval->Covers(instr->id) || interval->Covers(instr->id - 1)) {
+          // Unboxed doubles shouldn't be seen (or cleared) by GC
+          if (interval->IsDouble()) {
+            raw.Set(interval->index());
+          } else {
+            live.Set(interval->index());
+          }
+        }
+      }
+
       instr->Generate(masm);
     }
   }
 
   masm->FinalizeSpills();
+  masm->live_slots(NULL);
+  masm->raw_slots(NULL);
   masm->AlignCode();
 }
 
@@ -848,8 +924,8 @@ void LGen::Print(PrintBuffer* p, bool extended) {
 void LGen::PrintIntervals(PrintBuffer* p) {
   for (int i = 0; i < intervals_.length(); i++) {
     LInterval* interval = intervals_.At(i);
-    if (interval->id < kLIRRegisterCount) {
-      p->Print("%s     : ", RegisterNameByIndex(interval->id));
+    if (interval->IsFixed()) {
+      p->Print("%s     : ", RegisterNameByIndex(interval->index()));
     } else if (interval->is_stackslot()) {
       p->Print("%03d [%02d]: ", interval->id, interval->index());
     } else if (interval->is_const()) {
@@ -917,6 +993,36 @@ LInterval* LGen::ToFixed(HIRInstruction* instr, Register reg) {
 }
 
 
+LInterval* LGen::CreateDouble() {
+  // Fixed double registers are needed only if function is using doubles
+  if (register_count_ == kLIRRegisterCount) {
+    register_count_ += kLIRDoubleRegisterCount;
+    for (int i = kLIRRegisterCount; i < register_count_; i++) {
+      registers_[i] = CreateInterval(LInterval::kRegister, i);
+      registers_[i]->MarkFixed();
+      registers_[i]->MarkDouble();
+    }
+  }
+
+  LInterval* res = CreateVirtual();
+  res->MarkDouble();
+  return res;
+}
+
+
+LInterval* LGen::ToDouble(HIRInstruction* instr) {
+  if (instr->IsDouble()) return instr->lir()->result->interval();
+
+  // Unbox number right before use
+  LInterval* res = CreateDouble();
+  Add(new LUnboxDouble())
+      ->SetResult(res, LUse::kRegister)
+      ->AddArg(instr, LUse::kRegister);
+
+  return res;
+}
+
+
 void LGen::ResultFromFixed(LInstruction* instr, Register reg) {
   LInterval* ireg = registers_[IndexByRegister(reg)];
   LInterval* res = CreateVirtual();
@@ -937,6 +1043,7 @@ LInterval* LGen::Split(LInterval* i, int pos) {
 
   assert(pos > i->start() && pos < i->end());
   LInterval* child = CreateVirtual();
+  if (i->IsDouble()) child->MarkDouble();
 
   // Move uses from parent to child
   for (int j = i->uses()->length() - 1; j >= 0; j--) {
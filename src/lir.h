@@ -90,6 +90,7 @@ class LUse : public ZoneObject {
   }
 
   Register ToRegister();
+  DoubleRegister ToDoubleRegister();
   Operand* ToOperand();
 
   inline void Print(PrintBuffer* p);
@@ -99,6 +100,7 @@ class LUse : public ZoneObject {
   inline bool is_register();
   inline bool is_stackslot();
   inline bool is_const();
+  inline bool is_double();
 
   inline LInstruction* instr();
   inline Type type();
@@ -130,6 +132,7 @@ class LInterval : public ZoneObject {
                                     ranges_(10),
                                     uses_(10),
                                     fixed_(false),
+                                    double_(false),
                                     split_parent_(NULL),
                                     split_children_(kSplitChildrenInitial) {
   }
@@ -146,6 +149,8 @@ class LInterval : public ZoneObject {
   inline void Spill(int slot);
   inline void MarkFixed();
   inline bool IsFixed();
+  inline void MarkDouble();
+  inline bool IsDouble();
   inline bool IsEqual(LInterval* i);
 
   inline bool is_virtual();
@@ -183,6 +188,9 @@ class LInterval : public ZoneObject {
   LUseList uses_;
   bool fixed_;
 
+  // Holds unboxed double (in double register or raw stack slot)
+  bool double_;
+
   LInterval* split_parent_;
   LIntervalList split_children_;
 
@@ -250,6 +258,9 @@ class LGen : public ZoneObject {
 
   LInterval* ToFixed(HIRInstruction* instr, Register reg);
   void ResultFromFixed(LInstruction* instr, Register reg);
+  LInterval* CreateDouble();
+  LInterval* ToDouble(HIRInstruction* instr);
+  LInstruction* BoxDouble(HIRInstruction* instr);
   LInterval* Split(LInterval* i, int pos);
   LGap* GetGap(int pos);
   void Spill(LInterval* interval);
@@ -275,7 +286,8 @@ class LGen : public ZoneObject {
   HIRInstruction* current_instruction_;
 
   HIRBlockList blocks_;
-  LInterval* registers_[kLIRRegisterCount];
+  LInterval* registers_[kLIRRegisterCount + kLIRDoubleRegisterCount];
+  int register_count_;
   LIntervalList intervals_;
 
   // Walk intervals data
@@ -28,13 +28,18 @@ namespace candor {
 namespace internal {
 
 void Masm::Move(LUse* dst, LUse* src) {
-  if (src->is_register()) {
+  if (src->is_register() && src->is_double()) {
+    Move(dst, src->ToDoubleRegister());
+  } else if (src->is_register()) {
     Move(dst, src->ToRegister());
   } else if (src->is_const()) {
     // Generate const load
     LInstruction* c = src->interval()->definition();
     c->result = dst;
     c->Generate(this);
+  } else if (dst->is_register() && dst->is_double()) {
+    assert(src->is_stackslot());
+    movd(dst->ToDoubleRegister(), *src->ToOperand());
   } else {
     assert(src->is_stackslot());
     Move(dst, *src->ToOperand());
@@ -44,6 +49,7 @@ void Masm::Move(LUse* dst, LUse* src) {
 
 void Masm::Move(LUse* dst, Register src) {
   if (dst->is_register()) {
+    assert(!dst->is_double());
     mov(dst->ToRegister(), src);
   } else {
     assert(dst->is_stackslot());
@@ -52,6 +58,17 @@ void Masm::Move(LUse* dst, Register src) {
 }
 
 
+void Masm::Move(LUse* dst, DoubleRegister src) {
+  if (dst->is_register()) {
+    assert(dst->is_double());
+    movd(dst->ToDoubleRegister(), src);
+  } else {
+    assert(dst->is_stackslot());
+    movd(*dst->ToOperand(), src);
+  }
+}
+
+
 void Masm::Move(LUse* dst, const Operand& src) {
   if (dst->is_register()) {
     mov(dst->ToRegister(), src);
@@ -73,6 +90,37 @@ void Masm::Move(LUse* dst, Immediate src) {
 }
 
 
+void Masm::RecordSafepoint() {
+  // Stubs are visited conservatively
+  if (live_slots_ == NULL) return;
+
+  Safepoint* safepoint = new Safepoint(offset());
+
+  // Stack slots are followed by masm spills
+  int spills = spill_offset_ / HValue::kPointerSize;
+  for (int i = Safepoint::kFirstSlot; i < spills; i++) {
+    if (live_slots_->Test(i - Safepoint::kFirstSlot)) safepoint->Set(i);
+    if (raw_slots_ != NULL && raw_slots_->Test(i - Safepoint::kFirstSlot)) {
+      safepoint->SetRaw(i);
+    }
+  }
+  for (int i = 0; i < spill_index_; i++) {
+    safepoint->Set(spills + i);
+  }
+
+  safepoints_.Push(safepoint);
+}
+
+
+void Masm::FinalizeSafepoints(uint32_t frame_size) {
+  Safepoint* safepoint;
+  while ((safepoint = safepoints_.Shift()) != NULL) {
+    safepoint->size(frame_size / HValue::kPointerSize);
+    heap()->safepoints()->queue()->Push(safepoint);
+  }
+}
+
+
 void AbsoluteAddress::Target(Masm* masm, int offset) {
   assert(ip_ == -1);
   ip_ = offset;
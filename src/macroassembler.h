@@ -29,6 +29,7 @@
 #include "code-space.h"  // CodeSpace
 #include "heap.h"  // Heap::HeapTag and etc
 #include "heap-inl.h"
+#include "type-feedback.h"  // TypeFeedback
 
 namespace candor {
 namespace internal {
@@ -82,6 +83,11 @@ class Masm : public Assembler {
   void AllocateSpills();
   void FinalizeSpills();
 
+  // Record layout of the frame at the current call's return address
+  // (only if live slots were provided by fullgen/lir)
+  void RecordSafepoint();
+  void FinalizeSafepoints(uint32_t frame_size);
+
   // Skip some bytes to make code aligned
   void AlignCode();
 
@@ -107,6 +113,9 @@ class Masm : public Assembler {
                              Register size,
                              Register result);
 
+  // Store shape of empty object into dst (clobbers scratch)
+  void LoadRootShape(const Operand& dst);
+
   // Fills memory segment with immediate value
   void Fill(Register start, Register end, Immediate value);
 
@@ -122,9 +131,20 @@ class Masm : public Assembler {
   // Compute string's hash
   void StringHash(Register str, Register result);
 
+  // Compute address of (shape, key) pair's entry in stub cache
+  // (clobbers scratch)
+  void StubCacheEntry(Register shape, Register key, Register result);
+
   // Perform garbage collection if needed (heap flag is set)
   void CheckGC();
 
+  // Write barrier: put `holder` into remembered set if it's an old object
+  // and `value` is in new space (general purpose registers are preserved)
+  void RecordWrite(Register holder, Register value);
+
+  // Mark type of `reference` as seen at feedback site (clobbers scratch)
+  void RecordTypeFeedback(Register reference, TypeFeedback::Site* site);
+
   void IsNil(Register reference, Label* not_nil, Label* is_nil);
   void IsUnboxed(Register reference, Label* not_unboxed, Label* unboxed);
 
@@ -139,6 +159,7 @@ class Masm : public Assembler {
   // Generic move, LIR augmentation
   void Move(LUse* dst, LUse* src);
   void Move(LUse* dst, Register src);
+  void Move(LUse* dst, DoubleRegister src);
   void Move(LUse* dst, const Operand& src);
   void Move(LUse* dst, Immediate src);
 
@@ -171,6 +192,16 @@ class Masm : public Assembler {
     spill_offset_ = (1 + stack_slots) * HValue::kPointerSize;
   }
 
+  // Stack slots holding values at the instruction being generated
+  inline void live_slots(BitField<EmptyClass>* live_slots) {
+    live_slots_ = live_slots;
+  }
+
+  // Stack slots holding unboxed doubles at the instruction being generated
+  inline void raw_slots(BitField<EmptyClass>* raw_slots) {
+    raw_slots_ = raw_slots;
+  }
+
  protected:
   CodeSpace* space_;
 
@@ -184,6 +215,10 @@ class Masm : public Assembler {
   // Temporary operand
   Operand spill_operand_;
 
+  BitField<EmptyClass>* live_slots_;
+  BitField<EmptyClass>* raw_slots_;
+  SafepointTable::SafepointQueue safepoints_;
+
   friend class Align;
 };
 
@@ -33,10 +33,14 @@
 namespace candor {
 namespace internal {
 
-PIC::PIC(CodeSpace* space) : space_(space),
+PIC::PIC(CodeSpace* space) : shape_(NULL),
+                             offset_(0),
+                             space_(space),
                              chunk_(NULL),
+                             prev_chunk_(NULL),
                              protos_(NULL),
                              results_(NULL),
+                             transitions_(NULL),
                              size_(0) {
 }
 
@@ -44,6 +48,7 @@ PIC::PIC(CodeSpace* space) : space_(space),
 PIC::~PIC() {
   delete[] protos_;
   delete[] results_;
+  delete[] transitions_;
   chunk_ = NULL;
 }
 
@@ -54,7 +59,8 @@ char* PIC::Generate() {
 
   Generate(&masm);
 
-  if (chunk_ != NULL) chunk_->Unref();
+  if (prev_chunk_ != NULL) prev_chunk_->Unref();
+  prev_chunk_ = chunk_;
   chunk_ = space_->CreateChunk("__pic__", "", 0);
   space_->Put(chunk_, &masm);
 
@@ -67,18 +73,36 @@ char* PIC::Generate() {
     space_->heap()->Reference(Heap::kRefWeak,
                               reinterpret_cast<HValue**>(proto_offsets_[i]),
                               reinterpret_cast<HValue*>(*proto_offsets_[i]));
+
+    if (transitions_[i] == NULL) continue;
+    transition_offsets_[i] = reinterpret_cast<char**>(
+        chunk_->addr() + reinterpret_cast<intptr_t>(transition_offsets_[i]));
+
+    space_->heap()->Reference(
+        Heap::kRefWeak,
+        reinterpret_cast<HValue**>(transition_offsets_[i]),
+        reinterpret_cast<HValue*>(*transition_offsets_[i]));
   }
 
   return chunk_->addr();
 }
 
 
-void PIC::Miss(PIC* pic, char* object, intptr_t result, char* ip) {
-  pic->Miss(object, result, ip);
+char* PIC::addr() {
+  return chunk_->addr();
+}
+
+
+void PIC::Miss(PIC* pic,
+               char* object,
+               char* shape,
+               intptr_t result,
+               char* ip) {
+  pic->Miss(object, shape, result, ip);
 }
 
 
-void PIC::Miss(char* object, intptr_t result, char* ip) {
+void PIC::Miss(char* object, char* shape, intptr_t result, char* ip) {
   Heap::HeapTag tag = HValue::GetTag(object);
   if (tag != Heap::kTagObject) return;
 
@@ -98,13 +122,45 @@ void PIC::Miss(char* object, intptr_t result, char* ip) {
   intptr_t disabled = ~Heap::kICDisabledValue;
   disabled = ~disabled;
 
+  // Lookup may have added property and moved object to the next shape
   char* proto = HValue::As<HObject>(object)->proto();
-  if ((reinterpret_cast<intptr_t>(proto) == disabled)) {
+  if ((reinterpret_cast<intptr_t>(shape) == disabled) ||
+      (reinterpret_cast<intptr_t>(proto) == disabled)) {
     return;
   }
+  char* transition = proto == shape ? NULL : proto;
+
+  // First shape seen at site goes to inline entry (there is no such slot
+  // for missing properties and transitions, keep their lookup in stub)
+  bool inline_empty = shape_ == NULL ||
+      reinterpret_cast<intptr_t>(shape_) == Heap::kICZapValue;
+  if (transition == NULL && result != Heap::kTagNil) {
+    if (shape == shape_) return;
+    if (inline_empty) {
+      shape_ = shape;
+      offset_ = result;
+      space_->heap()->Reference(Heap::kRefWeak,
+                                reinterpret_cast<HValue**>(&shape_),
+                                reinterpret_cast<HValue*>(shape_));
+      return;
+    }
+  }
+
+  // Shape is already cached (i.e. object's map had no space for the new
+  // property), regenerate only if entry's transition was collected
+  int index = size_;
+  for (int i = 0; i < size_; i++) {
+    if (protos_[i] != shape) continue;
+    if (transition == NULL ||
+        reinterpret_cast<intptr_t>(transitions_[i]) != Heap::kICZapValue) {
+      return;
+    }
+    index = i;
+    break;
+  }
 
   // Patch call site and remove call to PIC
-  if (size_ >= kMaxSize) {
+  if (index >= kMaxSize) {
     *call_ip = space_->stubs()->GetLookupPropertyStub();
     return;
   }
@@ -113,21 +169,34 @@ void PIC::Miss(char* object, intptr_t result, char* ip) {
   if (size_ == 0) {
     protos_ = new char*[kMaxSize];
     results_ = new intptr_t[kMaxSize];
+    transitions_ = new char*[kMaxSize];
   }
 
-  protos_[size_] = proto;
-  results_[size_] = result;
-  space_->heap()->Reference(Heap::kRefWeak,
-                            reinterpret_cast<HValue**>(&protos_[size_]),
-                            reinterpret_cast<HValue*>(protos_[size_]));
+  if (index == size_) {
+    protos_[index] = shape;
+    space_->heap()->Reference(Heap::kRefWeak,
+                              reinterpret_cast<HValue**>(&protos_[index]),
+                              reinterpret_cast<HValue*>(protos_[index]));
+  }
+  results_[index] = result;
+  transitions_[index] = transition;
+  if (transition != NULL) {
+    space_->heap()->Reference(Heap::kRefWeak,
+                              reinterpret_cast<HValue**>(&transitions_[index]),
+                              reinterpret_cast<HValue*>(transition));
+  }
 
   // Dereference protos in previous version of PIC
   for (int i = 0; i < size_; i++) {
     space_->heap()->Dereference(reinterpret_cast<HValue**>(proto_offsets_[i]),
                                 reinterpret_cast<HValue*>(*proto_offsets_[i]));
+    if (transitions_[i] == NULL) continue;
+    space_->heap()->Dereference(
+        reinterpret_cast<HValue**>(transition_offsets_[i]),
+        reinterpret_cast<HValue*>(*transition_offsets_[i]));
   }
 
-  size_++;
+  if (index == size_) size_++;
 
   // Generate new PIC and replace previous one
   *call_ip = Generate();
@@ -34,10 +34,15 @@ class CodeSpace;
 class CodeChunk;
 class Masm;
 
+// Property access site's cache: generated code compares object's shape with
+// the inline (monomorphic) entry and accesses value slot directly, other
+// shapes are looked up by the generated polymorphic stub. Stores adding a
+// property are cached in stub as transitions from object's old shape.
 class PIC {
  public:
   typedef void (*MissCallback)(PIC* pic,
                                char* object,
+                               char* shape,
                                intptr_t result,
                                char* ip);
 
@@ -45,20 +50,47 @@ class PIC {
   ~PIC();
 
   char* Generate();
-  static void Miss(PIC* pic, char* object, intptr_t result, char* ip);
+  static void Miss(PIC* pic,
+                   char* object,
+                   char* shape,
+                   intptr_t result,
+                   char* ip);
+
+  // Inline entry, fields are accessed by generated code (shape is NULL
+  // until the first miss). Shape is a weak reference, GC zaps it once shape
+  // is collected.
+  static const int kShapeOffset = 0;
+  static const int kOffsetOffset = kShapeOffset + sizeof(intptr_t);
+
+  char* addr();
+
+  // Number of polymorphic entries
+  inline int size() { return size_; }
 
  protected:
   void Generate(Masm* masm);
 
-  void Miss(char* object, intptr_t result, char* ip);
+  // `shape` is object's shape before lookup (nil for non-objects)
+  void Miss(char* object, char* shape, intptr_t result, char* ip);
 
   static const int kMaxSize = 5;
 
+  char* shape_;
+  intptr_t offset_;
+
   CodeSpace* space_;
   CodeChunk* chunk_;
+
+  // Miss is called from the current chunk and returns into it, so it's
+  // released only when the next version of PIC is generated
+  CodeChunk* prev_chunk_;
   char** protos_;
   char** proto_offsets_[kMaxSize];
   intptr_t* results_;
+
+  // Shapes installed on hit (NULL if entry isn't a transition)
+  char** transitions_;
+  char** transition_offsets_[kMaxSize];
   int size_;
 };
 
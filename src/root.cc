@@ -50,6 +50,23 @@ Root::Root(Heap* heap) : heap_(heap) {
 }
 
 
+Root::Root(Heap* heap, char* context) : heap_(heap) {
+  HContext* ctx = HValue::As<HContext>(context);
+
+  for (uint32_t i = 0; i < ctx->slots(); i++) {
+    char* value = *ctx->GetSlotAddress(i);
+    values()->Push(value);
+
+    // Some predefined values may appear twice, use first one
+    if (map_.Get(NumberKey::New(value)) != NULL) continue;
+
+    ScopeSlot* slot = new ScopeSlot(ScopeSlot::kContext, -2);
+    slot->index(i);
+    map_.Set(NumberKey::New(value), slot);
+  }
+}
+
+
 ScopeSlot* Root::GetSlot(char* value) {
   ScopeSlot* slot = map_.Get(NumberKey::New(value));
 
@@ -41,6 +41,10 @@ class Root {
 
   explicit Root(Heap* heap);
 
+  // Keep all values of existing root context at the same indexes, so code
+  // compiled against it will work with the new one too
+  Root(Heap* heap, char* context);
+
   ScopeSlot* Put(AstNode* node);
   HContext* Allocate();
 
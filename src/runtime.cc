@@ -33,6 +33,7 @@
 #include "heap.h"  // Heap
 #include "heap-inl.h"
 #include "utils.h"  // ComputeHash, etc
+#include "code-space.h"  // CodeSpace
 
 namespace candor {
 namespace internal {
@@ -77,9 +78,29 @@ char* RuntimeAllocate(Heap* heap,
 }
 
 
-void RuntimeCollectGarbage(Heap* heap, char* stack_top) {
-  Zone gc_zone;
-  heap->gc()->CollectGarbage(stack_top);
+char* RuntimeAllocateTenured(Heap* heap, char* tag, char* size) {
+  Heap::HeapTag htag = static_cast<Heap::HeapTag>(
+      HNumber::Untag(reinterpret_cast<int64_t>(tag)));
+  uint32_t hsize = HNumber::Untag(reinterpret_cast<int64_t>(size));
+
+  char* obj = heap->AllocateTagged(
+      htag,
+      Heap::kTenureOld,
+      (htag == Heap::kTagArray ? 4 : 3) * HValue::kPointerSize);
+  HObject::Init(heap, obj, hsize, Heap::kTenureOld);
+  if (htag == Heap::kTagArray) HArray::SetLength(obj, 0);
+
+  return obj;
+}
+
+
+void RuntimeCollectGarbage(Heap* heap, char* stack_top, char* frame) {
+  heap->gc()->CollectGarbage(stack_top, frame);
+}
+
+
+void RuntimeRecordWrite(Heap* heap, char* holder, char* value) {
+  heap->RecordWrite(holder, value);
 }
 
 
@@ -123,12 +144,24 @@ intptr_t RuntimeGetHash(Heap* heap, char* value) {
 }
 
 
+static inline bool IsString(char* value) {
+  return !HValue::IsUnboxed(value) &&
+         value != HNil::New() &&
+         HValue::GetTag(value) == Heap::kTagString;
+}
+
+
+static inline bool IsInternalizedString(char* value) {
+  return IsString(value) && HString::IsInternalized(value);
+}
+
+
 intptr_t RuntimeLookupProperty(Heap* heap,
                                char* obj,
                                char* key,
                                intptr_t insert) {
   assert(!HValue::Cast(obj)->IsGCMarked());
-  assert(!HValue::Cast(obj)->IsSoftGCMarked());
+  assert(!HValue::Cast(obj)->IsSoftGCMarked() || heap->gc()->is_marking());
 
   char* map = HObject::Map(obj);
   char* space = HValue::As<HMap>(map)->space();
@@ -154,6 +187,19 @@ intptr_t RuntimeLookupProperty(Heap* heap,
     }
   } else {
     assert(HValue::GetTag(obj) == Heap::kTagObject);
+
+    if (!HObject::IsDictionary(obj)) {
+      return RuntimeLookupShapeProperty(heap, obj, key, insert);
+    }
+
+    // String keys are compared by address where possible, all string keys
+    // of dictionary are internalized, so loads of unknown keys are misses
+    if (IsString(key)) {
+      key = insert ? heap->string_table()->Intern(key) :
+                     heap->string_table()->Find(key);
+      if (key == NULL) return Heap::kTagNil;
+    }
+
     keyptr = key;
     hash = RuntimeGetHash(heap, key);
   }
@@ -183,8 +229,13 @@ intptr_t RuntimeLookupProperty(Heap* heap,
     bool needs_grow = true;
     do {
       key_slot = *reinterpret_cast<char**>(space + index);
-      if (key_slot == HNil::New() ||
-          (is_array && key_slot == keyptr) ||
+      if (key_slot == HNil::New() || key_slot == keyptr) {
+        needs_grow = false;
+        break;
+      }
+
+      // Different internalized strings can't be equal
+      if (!(IsInternalizedString(key_slot) && IsInternalizedString(key)) &&
           RuntimeStrictCompare(heap, key_slot, key) == 0) {
         needs_grow = false;
         break;
@@ -202,13 +253,8 @@ intptr_t RuntimeLookupProperty(Heap* heap,
         return RuntimeLookupProperty(heap, obj, keyptr, insert);
       }
 
-      if (key_slot == HNil::New()) {
-        // Reset proto, IC could not work with this object anymore
-        char** proto_slot = HObject::ProtoSlot(obj);
-        *reinterpret_cast<intptr_t*>(proto_slot) = Heap::kICDisabledValue;
-      }
-
       *reinterpret_cast<char**>(space + index) = keyptr;
+      heap->RecordWrite(map, keyptr);
     }
 
     return HMap::kSpaceOffset + index + (mask + HValue::kPointerSize);
@@ -216,6 +262,49 @@ intptr_t RuntimeLookupProperty(Heap* heap,
 }
 
 
+intptr_t RuntimeLookupShapeProperty(Heap* heap,
+                                    char* obj,
+                                    char* key,
+                                    intptr_t insert) {
+  char* shape = HObject::Proto(obj);
+  bool is_string = IsString(key);
+
+  if (is_string) {
+    // Shapes are holding only internalized keys
+    key = insert ? heap->string_table()->Intern(key) :
+                   heap->string_table()->Find(key);
+    if (key == NULL) return Heap::kTagNil;
+
+    intptr_t offset = heap->stub_cache()->Get(shape, key);
+    if (offset != -1) return offset;
+
+    intptr_t index = HShape::Lookup(heap, shape, key);
+    if (index != -1) {
+      offset = HMap::kSpaceOffset + index * HValue::kPointerSize;
+      heap->stub_cache()->Put(shape, key, offset);
+      return offset;
+    }
+  }
+
+  // Shapes contain only string keys
+  if (!insert) return Heap::kTagNil;
+
+  char* next = is_string ? HShape::Transition(heap, shape, key) : NULL;
+  if (next == NULL) {
+    HObject::Normalize(heap, obj);
+    return RuntimeLookupProperty(heap, obj, key, insert);
+  }
+
+  uint32_t index = HShape::Count(next) - 1;
+  if (index >= HObject::Capacity(obj)) RuntimeGrowObject(heap, obj, 0);
+
+  *HObject::ProtoSlot(obj) = next;
+  heap->RecordWrite(obj, next);
+
+  return HMap::kSpaceOffset + index * HValue::kPointerSize;
+}
+
+
 char* RuntimeGrowObject(Heap* heap, char* obj, uint32_t min_size) {
   char** map_addr = HObject::MapSlot(obj);
   HMap* map = HValue::As<HMap>(*map_addr);
@@ -225,11 +314,16 @@ char* RuntimeGrowObject(Heap* heap, char* obj, uint32_t min_size) {
     size = PowerOfTwo(min_size);
   }
 
+  // Array's density depends on the map size, check it before replacing map
+  bool is_dense = HValue::GetTag(obj) == Heap::kTagArray &&
+                  HArray::IsDense(obj);
+
   // Create a new map
   char* new_map = HMap::NewEmpty(heap, size);
 
   // Replace old map with a new
   *map_addr = new_map;
+  heap->RecordWrite(obj, new_map);
 
   // Update mask
   uint32_t mask = (size - 1) * HValue::kPointerSize;
@@ -237,7 +331,12 @@ char* RuntimeGrowObject(Heap* heap, char* obj, uint32_t min_size) {
 
   // And rehash properties to new map
   uint32_t original_size = map->size();
-  if (HValue::GetTag(obj) == Heap::kTagArray && HArray::IsDense(obj)) {
+  if (HValue::GetTag(obj) == Heap::kTagObject && !HObject::IsDictionary(obj)) {
+    // Values are staying at the same indexes
+    memcpy(HValue::As<HMap>(new_map)->space(),
+           map->space(),
+           (original_size << 1) * HValue::kPointerSize);
+  } else if (is_dense) {
     // Dense array's map doesn't contain key pointers, iterate values
     original_size = original_size << 1;
     for (uint32_t i = 0; i < original_size; i++) {
@@ -343,23 +442,25 @@ char* RuntimeToBoolean(Heap* heap, char* value) {
 
   switch (tag) {
     case Heap::kTagString:
-      return HBoolean::New(heap, Heap::kTenureNew, HString::Length(value) > 0);
+      return heap->CreateBoolean(HString::Length(value) > 0);
     case Heap::kTagBoolean:
       return value;
     case Heap::kTagFunction:
     case Heap::kTagObject:
     case Heap::kTagArray:
     case Heap::kTagCData:
-      return HBoolean::New(heap, Heap::kTenureNew, true);
+      return heap->CreateBoolean(true);
     case Heap::kTagNil:
-      return HBoolean::New(heap, Heap::kTenureNew, false);
+      return heap->CreateBoolean(false);
     case Heap::kTagNumber:
       if (HValue::IsUnboxed(value)) {
         int64_t num = HNumber::IntegralValue(value);
-        return HBoolean::New(heap, Heap::kTenureNew, num != 0);
+        return heap->CreateBoolean(num != 0);
       } else {
         double num = HNumber::DoubleValue(value);
-        return HBoolean::New(heap, Heap::kTenureNew, num != 0);
+
+        // NaN is falsy (NaN != NaN)
+        return heap->CreateBoolean(num != 0 && num == num);
       }
     default:
       UNEXPECTED
@@ -489,9 +590,7 @@ char* RuntimeBinOp(Heap* heap, char* lhs, char* rhs) {
       // nil == nil = true
       // nil === nil = true
       // nil (+) nil = false
-      return HBoolean::New(heap,
-                           Heap::kTenureNew,
-                           !BinOp::is_negative_eq(type));
+      return heap->CreateBoolean(!BinOp::is_negative_eq(type));
     }
   }
 
@@ -506,9 +605,7 @@ char* RuntimeBinOp(Heap* heap, char* lhs, char* rhs) {
 
       // When strictly comparing - tags should be equal
       if (lhs_tag != rhs_tag) {
-        return HBoolean::New(heap,
-                             Heap::kTenureNew,
-                             BinOp::is_negative_eq(type));
+        return heap->CreateBoolean(BinOp::is_negative_eq(type));
       }
     } else {
       lhs_tag = RuntimeCoerceType(heap, type, lhs, rhs);
@@ -580,7 +677,7 @@ char* RuntimeBinOp(Heap* heap, char* lhs, char* rhs) {
 
     if (BinOp::is_negative_eq(type)) result = !result;
 
-    return HBoolean::New(heap, Heap::kTenureNew, result);
+    return heap->CreateBoolean(result);
   } else if (BinOp::is_bool_logic(type)) {
     lhs = RuntimeToBoolean(heap, lhs);
     rhs = RuntimeToBoolean(heap, rhs);
@@ -594,7 +691,7 @@ char* RuntimeBinOp(Heap* heap, char* lhs, char* rhs) {
       UNEXPECTED
     }
 
-    return HBoolean::New(heap, Heap::kTenureNew, result);
+    return heap->CreateBoolean(result);
   } else if (type == BinOp::kAdd &&
              (HValue::GetTag(lhs) == Heap::kTagString ||
               HValue::GetTag(rhs) == Heap::kTagString)) {
@@ -693,6 +790,21 @@ char* RuntimeKeysof(Heap* heap, char* value) {
   // Fast-case - return empty array
   if (tag != Heap::kTagArray && tag != Heap::kTagObject) return result;
 
+  // Keys of shape are put in order of their insertion
+  if (tag == Heap::kTagObject && !HObject::IsDictionary(value)) {
+    HMap* table = HValue::As<HMap>(HShape::Table(HObject::Proto(value)));
+    uint32_t size = table->size();
+    for (uint32_t i = 0; i < size; i++) {
+      if (table->IsEmptySlot(i)) continue;
+
+      char* index = *table->GetSlotAddress(i + size);
+      char** slot = HObject::LookupProperty(heap, result, index, 1);
+      *slot = *table->GetSlotAddress(i);
+    }
+
+    return result;
+  }
+
   // Slow-case visit all map's slots and put them into array
   HMap* map = HValue::As<HMap>(HObject::Map(value));
 
@@ -722,7 +834,7 @@ char* RuntimeCloneObject(Heap* heap, char* obj) {
 
   char* result = heap->AllocateTagged(Heap::kTagObject,
                                       Heap::kTenureNew,
-                                      2 * HValue::kPointerSize);
+                                      3 * HValue::kPointerSize);
 
   char* map = heap->AllocateTagged(
       Heap::kTagMap,
@@ -736,8 +848,12 @@ char* RuntimeCloneObject(Heap* heap, char* obj) {
   // Set map
   *reinterpret_cast<char**>(result + HObject::kMapOffset) = map;
 
-  // Set map's proto
-  *reinterpret_cast<void**>(obj + HObject::kProtoOffset) = source_map;
+  // Clone has the same shape (arrays are cloned into dictionaries)
+  if (tag == Heap::kTagObject) {
+    *HObject::ProtoSlot(result) = source_obj->proto();
+  } else {
+    HObject::SetDictionary(result);
+  }
 
   // Set map's size
   *reinterpret_cast<intptr_t*>(map + HMap::kSizeOffset) = source_map->size();
@@ -755,10 +871,15 @@ void RuntimeDeleteProperty(Heap* heap, char* obj, char* property) {
   if (tag != Heap::kTagObject && tag != Heap::kTagArray) return;
 
   intptr_t offset = RuntimeLookupProperty(heap, obj, property, 0);
+  if (offset == Heap::kTagNil) return;
 
-  // Reset proto, IC could not work with this object anymore
-  char** proto_slot = HObject::ProtoSlot(obj);
-  *reinterpret_cast<intptr_t*>(proto_slot) = Heap::kICDisabledValue;
+  // Shapes are never losing keys, IC could not work with this object anymore
+  if (tag == Heap::kTagObject) {
+    HObject::Normalize(heap, obj);
+    offset = RuntimeLookupProperty(heap, obj, property, 0);
+  } else {
+    HObject::SetDictionary(obj);
+  }
 
   // Dense arrays doesn't have keys
   if (HValue::GetTag(obj) != Heap::kTagArray || !HArray::IsDense(obj)) {
@@ -832,5 +953,13 @@ char* RuntimeStackTrace(Heap* heap, char** frame, char* ip) {
   return result;
 }
 
+
+void RuntimeOptimize(Heap* heap, Tiering::Site* site, char* root) {
+  // Counters may wrap around
+  if (site->IsOptimized()) return;
+
+  heap->code_space()->Optimize(site, root);
+}
+
 }  // namespace internal
 }  // namespace candor
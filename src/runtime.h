@@ -30,6 +30,7 @@
 #include "heap.h"  // Heap, Heap::HeapTag
 #include "heap-inl.h"
 #include "ast.h"  // BinOp
+#include "tiering.h"  // Tiering
 
 namespace candor {
 namespace internal {
@@ -39,8 +40,23 @@ typedef char* (*RuntimeAllocateCallback)(Heap* heap,
                                          uint32_t bytes);
 char* RuntimeAllocate(Heap* heap, uint32_t bytes);
 
-typedef void (*RuntimeCollectGarbageCallback)(Heap* heap, char* stack_top);
-void RuntimeCollectGarbage(Heap* heap, char* stack_top);
+// Object or array literal of pretenured allocation site
+// (tag and size are tagged numbers)
+typedef char* (*RuntimeAllocateTenuredCallback)(Heap* heap,
+                                                char* tag,
+                                                char* size);
+char* RuntimeAllocateTenured(Heap* heap, char* tag, char* size);
+
+typedef void (*RuntimeCollectGarbageCallback)(Heap* heap,
+                                              char* stack_top,
+                                              char* frame);
+void RuntimeCollectGarbage(Heap* heap, char* stack_top, char* frame);
+
+// Slow case of write barrier
+typedef void (*RuntimeRecordWriteCallback)(Heap* heap,
+                                           char* holder,
+                                           char* value);
+void RuntimeRecordWrite(Heap* heap, char* holder, char* value);
 
 typedef intptr_t (*RuntimeGetHashCallback)(Heap* heap, char* value);
 intptr_t RuntimeGetHash(Heap* heap, char* value);
@@ -56,6 +72,13 @@ intptr_t RuntimeLookupProperty(Heap* heap,
                                char* key,
                                intptr_t insert);
 
+// Lookup into object in shape mode (transitions it to a new shape on
+// insertion, or switches it to dictionary mode)
+intptr_t RuntimeLookupShapeProperty(Heap* heap,
+                                    char* obj,
+                                    char* key,
+                                    intptr_t insert);
+
 typedef char* (*RuntimeGrowObjectCallback)(Heap* heap,
                                            char* obj,
                                            uint32_t min_size);
@@ -97,6 +120,13 @@ void RuntimeDeleteProperty(Heap* heap, char* obj, char* property);
 typedef char* (*RuntimeStackTraceCallback)(Heap* heap, char** frame, char* ip);
 char* RuntimeStackTrace(Heap* heap, char** frame, char* ip);
 
+// Recompile hot function with optimizing pipeline
+// (`root` is a root context of the baseline code)
+typedef void (*RuntimeOptimizeCallback)(Heap* heap,
+                                        Tiering::Site* site,
+                                        char* root);
+void RuntimeOptimize(Heap* heap, Tiering::Site* site, char* root);
+
 }  // namespace internal
 }  // namespace candor
 
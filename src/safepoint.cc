@@ -0,0 +1,124 @@
+/**
+ * Copyright (c) 2012, Fedor Indutny.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "safepoint.h"
+
+#include <assert.h>  // assert
+#include <stdlib.h>  // NULL
+#include <stdint.h>  // uint32_t
+#include <unistd.h>  // intptr_t
+
+#include "heap.h"  // Heap
+#include "heap-inl.h"  // HNil
+#include "utils.h"  // NumberKey
+
+namespace candor {
+namespace internal {
+
+void SafepointTable::Commit(char* addr) {
+  Safepoint* safepoint;
+  while ((safepoint = queue()->Shift()) != NULL) {
+    safepoint->addr(addr + safepoint->jit_offset());
+
+    SafepointTableBase::Insert(NumberKey::New(safepoint->addr()), safepoint);
+  }
+}
+
+
+Safepoint* SafepointTable::Get(char* addr) {
+  Safepoint* safepoint = SafepointTableBase::Find(NumberKey::New(addr));
+
+  // Tree returns closest lower key, only exact matches are safepoints
+  if (safepoint == NULL || safepoint->addr() != addr) return NULL;
+  return safepoint;
+}
+
+
+FrameIterator::FrameIterator(Heap* heap,
+                             char* stack_top,
+                             char* frame,
+                             bool clear_dead)
+    : safepoints_(heap->safepoints()),
+      slot_(reinterpret_cast<char**>(stack_top)),
+      fixed_(reinterpret_cast<char**>(frame)),
+      frame_(reinterpret_cast<char**>(frame)),
+      safepoint_(NULL),
+      clear_dead_(clear_dead) {
+}
+
+
+char** FrameIterator::Next() {
+  while (slot_ != NULL) {
+    if (slot_ == frame_) {
+      NextFrame();
+      continue;
+    }
+    assert(slot_ < frame_);
+
+    char** slot = slot_++;
+
+    // Words pushed below frame or frame without safepoint
+    if (slot < fixed_) {
+      // Skip C++ frames
+      if (safepoint_ == NULL &&
+          static_cast<uint32_t>(reinterpret_cast<intptr_t>(*slot)) ==
+              Heap::kEnterFrameTag) {
+        // Continue with the stack and frame of the previous exit
+        slot_ = reinterpret_cast<char**>(*(slot + 1));
+        frame_ = reinterpret_cast<char**>(*(slot + 2));
+        fixed_ = frame_;
+        safepoint_ = NULL;
+        continue;
+      }
+
+      return slot;
+    }
+
+    int index = frame_ - slot - 1;
+    if (safepoint_->IsLive(index)) return slot;
+    if (safepoint_->IsRaw(index)) continue;
+
+    // Dead value may be stale after GC, make sure that it won't be visited
+    // by the next one
+    if (clear_dead_ && index >= Safepoint::kFirstSlot) *slot = HNil::New();
+  }
+
+  return NULL;
+}
+
+
+void FrameIterator::NextFrame() {
+  // Skip previous frame pointer and return address
+  char* ret = *(frame_ + 1);
+  slot_ = frame_ + 2;
+  frame_ = reinterpret_cast<char**>(*frame_);
+
+  safepoint_ = safepoints_->Get(ret);
+  if (safepoint_ == NULL) {
+    fixed_ = frame_;
+  } else {
+    fixed_ = frame_ - safepoint_->size();
+  }
+}
+
+}  // namespace internal
+}  // namespace candor
@@ -0,0 +1,125 @@
+/**
+ * Copyright (c) 2012, Fedor Indutny.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef _SRC_SAFEPOINT_H_
+#define _SRC_SAFEPOINT_H_
+
+#include <stdint.h>  // uint32_t
+
+#include "utils.h"  // BitField, List
+#include "splay-tree.h"  // SplayTree
+
+namespace candor {
+namespace internal {
+
+// Forward declarations
+class Heap;
+class Safepoint;
+
+typedef SplayTree<NumberKey, Safepoint, DeletePolicy<Safepoint*>, EmptyClass>
+    SafepointTableBase;
+
+// Layout of compiled function's frame at one of its calls (the only places
+// where GC may happen), looked up by call's return address.
+//
+// Frame's words are counted down from the frame pointer:
+//   0 - frame info, 1 - argc,
+//   2 ... - stack slots (fullgen/lir), followed by masm spills.
+// Safepoint marks words holding live values, others are not visited by GC.
+// Raw words (unboxed doubles) are neither visited nor cleared.
+// Words pushed below the frame (arguments and saved registers) and frames
+// of stubs are always visited.
+class Safepoint {
+ public:
+  explicit Safepoint(uint32_t jit_offset) : jit_offset_(jit_offset),
+                                            addr_(NULL),
+                                            size_(0),
+                                            slots_(32),
+                                            raw_(0) {
+  }
+
+  // First word that may hold a value
+  static const int kFirstSlot = 2;
+
+  inline void Set(int index) { slots_.Set(index); }
+  inline bool IsLive(int index) { return slots_.Test(index); }
+  inline void SetRaw(int index) { raw_.Set(index); }
+  inline bool IsRaw(int index) { return raw_.Test(index); }
+
+  inline uint32_t jit_offset() { return jit_offset_; }
+  inline char* addr() { return addr_; }
+  inline void addr(char* addr) { addr_ = addr; }
+
+  // Size of the frame in words
+  inline uint32_t size() { return size_; }
+  inline void size(uint32_t size) { size_ = size; }
+
+ private:
+  uint32_t jit_offset_;
+  char* addr_;
+  uint32_t size_;
+  BitField<EmptyClass> slots_;
+  BitField<EmptyClass> raw_;
+};
+
+class SafepointTable : SafepointTableBase {
+ public:
+  typedef GenericList<Safepoint*, EmptyClass, NopPolicy> SafepointQueue;
+
+  // Relocate queued safepoints to the code's address
+  void Commit(char* addr);
+  Safepoint* Get(char* addr);
+
+  inline SafepointQueue* queue() { return &queue_; }
+
+ private:
+  SafepointQueue queue_;
+};
+
+// Iterates stack slots that may hold values, starting from the innermost
+// frame (`stack_top` and `frame` are stack and frame pointers of it) and
+// going through all frames of candor code that was reentered from C++.
+class FrameIterator {
+ public:
+  FrameIterator(Heap* heap, char* stack_top, char* frame, bool clear_dead);
+
+  // Returns NULL at the end of stack
+  char** Next();
+
+ protected:
+  void NextFrame();
+
+  SafepointTable* safepoints_;
+
+  char** slot_;
+  char** fixed_;
+  char** frame_;
+  Safepoint* safepoint_;
+
+  // Nil dead slots of compiled frames (GC won't update them)
+  bool clear_dead_;
+};
+
+}  // namespace internal
+}  // namespace candor
+
+#endif  // _SRC_SAFEPOINT_H_
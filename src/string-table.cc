@@ -0,0 +1,163 @@
+/**
+ * Copyright (c) 2012, Fedor Indutny.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "string-table.h"
+
+#include <string.h>  // memcmp, memset
+
+#include "heap.h"
+#include "heap-inl.h"
+#include "gc.h"  // GC
+
+namespace candor {
+namespace internal {
+
+StringTable::StringTable(Heap* heap) : heap_(heap),
+                                       entries_(NULL),
+                                       capacity_(0),
+                                       size_(0),
+                                       used_(0) {
+  Rehash(kInitialSize);
+}
+
+
+StringTable::~StringTable() {
+  delete[] entries_;
+}
+
+
+char* StringTable::Intern(char* str) {
+  if (HString::IsInternalized(str)) return str;
+
+  // Cons strings are flattened into their left part
+  if (HString::Repr(str) == HString::kCons) {
+    HString::Value(heap_, str);
+    str = HString::LeftCons(str);
+  }
+
+  char** free_slot = NULL;
+  char** slot = Lookup(str, &free_slot);
+  if (*slot != NULL) {
+    // String may be unreachable for incremental marking, but
+    // it's going to be stored somewhere now
+    HValue* hentry = HValue::Cast(*slot);
+    if (heap_->gc()->is_marking() &&
+        hentry->Generation() >= Heap::kMinOldSpaceGeneration) {
+      heap_->gc()->MarkValue(hentry);
+    }
+    return *slot;
+  }
+
+  if (free_slot == NULL) {
+    free_slot = slot;
+    used_++;
+  }
+  *free_slot = str;
+  size_++;
+  HString::SetInternalized(str);
+
+  // Keep at least a half of table empty
+  if (used_ << 1 > capacity_) {
+    Rehash(size_ << 2 > capacity_ ? capacity_ << 1 : capacity_);
+  }
+
+  return str;
+}
+
+
+char* StringTable::Find(char* str) {
+  if (HString::IsInternalized(str)) return str;
+
+  // Cons strings are flattened into their left part
+  if (HString::Repr(str) == HString::kCons) {
+    HString::Value(heap_, str);
+    str = HString::LeftCons(str);
+  }
+
+  return *Lookup(str, NULL);
+}
+
+
+char** StringTable::Lookup(char* str, char*** removed) {
+  uint32_t hash = HString::Hash(heap_, str);
+  uint32_t length = HString::Length(str);
+  char* value = HString::Value(heap_, str);
+
+  uint32_t mask = capacity_ - 1;
+  uint32_t index = hash & mask;
+  while (entries_[index] != NULL) {
+    char* entry = entries_[index];
+    if (entry == HNil::New()) {
+      if (removed != NULL && *removed == NULL) *removed = &entries_[index];
+    } else if (HString::Hash(heap_, entry) == hash &&
+               HString::Length(entry) == length &&
+               memcmp(HString::Value(heap_, entry), value, length) == 0) {
+      return &entries_[index];
+    }
+    index = (index + 1) & mask;
+  }
+
+  return &entries_[index];
+}
+
+
+void StringTable::Relocate(GC* gc) {
+  for (uint32_t i = 0; i < capacity_; i++) {
+    char* entry = entries_[i];
+    if (entry == NULL || entry == HNil::New()) continue;
+
+    HValue* value = HValue::Cast(entry);
+    if (!gc->IsAlive(value)) {
+      entries_[i] = HNil::New();
+      size_--;
+    } else if (value->IsGCMarked()) {
+      entries_[i] = value->GetGCMark();
+    }
+  }
+}
+
+
+void StringTable::Rehash(uint32_t capacity) {
+  char** entries = entries_;
+  uint32_t old_capacity = capacity_;
+
+  entries_ = new char*[capacity];
+  memset(entries_, 0, capacity * sizeof(*entries_));
+  capacity_ = capacity;
+  used_ = size_;
+
+  // Hashes are cached by interned strings, entries are just moved
+  uint32_t mask = capacity_ - 1;
+  for (uint32_t i = 0; i < old_capacity; i++) {
+    char* entry = entries[i];
+    if (entry == NULL || entry == HNil::New()) continue;
+
+    uint32_t index = HString::Hash(heap_, entry) & mask;
+    while (entries_[index] != NULL) index = (index + 1) & mask;
+    entries_[index] = entry;
+  }
+
+  delete[] entries;
+}
+
+}  // namespace internal
+}  // namespace candor
@@ -0,0 +1,80 @@
+/**
+ * Copyright (c) 2012, Fedor Indutny.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef _SRC_STRING_TABLE_H_
+#define _SRC_STRING_TABLE_H_
+
+#include <stdint.h>  // uint32_t
+
+namespace candor {
+namespace internal {
+
+// Forward declarations
+class Heap;
+class GC;
+
+// Set of internalized strings: flat strings with unique contents, marked by
+// HString::kInternalizedMark. Property keys are interned on their first use,
+// so two internalized keys are equal only if their addresses are.
+// Strings are held weakly - dead ones are removed and moved ones are updated
+// after every GC (see Relocate).
+class StringTable {
+ public:
+  explicit StringTable(Heap* heap);
+  ~StringTable();
+
+  static const uint32_t kInitialSize = 256;
+
+  // Returns internalized string with the same contents as `str`, if there's
+  // no such - flattens `str` and puts it into table
+  char* Intern(char* str);
+
+  // Returns internalized string with the same contents as `str` or NULL,
+  // table isn't changed (property loads shouldn't intern their keys)
+  char* Find(char* str);
+
+  // Remove strings that weren't reached by GC and update moved ones
+  void Relocate(GC* gc);
+
+  inline uint32_t size() { return size_; }
+
+ private:
+  // Slot with internalized string equal to flat `str` or empty slot where it
+  // should be inserted (`removed` receives first slot of removed string)
+  char** Lookup(char* str, char*** removed);
+  void Rehash(uint32_t capacity);
+
+  Heap* heap_;
+
+  // Open addressing, NULL - empty slot, nil - removed string
+  char** entries_;
+  uint32_t capacity_;
+
+  // Count of strings and count of strings with removed entries
+  uint32_t size_;
+  uint32_t used_;
+};
+
+}  // namespace internal
+}  // namespace candor
+
+#endif  // _SRC_STRING_TABLE_H_
@@ -0,0 +1,58 @@
+/**
+ * Copyright (c) 2012, Fedor Indutny.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "stub-cache.h"
+
+#include <string.h>  // memset
+
+namespace candor {
+namespace internal {
+
+StubCache::StubCache() {
+  Clear();
+}
+
+
+intptr_t StubCache::Get(char* shape, char* key) {
+  Entry* entry = GetEntry(shape, key);
+  if (entry->shape != shape || entry->key != key) return -1;
+
+  return entry->offset;
+}
+
+
+void StubCache::Put(char* shape, char* key, intptr_t offset) {
+  Entry* entry = GetEntry(shape, key);
+
+  entry->shape = shape;
+  entry->key = key;
+  entry->offset = offset;
+}
+
+
+void StubCache::Clear() {
+  // NULL never matches shape of object
+  memset(entries_, 0, sizeof(entries_));
+}
+
+}  // namespace internal
+}  // namespace candor
@@ -0,0 +1,79 @@
+/**
+ * Copyright (c) 2012, Fedor Indutny.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef _SRC_STUB_CACHE_H_
+#define _SRC_STUB_CACHE_H_
+
+#include <stdint.h>  // uint32_t
+#include <unistd.h>  // intptr_t
+
+namespace candor {
+namespace internal {
+
+// Global (shape, key) -> value offset cache for objects in shape mode,
+// probed by LookupPropertyStub before the runtime lookup (megamorphic sites
+// are calling stub directly) and filled by runtime. Pairs are hashed by
+// addresses, keys are compared by identity and may be moved or freed by GC,
+// so cache is cleared after each collection.
+class StubCache {
+ public:
+  StubCache();
+
+  static const int kSize = 1024;
+
+  // Entry layout (accessed by generated code):
+  //   shape, key, offset
+  static const int kShapeOffset = 0;
+  static const int kKeyOffset = kShapeOffset + sizeof(intptr_t);
+  static const int kOffsetOffset = kKeyOffset + sizeof(intptr_t);
+  static const int kEntrySize = kOffsetOffset + sizeof(intptr_t);
+
+  // Entry is at: entries + (shape ^ key) & kMask * (kEntrySize / ptr size)
+  static const intptr_t kMask = (kSize - 1) * sizeof(intptr_t);
+
+  // Returns -1 on miss
+  intptr_t Get(char* shape, char* key);
+  void Put(char* shape, char* key, intptr_t offset);
+  void Clear();
+
+  inline char* entries() { return reinterpret_cast<char*>(entries_); }
+
+ private:
+  struct Entry {
+    char* shape;
+    char* key;
+    intptr_t offset;
+  };
+
+  inline Entry* GetEntry(char* shape, char* key) {
+    intptr_t index = (reinterpret_cast<intptr_t>(shape) ^
+                      reinterpret_cast<intptr_t>(key)) & kMask;
+    return &entries_[index / sizeof(intptr_t)];
+  }
+
+  Entry entries_[kSize];
+};
+
+}  // namespace internal
+}  // namespace candor
+
+#endif  // _SRC_STUB_CACHE_H_
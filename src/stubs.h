@@ -42,6 +42,7 @@ namespace internal {
     V(AllocateFunction)\
     V(CallBinding)\
     V(CollectGarbage)\
+    V(RecordWrite)\
     V(Throw)\
     V(Typeof)\
     V(Sizeof)\
@@ -53,6 +54,7 @@ namespace internal {
     V(DeleteProperty)\
     V(HashValue)\
     V(StackTrace)\
+    V(Optimize)\
     V(LoadVarArg)\
     V(StoreVarArg)
 
@@ -0,0 +1,79 @@
+/**
+ * Copyright (c) 2012, Fedor Indutny.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "tiering.h"
+#include "heap.h"  // Heap
+#include "heap-inl.h"
+#include "utils.h"  // OpenHashMap
+
+namespace candor {
+namespace internal {
+
+Tiering::Site::Site(CodeChunk* chunk, int id) : code_(NULL),
+                                               root_(NULL),
+                                               calls_(0),
+                                               back_edges_(0),
+                                               chunk_(chunk),
+                                               id_(id),
+                                               heap_(NULL) {
+}
+
+
+Tiering::Site::~Site() {
+  if (root_ == NULL) return;
+  heap_->Dereference(reinterpret_cast<HValue**>(&root_),
+                     reinterpret_cast<HValue*>(root_));
+}
+
+
+void Tiering::Site::Optimized(Heap* heap, char* code, char* root) {
+  assert(code_ == NULL);
+
+  heap_ = heap;
+  code_ = code;
+  root_ = root;
+
+  // Generated code reads root from the site, GC should update it
+  heap->Reference(Heap::kRefPersistent,
+                  reinterpret_cast<HValue**>(&root_),
+                  reinterpret_cast<HValue*>(root_));
+}
+
+
+Tiering::Tiering(CodeChunk* chunk) : chunk_(chunk) {
+}
+
+
+Tiering::Site* Tiering::GetSite(int id) {
+  assert(id >= 0);
+
+  Site* site = sites_.Get(Key(id));
+  if (site == NULL) {
+    site = new Site(chunk_, id);
+    sites_.Set(Key(id), site);
+  }
+
+  return site;
+}
+
+}  // namespace internal
+}  // namespace candor
@@ -0,0 +1,94 @@
+/**
+ * Copyright (c) 2012, Fedor Indutny.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef _SRC_TIERING_H_
+#define _SRC_TIERING_H_
+
+#include <stdint.h>  // intptr_t
+
+#include "utils.h"  // OpenHashMap, NumberKey
+
+namespace candor {
+namespace internal {
+
+// Forward declarations
+class Heap;
+class CodeChunk;
+
+// Per-chunk table of functions compiled by fullgen, keyed by AST id of the
+// function literal. Baseline code counts invocations and loop back edges in
+// the site and calls OptimizeStub once one of the counters reaches its
+// threshold, after that baseline entry jumps straight to optimized code.
+class Tiering {
+ public:
+  class Site {
+   public:
+    Site(CodeChunk* chunk, int id);
+    ~Site();
+
+    // Optimized code expects `root` as a root context, `root` is a superset
+    // of baseline's one (see Root::Root)
+    void Optimized(Heap* heap, char* code, char* root);
+
+    inline bool IsOptimized() { return code_ != NULL; }
+    inline CodeChunk* chunk() { return chunk_; }
+    inline int id() { return id_; }
+
+    // Layout (accessed by generated code)
+    static const int kCodeOffset = 0;
+    static const int kRootOffset = kCodeOffset + sizeof(char*);
+    static const int kCallsOffset = kRootOffset + sizeof(char*);
+    static const int kBackEdgesOffset = kCallsOffset + sizeof(intptr_t);
+
+   private:
+    char* code_;
+    char* root_;
+    intptr_t calls_;
+    intptr_t back_edges_;
+
+    CodeChunk* chunk_;
+    int id_;
+    Heap* heap_;
+  };
+
+  explicit Tiering(CodeChunk* chunk);
+
+  // Returns existing site or creates new one
+  Site* GetSite(int id);
+
+  static const int kCallThreshold = 1000;
+  static const int kBackEdgeThreshold = 10000;
+
+ private:
+  typedef OpenHashMap<NumberKey, Site> SiteMap;
+
+  // Ids are starting from zero, but keys should be non-NULL
+  static inline NumberKey* Key(int id) { return NumberKey::New(id + 1); }
+
+  CodeChunk* chunk_;
+  SiteMap sites_;
+};
+
+}  // namespace internal
+}  // namespace candor
+
+#endif  // _SRC_TIERING_H_
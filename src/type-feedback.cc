@@ -0,0 +1,48 @@
+/**
+ * Copyright (c) 2012, Fedor Indutny.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "type-feedback.h"
+#include "utils.h"  // OpenHashMap
+
+namespace candor {
+namespace internal {
+
+TypeFeedback::Site* TypeFeedback::GetSite(int id) {
+  assert(id >= 0);
+
+  Site* site = sites_.Get(Key(id));
+  if (site == NULL) {
+    site = new Site();
+    sites_.Set(Key(id), site);
+  }
+
+  return site;
+}
+
+
+TypeFeedback::Site* TypeFeedback::Lookup(int id) {
+  if (id < 0) return NULL;
+  return sites_.Get(Key(id));
+}
+
+}  // namespace internal
+}  // namespace candor
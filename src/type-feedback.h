@@ -0,0 +1,85 @@
+/**
+ * Copyright (c) 2012, Fedor Indutny.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef _SRC_TYPE_FEEDBACK_H_
+#define _SRC_TYPE_FEEDBACK_H_
+
+#include <stdint.h>  // uint8_t
+
+#include "utils.h"  // OpenHashMap, NumberKey
+
+namespace candor {
+namespace internal {
+
+// Per-chunk side table of types observed by baseline (fullgen) code,
+// keyed by AST id of the operation. Sites are filled by generated code and
+// consumed by HIRGen when the function is compiled with the optimizing
+// pipeline. Site addresses are embedded into code, so they are never moved.
+//
+// NOTE: Only operand types of binary operations are recorded. Property
+// accesses in optimized code are specialized at runtime by inline shape
+// caches (see PIC), and calls aren't inlined, so neither seen maps nor call
+// targets would change the code HIR generates.
+class TypeFeedback {
+ public:
+  class Site {
+   public:
+    Site() : smi_(0), number_(0), other_(0) {}
+
+    // Flag layout (written by generated code)
+    static const int kSmiOffset = 0;
+    static const int kNumberOffset = kSmiOffset + sizeof(uint8_t);
+    static const int kOtherOffset = kNumberOffset + sizeof(uint8_t);
+
+    // Only small integers were seen
+    inline bool IsSmi() { return smi_ && !number_ && !other_; }
+
+    // Only numbers (smis or heap numbers) were seen
+    inline bool IsNumber() { return (smi_ || number_) && !other_; }
+
+    inline bool IsEmpty() { return !smi_ && !number_ && !other_; }
+
+   private:
+    uint8_t smi_;
+    uint8_t number_;
+    uint8_t other_;
+  };
+
+  // Returns existing site or creates new one
+  Site* GetSite(int id);
+
+  // Returns NULL if nothing was recorded for `id`
+  Site* Lookup(int id);
+
+ private:
+  typedef OpenHashMap<NumberKey, Site> SiteMap;
+
+  // Ids are starting from zero, but keys should be non-NULL
+  static inline NumberKey* Key(int id) { return NumberKey::New(id + 1); }
+
+  SiteMap sites_;
+};
+
+}  // namespace internal
+}  // namespace candor
+
+#endif  // _SRC_TYPE_FEEDBACK_H_
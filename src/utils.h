@@ -30,6 +30,7 @@
 #include <string.h>  // strncmp, memset
 #include <unistd.h>  // sysconf or getpagesize, intptr_t
 #include <assert.h>  // assert
+#include <sys/time.h>  // gettimeofday
 
 namespace candor {
 namespace internal {
@@ -92,6 +93,12 @@ inline uint32_t PowerOfTwo(uint32_t value) {
 }
 
 
+// Index of the most significant set bit (value shouldn't be zero)
+inline uint32_t Log2(uint32_t value) {
+  return 31 - __builtin_clz(value);
+}
+
+
 class EmptyClass { };
 
 template <class T, class ItemParent>
@@ -335,6 +342,81 @@ class List : public GenericList<T, I, DeletePolicy<T> > {
 };
 
 
+// LIFO stack of values stored in fixed size segments, so pushes are
+// allocation-free except when segment boundary is crossed. One emptied
+// segment is kept to not allocate/free repeatedly around the boundary.
+template <class T>
+class SegmentedStack {
+ public:
+  // Segment (together with its header) fits in 4kb
+  static const int32_t kSegmentSize = (4096 - 2 * sizeof(void*)) / sizeof(T);
+
+  class Segment {
+   public:
+    Segment* prev_;
+    T values_[kSegmentSize];
+  };
+
+  SegmentedStack() : top_(NULL), spare_(NULL), index_(kSegmentSize),
+                     length_(0) {
+  }
+
+  ~SegmentedStack() {
+    while (top_ != NULL) {
+      Segment* prev = top_->prev_;
+      delete top_;
+      top_ = prev;
+    }
+    delete spare_;
+  }
+
+  inline void Push(T value) {
+    if (index_ == kSegmentSize) {
+      Segment* segment = spare_;
+      if (segment == NULL) {
+        segment = new Segment();
+      } else {
+        spare_ = NULL;
+      }
+      segment->prev_ = top_;
+      top_ = segment;
+      index_ = 0;
+    }
+    top_->values_[index_++] = value;
+    length_++;
+  }
+
+  inline T Pop() {
+    if (length_ == 0) return NULL;
+
+    T value = top_->values_[--index_];
+    length_--;
+
+    // Segment is empty, move to previous one (it is always full)
+    if (index_ == 0) {
+      Segment* segment = top_;
+      top_ = segment->prev_;
+      index_ = kSegmentSize;
+
+      delete spare_;
+      spare_ = segment;
+    }
+
+    return value;
+  }
+
+  inline int32_t length() { return length_; }
+
+ private:
+  Segment* top_;
+  Segment* spare_;
+
+  // Number of used values in top segment
+  int32_t index_;
+  int32_t length_;
+};
+
+
 template <class Base>
 class StringKey : public Base {
  public:
@@ -540,6 +622,146 @@ class ZoneMap : public GenericHashMap<Key, Value, ItemParent, NopPolicy> {
  public:
 };
 
+// Open addressing (linear probing) map, grows to keep at most half of the
+// slots used. Removed items are only marked as deleted (and purged on
+// rehash), so removal is safe while iterating, insertion is not.
+template <class Key, class Value, class Policy>
+class GenericOpenHashMap {
+ public:
+  class Item {
+   public:
+    inline Key* key() { return key_; }
+    inline Value* value() { return value_; }
+
+   protected:
+    Key* key_;
+
+    // NULL if item was removed
+    Value* value_;
+
+    friend class GenericOpenHashMap;
+  };
+
+  GenericOpenHashMap() : size_(kInitialSize), count_(0), deleted_(0) {
+    items_ = new Item[size_];
+    memset(items_, 0, sizeof(*items_) * size_);
+  }
+
+  ~GenericOpenHashMap() {
+    for (uint32_t i = 0; i < size_; i++) {
+      if (items_[i].value_ != NULL) Policy::Delete(items_[i].value_);
+    }
+    delete[] items_;
+    items_ = NULL;
+  }
+
+  inline void Set(Key* key, Value* value) {
+    assert(key != NULL && value != NULL);
+
+    // Overwrite key
+    Item* item = Find(key);
+    if (item != NULL) {
+      item->value_ = value;
+      return;
+    }
+
+    if ((count_ + deleted_ + 1) * 2 > size_) Rehash();
+
+    // Take first free or deleted slot
+    uint32_t index = Key::Hash(key) & (size_ - 1);
+    while (items_[index].value_ != NULL) index = (index + 1) & (size_ - 1);
+
+    if (items_[index].key_ != NULL) deleted_--;
+    items_[index].key_ = key;
+    items_[index].value_ = value;
+    count_++;
+  }
+
+  inline Value* Get(Key* key) {
+    Item* item = Find(key);
+    return item == NULL ? NULL : item->value_;
+  }
+
+  inline void RemoveOne(Key* key) {
+    Value* value = Take(key);
+    if (value != NULL) Policy::Delete(value);
+  }
+
+  // Remove item without deleting value
+  inline Value* Take(Key* key) {
+    Item* item = Find(key);
+    if (item == NULL) return NULL;
+
+    Value* value = item->value_;
+    item->value_ = NULL;
+    count_--;
+    deleted_++;
+
+    return value;
+  }
+
+  inline Item* head() { return NextFrom(0); }
+  inline Item* next(Item* item) { return NextFrom(item - items_ + 1); }
+
+  inline uint32_t count() { return count_; }
+
+ private:
+  inline Item* Find(Key* key) {
+    uint32_t index = Key::Hash(key) & (size_ - 1);
+
+    // Deleted items are keeping their keys to not break probe sequences
+    while (items_[index].key_ != NULL) {
+      if (items_[index].value_ != NULL &&
+          Key::IsEqual(items_[index].key_, key)) {
+        return &items_[index];
+      }
+      index = (index + 1) & (size_ - 1);
+    }
+
+    return NULL;
+  }
+
+  inline Item* NextFrom(uint32_t index) {
+    for (; index < size_; index++) {
+      if (items_[index].value_ != NULL) return &items_[index];
+    }
+    return NULL;
+  }
+
+  void Rehash() {
+    Item* items = items_;
+    uint32_t size = size_;
+
+    // Leave enough space for new items (map may shrink too)
+    size_ = kInitialSize;
+    while (size_ < count_ * 4) size_ <<= 1;
+
+    items_ = new Item[size_];
+    memset(items_, 0, sizeof(*items_) * size_);
+    count_ = 0;
+    deleted_ = 0;
+
+    for (uint32_t i = 0; i < size; i++) {
+      if (items[i].value_ != NULL) Set(items[i].key_, items[i].value_);
+    }
+    delete[] items;
+  }
+
+  static const uint32_t kInitialSize = 64;
+
+  Item* items_;
+  uint32_t size_;
+  uint32_t count_;
+  uint32_t deleted_;
+};
+
+template <class Key, class Value>
+class OpenHashMap : public GenericOpenHashMap<Key,
+                                              Value,
+                                              DeletePolicy<Value*> > {
+ public:
+};
+
 class NumberKey {
  public:
   static inline NumberKey* New(const intptr_t value) {
@@ -615,6 +837,10 @@ class BitField : public Base {
     size_ = new_size;
   }
 
+  inline void Reset() {
+    memset(space_, 0, sizeof(*space_) * size_);
+  }
+
   inline bool Test(int key) {
     if ((key / 32) >= size_) return false;
 
@@ -925,6 +1151,13 @@ inline const char* Unescape(const char* value, uint32_t length, uint32_t* res) {
 }
 
 
+inline uint64_t GetTimeMicros() {
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  return static_cast<uint64_t>(tv.tv_sec) * 1000000 + tv.tv_usec;
+}
+
+
 inline uint32_t GetPageSize() {
 #if CANDOR_PLATFORM_DARWIN
   return getpagesize();
@@ -38,12 +38,12 @@ inline void Assembler::emit_rex_if_high(Register src) {
 
 
 inline void Assembler::emit_rexw(Register dst) {
-  emitb(0x48 | dst.high() << 2);
+  emitb(0x48 | dst.high());
 }
 
 
 inline void Assembler::emit_rexw(const Operand& dst) {
-  emitb(0x48 | dst.base().high() << 2);
+  emitb(0x48 | dst.base().high());
 }
 
 
@@ -227,6 +227,14 @@ void Assembler::testb(Register dst, const Immediate src) {
 }
 
 
+void Assembler::testb(const Operand& dst, const Immediate src) {
+  emit_rexw(rax, dst);
+  emitb(0xF6);
+  emit_modrm(dst, 0);
+  emitb(src.value());
+}
+
+
 void Assembler::testl(Register dst, const Immediate src) {
   emit_rexw(rax, dst);
   emitb(0xF7);
@@ -266,6 +274,13 @@ void Assembler::jmp(Condition cond, Label* label) {
 }
 
 
+void Assembler::jmp(Register dst) {
+  emit_rexw(rax, dst);
+  emitb(0xFF);
+  emit_modrm(dst, 4);
+}
+
+
 void Assembler::mov(Register dst, Register src) {
   emit_rexw(dst, src);
   emitb(0x8B);
@@ -479,6 +494,13 @@ void Assembler::inc(Register dst) {
 }
 
 
+void Assembler::inc(const Operand& dst) {
+  emit_rexw(rax, dst);
+  emitb(0xFF);
+  emit_modrm(dst, 0x00);
+}
+
+
 void Assembler::dec(Register dst) {
   emit_rexw(rax, dst);
   emitb(0xFF);
@@ -577,6 +599,15 @@ void Assembler::callq(const Operand& dst) {
 // Floating point instructions
 
 
+void Assembler::movd(DoubleRegister dst, DoubleRegister src) {
+  emitb(0xF3);
+  emit_rexw(dst, src);
+  emitb(0x0F);
+  emitb(0x7E);
+  emit_modrm(dst, src);
+}
+
+
 void Assembler::movd(DoubleRegister dst, Register src) {
   emitb(0x66);
   emit_rexw(dst, src);
@@ -615,6 +646,7 @@ void Assembler::movd(const Operand& dst, DoubleRegister src) {
 
 void Assembler::addqd(DoubleRegister dst, DoubleRegister src) {
   emitb(0xF2);
+  emit_rexw(dst, src);
   emitb(0x0F);
   emitb(0x58);
   emit_modrm(dst, src);
@@ -623,6 +655,7 @@ void Assembler::addqd(DoubleRegister dst, DoubleRegister src) {
 
 void Assembler::subqd(DoubleRegister dst, DoubleRegister src) {
   emitb(0xF2);
+  emit_rexw(dst, src);
   emitb(0x0F);
   emitb(0x5C);
   emit_modrm(dst, src);
@@ -631,6 +664,7 @@ void Assembler::subqd(DoubleRegister dst, DoubleRegister src) {
 
 void Assembler::mulqd(DoubleRegister dst, DoubleRegister src) {
   emitb(0xF2);
+  emit_rexw(dst, src);
   emitb(0x0F);
   emitb(0x59);
   emit_modrm(dst, src);
@@ -639,6 +673,7 @@ void Assembler::mulqd(DoubleRegister dst, DoubleRegister src) {
 
 void Assembler::divqd(DoubleRegister dst, DoubleRegister src) {
   emitb(0xF2);
+  emit_rexw(dst, src);
   emitb(0x0F);
   emitb(0x5E);
   emit_modrm(dst, src);
@@ -647,6 +682,7 @@ void Assembler::divqd(DoubleRegister dst, DoubleRegister src) {
 
 void Assembler::xorqd(DoubleRegister dst, DoubleRegister src) {
   emitb(0x66);
+  emit_rexw(dst, src);
   emitb(0x0F);
   emitb(0x57);
   emit_modrm(dst, src);
@@ -688,6 +724,7 @@ void Assembler::roundsd(DoubleRegister dst,
 
 void Assembler::ucomisd(DoubleRegister dst, DoubleRegister src) {
   emitb(0x66);
+  emit_rexw(dst, src);
   emitb(0x0F);
   emitb(0x2E);
   emit_modrm(dst, src);
@@ -122,6 +122,14 @@ static inline const char* RegisterNameByIndex(int index) {
     case 7: return "r11";
     case 8: return "r12";
     case 9: return "r13";
+    case 10: return "xmm3";
+    case 11: return "xmm4";
+    case 12: return "xmm5";
+    case 13: return "xmm6";
+    case 14: return "xmm7";
+    case 15: return "xmm8";
+    case 16: return "xmm9";
+    case 17: return "xmm10";
     default: UNEXPECTED return "rnil";
   }
 }
@@ -192,6 +200,21 @@ const DoubleRegister xmm15 = { 15 };
 
 const DoubleRegister fscratch = xmm11;
 
+static inline DoubleRegister DoubleRegisterByIndex(int index) {
+  // xmm0-xmm2 are used in stubs, xmm11-xmm15 are reserved
+  switch (index) {
+    case 10: return xmm3;
+    case 11: return xmm4;
+    case 12: return xmm5;
+    case 13: return xmm6;
+    case 14: return xmm7;
+    case 15: return xmm8;
+    case 16: return xmm9;
+    case 17: return xmm10;
+    default: UNEXPECTED return xmm0;
+  }
+}
+
 class Immediate : public ZoneObject {
  public:
   explicit Immediate(uint64_t value) : value_(value) {
@@ -334,6 +357,7 @@ class Assembler {
   void bind(Label* label);
   void jmp(Label* label);
   void jmp(Condition cond, Label* label);
+  void jmp(Register dst);
 
   void cmpq(Register dst, Register src);
   void cmpq(Register dst, const Operand& src);
@@ -345,6 +369,7 @@ class Assembler {
   void cmpb(const Operand& dst, const Immediate src);
 
   void testb(Register dst, const Immediate src);
+  void testb(const Operand& dst, const Immediate src);
   void testl(Register dst, const Immediate src);
 
   void mov(Register dst, Register src);
@@ -379,6 +404,7 @@ class Assembler {
   void xorl(Register dst, Register src);
 
   void inc(Register dst);
+  void inc(const Operand& dst);
   void dec(Register dst);
   void shl(Register dst, const Immediate src);
   void shr(Register dst, const Immediate src);
@@ -395,6 +421,7 @@ class Assembler {
   void callq(const Operand& dst);
 
   // Floating point instructions
+  void movd(DoubleRegister dst, DoubleRegister src);
   void movd(DoubleRegister dst, Register src);
   void movd(DoubleRegister dst, const Operand& src);
   void movd(Register dst, DoubleRegister src);
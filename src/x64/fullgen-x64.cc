@@ -58,6 +58,39 @@ void FLabel::Generate(Masm* masm) {
 
 
 void FEntry::Generate(Masm* masm) {
+  if (site_ != NULL) {
+    Label optimized, baseline;
+    Immediate site(reinterpret_cast<intptr_t>(site_));
+    Operand code(scratch, Tiering::Site::kCodeOffset);
+    Operand root(scratch, Tiering::Site::kRootOffset);
+    Operand calls(scratch, Tiering::Site::kCallsOffset);
+
+    __ mov(scratch, site);
+    __ cmpq(code, Immediate(0));
+    __ jmp(kNe, &optimized);
+
+    // Count invocation and request optimization once function is hot
+    __ inc(calls);
+    __ cmpq(calls, Immediate(Tiering::kCallThreshold));
+    __ jmp(kNe, &baseline);
+
+    __ push(scratch);
+    __ Call(masm->stubs()->GetOptimizeStub());
+
+    // Optimization may fail, continue in baseline code then
+    __ mov(scratch, site);
+    __ cmpq(code, Immediate(0));
+    __ jmp(kEq, &baseline);
+
+    // Enter optimized code with its own root
+    __ bind(&optimized);
+    __ mov(root_reg, root);
+    __ mov(scratch, code);
+    __ jmp(scratch);
+
+    __ bind(&baseline);
+  }
+
   __ push(rbp);
   __ mov(rbp, rsp);
 
@@ -135,6 +168,7 @@ void FStoreContext::Generate(Masm* masm) {
   Operand res(scratch, HContext::GetIndexDisp(inputs[0]->index()));
   __ mov(rax, *inputs[1]->ToOperand());
   __ mov(res, rax);
+  __ RecordWrite(scratch, rax);
 }
 
 
@@ -190,6 +224,7 @@ void FStoreProperty::Generate(Masm* masm) {
 
   Operand slot(rax, 0);
   __ mov(slot, rcx);
+  __ RecordWrite(rbx, rcx);
 
   __ bind(&done);
 }
@@ -229,6 +264,12 @@ void FDeleteProperty::Generate(Masm* masm) {
 
 
 void FAllocateObject::Generate(Masm* masm) {
+  AllocationSite* site = masm->heap()->NewAllocationSite();
+
+  // Padding keeps stack aligned
+  __ pushb(Immediate(Heap::kTagNil));
+  __ mov(scratch, Immediate(HNumber::Tag(reinterpret_cast<intptr_t>(site))));
+  __ push(scratch);
   __ push(Immediate(HNumber::Tag(size_)));
   __ pushb(Immediate(HNumber::Tag(Heap::kTagObject)));
   __ Call(masm->stubs()->GetAllocateObjectStub());
@@ -237,6 +278,12 @@ void FAllocateObject::Generate(Masm* masm) {
 
 
 void FAllocateArray::Generate(Masm* masm) {
+  AllocationSite* site = masm->heap()->NewAllocationSite();
+
+  // Padding keeps stack aligned
+  __ pushb(Immediate(Heap::kTagNil));
+  __ mov(scratch, Immediate(HNumber::Tag(reinterpret_cast<intptr_t>(site))));
+  __ push(scratch);
   __ push(Immediate(HNumber::Tag(size_)));
   __ pushb(Immediate(HNumber::Tag(Heap::kTagArray)));
   __ Call(masm->stubs()->GetAllocateObjectStub());
@@ -249,10 +296,7 @@ void FIf::Generate(Masm* masm) {
   __ Call(masm->stubs()->GetCoerceToBooleanStub());
 
   // Jmp to `right` block if value is `false`
-  Operand bvalue(rax, HBoolean::kValueOffset);
-  __ cmpb(bvalue, Immediate(0));
-  __ jmp(kEq, f_->label);
-  __ jmp(kNe, t_->label);
+  __ IsTrue(rax, f_->label, t_->label);
 }
 
 
@@ -281,9 +325,7 @@ void FNot::Generate(Masm* masm) {
   Label on_false, done;
 
   // Jmp to `right` block if value is `false`
-  Operand bvalue(rax, HBoolean::kValueOffset);
-  __ cmpb(bvalue, Immediate(0));
-  __ jmp(kEq, &on_false);
+  __ IsTrue(rax, &on_false, NULL);
 
   Operand truev(root_reg, HContext::GetIndexDisp(Heap::kRootTrueIndex));
   Operand falsev(root_reg, HContext::GetIndexDisp(Heap::kRootFalseIndex));
@@ -341,6 +383,10 @@ void FBinOp::Generate(Masm* masm) {
   // rbx <- rhs
   __ mov(rax, *inputs[0]->ToOperand());
   __ mov(rbx, *inputs[1]->ToOperand());
+  if (site_ != NULL) {
+    __ RecordTypeFeedback(rax, site_);
+    __ RecordTypeFeedback(rbx, site_);
+  }
   __ Call(stub);
   // result -> rax
   __ mov(*result->ToOperand(), rax);
@@ -526,6 +572,23 @@ void FCall::Generate(Masm* masm) {
 }
 
 
+void FBackEdge::Generate(Masm* masm) {
+  Label done;
+  Operand back_edges(scratch, Tiering::Site::kBackEdgesOffset);
+
+  __ mov(scratch, Immediate(reinterpret_cast<intptr_t>(site_)));
+  __ inc(back_edges);
+  __ cmpq(back_edges, Immediate(Tiering::kBackEdgeThreshold));
+  __ jmp(kNe, &done);
+
+  // Loop is hot, optimized code will be used on the next call
+  __ push(scratch);
+  __ Call(masm->stubs()->GetOptimizeStub());
+
+  __ bind(&done);
+}
+
+
 void FCollectGarbage::Generate(Masm* masm) {
   __ Call(masm->stubs()->GetCollectGarbageStub());
 }
@@ -95,14 +95,57 @@ void LGen::VisitNot(HIRInstruction* instr) {
 }
 
 
+LInstruction* LGen::BoxDouble(HIRInstruction* instr) {
+  LInstruction* op = Add(new LBoxDouble())
+      ->MarkHasCall()
+      ->AddArg(instr, LUse::kAny);
+  ResultFromFixed(op, rax);
+
+  return op;
+}
+
+
 void LGen::VisitBinOp(HIRInstruction* instr) {
+  HIRBinOp* hir = HIRBinOp::Cast(instr);
+
+  if (instr->HasDoubleArgs()) {
+    LInterval* lhs = ToDouble(instr->left());
+    LInterval* rhs = ToDouble(instr->right());
+
+    if (BinOp::is_math(hir->binop_type())) {
+      Bind(new LBinOpDouble())
+          ->SetResult(CreateDouble(), LUse::kRegister)
+          ->AddArg(lhs, LUse::kRegister)
+          ->AddArg(rhs, LUse::kRegister);
+      return;
+    }
+
+    // Comparison used only in branches will be generated by them
+    bool fused = true;
+    HIRInstructionList::Item* head = instr->uses()->head();
+    for (; fused && head != NULL; head = head->next()) {
+      fused = head->value()->Is(HIRInstruction::kIf);
+    }
+    if (fused) return;
+
+    Bind(new LCompareDouble())
+        ->SetResult(CreateVirtual(), LUse::kRegister)
+        ->AddArg(lhs, LUse::kRegister)
+        ->AddArg(rhs, LUse::kRegister);
+    return;
+  }
+
   LInstruction* op;
   LInterval* lhs = ToFixed(instr->left(), rax);
   LInterval* rhs = ToFixed(instr->right(), rbx);
-  HIRBinOp* hir = HIRBinOp::Cast(instr);
 
-  if (instr->right()->IsNumber() && instr->left()->IsNumber() &&
-      BinOp::is_math(hir->binop_type()) && hir->binop_type() != BinOp::kDiv) {
+  // Use inlined smi fast path if operands are known to be numbers or
+  // if baseline code has seen only smis there
+  BinOp::BinOpType type = hir->binop_type();
+  bool numbers = hir->HasSmiFeedback() ||
+                 (instr->right()->IsNumber() && instr->left()->IsNumber());
+  if (numbers && (BinOp::is_logic(type) ||
+                  (BinOp::is_math(type) && type != BinOp::kDiv))) {
     op = Bind(new LBinOpNumber())
         ->MarkHasCall()
         ->AddScratch(CreateVirtual())
@@ -289,6 +332,24 @@ void LGen::VisitCall(HIRInstruction* instr) {
 
 
 void LGen::VisitIf(HIRInstruction* instr) {
+  HIRInstruction* cond = instr->left();
+
+  if (instr->HasDoubleArgs()) {
+    Bind(new LBranchDouble())
+        ->AddArg(ToDouble(cond), LUse::kRegister);
+    return;
+  }
+
+  // Fused comparison of doubles
+  if (cond->Is(HIRInstruction::kBinOp) && cond->HasDoubleArgs()) {
+    LInterval* lhs = ToDouble(cond->left());
+    LInterval* rhs = ToDouble(cond->right());
+    Bind(new LBranchDouble())
+        ->AddArg(lhs, LUse::kRegister)
+        ->AddArg(rhs, LUse::kRegister);
+    return;
+  }
+
   if (instr->left()->IsNumber()) {
     Bind(new LBranchNumber())
         ->AddArg(instr->left(), LUse::kRegister);
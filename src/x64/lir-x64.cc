@@ -27,6 +27,8 @@
 #include "lir-instructions.h"
 #include "lir-instructions-inl.h"
 #include "macroassembler.h"
+#include "code-space.h"  // CodeSpace
+#include "pic.h"  // PIC
 #include "stubs.h"  // Stubs
 
 namespace candor {
@@ -40,6 +42,13 @@ Register LUse::ToRegister() {
 }
 
 
+DoubleRegister LUse::ToDoubleRegister() {
+  assert(is_register());
+  assert(is_double());
+  return DoubleRegisterByIndex(interval()->index());
+}
+
+
 Operand* LUse::ToOperand() {
   assert(is_stackslot());
 
@@ -130,6 +139,12 @@ void LLiteral::Generate(Masm* masm) {
 
 
 void LAllocateObject::Generate(Masm* masm) {
+  AllocationSite* site = masm->heap()->NewAllocationSite();
+
+  // Padding keeps stack aligned
+  __ pushb(Immediate(Heap::kTagNil));
+  __ mov(scratch, Immediate(HNumber::Tag(reinterpret_cast<intptr_t>(site))));
+  __ push(scratch);
   __ push(Immediate(HNumber::Tag(size_)));
   __ pushb(Immediate(HNumber::Tag(Heap::kTagObject)));
   __ Call(masm->stubs()->GetAllocateObjectStub());
@@ -137,6 +152,12 @@ void LAllocateObject::Generate(Masm* masm) {
 
 
 void LAllocateArray::Generate(Masm* masm) {
+  AllocationSite* site = masm->heap()->NewAllocationSite();
+
+  // Padding keeps stack aligned
+  __ pushb(Immediate(Heap::kTagNil));
+  __ mov(scratch, Immediate(HNumber::Tag(reinterpret_cast<intptr_t>(site))));
+  __ push(scratch);
   __ push(Immediate(HNumber::Tag(size_)));
   __ pushb(Immediate(HNumber::Tag(Heap::kTagArray)));
   __ Call(masm->stubs()->GetAllocateObjectStub());
@@ -153,9 +174,7 @@ void LBranch::Generate(Masm* masm) {
   __ Call(masm->stubs()->GetCoerceToBooleanStub());
 
   // Jmp to `right` block if value is `false`
-  Operand bvalue(rax, HBoolean::kValueOffset);
-  __ cmpb(bvalue, Immediate(0));
-  __ jmp(kEq, TargetAt(1)->label);
+  __ IsTrue(rax, TargetAt(1)->label, NULL);
 }
 
 
@@ -180,16 +199,70 @@ void LBranchNumber::Generate(Masm* masm) {
 }
 
 
+void LBranchDouble::Generate(Masm* masm) {
+  DoubleRegister lhs = inputs[0]->ToDoubleRegister();
+
+  // Truthiness of number
+  if (input_count() == 1) {
+    __ xorqd(fscratch, fscratch);
+    __ ucomisd(lhs, fscratch);
+    __ jmp(kEq, TargetAt(1)->label);
+    __ jmp(TargetAt(0)->label);
+    return;
+  }
+
+  // Fused comparison
+  BinOp::BinOpType type = HIRBinOp::Cast(hir()->left())->binop_type();
+  __ ucomisd(lhs, inputs[1]->ToDoubleRegister());
+  __ jmp(masm->BinOpToCondition(type, Masm::kDouble), TargetAt(0)->label);
+  __ jmp(TargetAt(1)->label);
+}
+
+
+// Jumps to `miss` if object in rax doesn't have shape cached by PIC's inline
+// entry, otherwise puts object's map into rbx and address of value's slot
+// into rdx (rax, rbx and rcx are preserved on miss)
+static void GenerateInlineCache(Masm* masm, PIC* pic, Label* miss) {
+  Operand qproto(rax, HObject::kProtoOffset);
+  Operand qmap(rax, HObject::kMapOffset);
+  Operand cached_shape(scratch, PIC::kShapeOffset);
+  Operand cached_offset(scratch, PIC::kOffsetOffset);
+
+  __ IsUnboxed(rax, NULL, miss);
+  __ IsNil(rax, NULL, miss);
+  __ IsHeapObject(Heap::kTagObject, rax, miss, NULL);
+
+  __ mov(scratch, Immediate(reinterpret_cast<intptr_t>(pic)));
+  __ mov(rdx, cached_shape);
+  __ cmpq(rdx, qproto);
+  __ jmp(kNe, miss);
+
+  __ mov(rdx, cached_offset);
+  __ mov(rbx, qmap);
+  __ addq(rdx, rbx);
+}
+
+
 void LLoadProperty::Generate(Masm* masm) {
-  Label done;
+  Label miss, done;
   Masm::Spill rax_s(masm, rax);
 
   // rax <- object
   // rbx <- propery
-  __ mov(rcx, Immediate(0));
   if (HasMonomorphicProperty()) {
-    __ Call(masm->space()->CreatePIC());
+    PIC* pic = masm->space()->CreatePIC();
+    GenerateInlineCache(masm, pic, &miss);
+
+    Operand inline_slot(rdx, 0);
+    __ mov(rax, inline_slot);
+    __ xorq(rdx, rdx);
+    __ jmp(&done);
+
+    __ bind(&miss);
+    __ mov(rcx, Immediate(0));
+    __ Call(pic->addr());
   } else {
+    __ mov(rcx, Immediate(0));
     __ Call(masm->stubs()->GetLookupPropertyStub());
   }
 
@@ -207,17 +280,28 @@ void LLoadProperty::Generate(Masm* masm) {
 
 
 void LStoreProperty::Generate(Masm* masm) {
-  Label done;
+  Label barrier, done;
   Masm::Spill rax_s(masm, rax);
   Masm::Spill rcx_s(masm, rcx);
 
   // rax <- object
   // rbx <- propery
   // rcx <- value
-  __ mov(rcx, Immediate(1));
   if (HasMonomorphicProperty()) {
-    __ Call(masm->space()->CreatePIC());
+    Label miss;
+    PIC* pic = masm->space()->CreatePIC();
+    GenerateInlineCache(masm, pic, &miss);
+
+    Operand inline_slot(rdx, 0);
+    __ mov(inline_slot, rcx);
+    __ xorq(rdx, rdx);
+    __ jmp(&barrier);
+
+    __ bind(&miss);
+    __ mov(rcx, Immediate(1));
+    __ Call(pic->addr());
   } else {
+    __ mov(rcx, Immediate(1));
     __ Call(masm->stubs()->GetLookupPropertyStub());
   }
 
@@ -236,6 +320,9 @@ void LStoreProperty::Generate(Masm* masm) {
   Operand slot(rax, 0);
   __ mov(slot, rcx);
 
+  __ bind(&barrier);
+  __ RecordWrite(rbx, rcx);
+
   __ bind(&done);
 }
 
@@ -299,29 +386,41 @@ void LBinOpNumber::Generate(Masm* masm) {
   __ IsUnboxed(left, &stub_call, NULL);
   __ IsUnboxed(right, &stub_call, NULL);
 
-  // Save left side in case of overflow
-  __ mov(scratch, left);
+  if (BinOp::is_logic(type)) {
+    Operand truev(root_reg, HContext::GetIndexDisp(Heap::kRootTrueIndex));
+    Operand falsev(root_reg, HContext::GetIndexDisp(Heap::kRootFalseIndex));
 
-  switch (type) {
-    case BinOp::kAdd:
-      __ addq(left, right);
-      break;
-    case BinOp::kSub:
-      __ subq(left, right);
-      break;
-    case BinOp::kMul:
-      __ Untag(left);
-      __ imulq(right);
-      break;
-    default:
-      UNEXPECTED
+    // Tagged smis are compared as integers, mov doesn't affect flags
+    __ cmpq(left, right);
+    __ mov(left, truev);
+    __ jmp(masm->BinOpToCondition(type, Masm::kIntegral), &done);
+    __ mov(left, falsev);
+    __ jmp(&done);
+  } else {
+    // Save left side in case of overflow
+    __ mov(scratch, left);
+
+    switch (type) {
+      case BinOp::kAdd:
+        __ addq(left, right);
+        break;
+      case BinOp::kSub:
+        __ subq(left, right);
+        break;
+      case BinOp::kMul:
+        __ Untag(left);
+        __ imulq(right);
+        break;
+      default:
+        UNEXPECTED
+    }
+
+    __ jmp(kNoOverflow, &done);
+
+    // Restore left side
+    __ mov(left, scratch);
   }
 
-  __ jmp(kNoOverflow, &done);
-
-  // Restore left side
-  __ mov(left, scratch);
-
   __ bind(&stub_call);
 
   char* stub = NULL;
@@ -342,6 +441,80 @@ void LBinOpNumber::Generate(Masm* masm) {
 #undef BINARY_SUB_ENUM
 #undef BINARY_SUB_TYPES
 
+void LBinOpDouble::Generate(Masm* masm) {
+  // Result may be in the same register as rhs
+  __ movd(fscratch, inputs[0]->ToDoubleRegister());
+
+  DoubleRegister rhs = inputs[1]->ToDoubleRegister();
+  switch (HIRBinOp::Cast(hir())->binop_type()) {
+    case BinOp::kAdd: __ addqd(fscratch, rhs); break;
+    case BinOp::kSub: __ subqd(fscratch, rhs); break;
+    case BinOp::kMul: __ mulqd(fscratch, rhs); break;
+    case BinOp::kDiv: __ divqd(fscratch, rhs); break;
+    default: UNEXPECTED
+  }
+
+  __ movd(result->ToDoubleRegister(), fscratch);
+}
+
+
+void LCompareDouble::Generate(Masm* masm) {
+  BinOp::BinOpType type = HIRBinOp::Cast(hir())->binop_type();
+  Register res = result->ToRegister();
+  Operand truev(root_reg, HContext::GetIndexDisp(Heap::kRootTrueIndex));
+  Operand falsev(root_reg, HContext::GetIndexDisp(Heap::kRootFalseIndex));
+  Label done;
+
+  __ ucomisd(inputs[0]->ToDoubleRegister(), inputs[1]->ToDoubleRegister());
+
+  // mov doesn't affect flags
+  __ mov(res, truev);
+  __ jmp(masm->BinOpToCondition(type, Masm::kDouble), &done);
+  __ mov(res, falsev);
+  __ bind(&done);
+}
+
+
+void LBoxDouble::Generate(Masm* masm) {
+  // Allocation clobbers double registers, keep raw value on stack
+  // (twice to keep it aligned)
+  if (inputs[0]->is_register()) {
+    __ movd(scratch, inputs[0]->ToDoubleRegister());
+  } else {
+    __ mov(scratch, *inputs[0]->ToOperand());
+  }
+  __ push(scratch);
+  __ push(scratch);
+
+  __ Allocate(Heap::kTagNumber, reg_nil, HNumber::kDoubleSize, rax);
+
+  Operand qvalue(rax, HNumber::kValueOffset);
+  __ pop(scratch);
+  __ pop(scratch);
+  __ mov(qvalue, scratch);
+}
+
+
+void LUnboxDouble::Generate(Masm* masm) {
+  Register src = inputs[0]->ToRegister();
+  DoubleRegister dst = result->ToDoubleRegister();
+  Label heap_number, done;
+
+  __ IsUnboxed(src, &heap_number, NULL);
+
+  __ mov(scratch, src);
+  __ Untag(scratch);
+  __ cvtsi2sd(dst, scratch);
+  __ jmp(&done);
+
+  __ bind(&heap_number);
+  Operand value(src, HNumber::kValueOffset);
+  __ movd(dst, value);
+
+  __ bind(&done);
+}
+
+
 void LFunction::Generate(Masm* masm) {
   // Get function's body address from relocation info
   __ mov(scratches[0]->ToRegister(), Immediate(0));
@@ -525,6 +698,7 @@ void LStoreContext::Generate(Masm* masm) {
   Operand res(scratches[0]->ToRegister(),
               HContext::GetIndexDisp(slot()->index()));
   __ mov(res, inputs[0]->ToRegister());
+  __ RecordWrite(scratches[0]->ToRegister(), inputs[0]->ToRegister());
 }
 
 
@@ -537,9 +711,7 @@ void LNot::Generate(Masm* masm) {
   Label on_false, done;
 
   // Jmp to `right` block if value is `false`
-  Operand bvalue(rax, HBoolean::kValueOffset);
-  __ cmpb(bvalue, Immediate(0));
-  __ jmp(kEq, &on_false);
+  __ IsTrue(rax, &on_false, NULL);
 
   Operand truev(root_reg, HContext::GetIndexDisp(Heap::kRootTrueIndex));
   Operand falsev(root_reg, HContext::GetIndexDisp(Heap::kRootFalseIndex));
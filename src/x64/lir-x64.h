@@ -31,6 +31,9 @@ namespace internal {
 
 const int kLIRRegisterCount = 10;
 
+// Double registers are indexed after general purpose ones
+const int kLIRDoubleRegisterCount = 8;
+
 }  // namespace internal
 }  // namespace candor
 
@@ -37,11 +37,13 @@ void PIC::Generate(Masm* masm) {
   // Place for spills
   __ pushb(Immediate(Heap::kTagNil));
   __ pushb(Immediate(Heap::kTagNil));
+  __ pushb(Immediate(Heap::kTagNil));
 
   Label miss, end;
   Operand rdx_op(rdx, 0);
   Operand proto_op(rax, HObject::kProtoOffset);
-  Operand rax_s(rbp, -16), rbx_s(rbp, -24);
+  Operand mask_op(rax, HObject::kMaskOffset);
+  Operand shape_s(rbp, -8), rax_s(rbp, -16), rbx_s(rbp, -24);
 
   __ mov(rax_s, rax);
   __ mov(rbx_s, rbx);
@@ -66,6 +68,27 @@ void PIC::Generate(Masm* masm) {
           masm->offset() - 8));
     __ cmpq(rdx, rbx);
     __ jmp(kNe, &local_miss);
+
+    if (transitions_[i] != NULL) {
+      // Map should have space for the new value ((mask + 8) * 2 bytes)
+      __ mov(rbx, mask_op);
+      __ addqb(rbx, Immediate(HValue::kPointerSize));
+      __ shl(rbx, Immediate(1));
+      __ cmpq(rbx, Immediate(results_[i] - HMap::kSpaceOffset));
+      __ jmp(kLe, &local_miss);
+
+      // Next shape may be already collected
+      __ mov(rbx, Immediate(reinterpret_cast<intptr_t>(transitions_[i])));
+      transition_offsets_[i] = reinterpret_cast<char**>(
+          static_cast<intptr_t>(masm->offset() - 8));
+      __ mov(scratch, Immediate(Heap::kICZapValue));
+      __ cmpq(rbx, scratch);
+      __ jmp(kEq, &local_miss);
+
+      __ mov(proto_op, rbx);
+      __ RecordWrite(rax, rbx);
+    }
+
     __ mov(rax, Immediate(results_[i]));
     __ xorq(rbx, rbx);
     __ mov(rsp, rbp);
@@ -81,12 +104,25 @@ void PIC::Generate(Masm* masm) {
     __ mov(rbx, rbx_s);
     __ mov(rax, rax_s);
   }
+
+  // Remember shape, lookup may add property and change it
+  {
+    Label not_object;
+    __ IsNil(rax, NULL, &not_object);
+    __ IsUnboxed(rax, NULL, &not_object);
+    __ IsHeapObject(Heap::kTagObject, rax, &not_object, NULL);
+    __ mov(rdx, proto_op);
+    __ mov(shape_s, rdx);
+    __ bind(&not_object);
+  }
+
   __ Call(space_->stubs()->GetLookupPropertyStub());
 
-  // Miss(this, object, result, ip)
+  // Miss(this, object, shape, result, ip)
   Operand caller_ip(rbp, 8);
   __ push(caller_ip);
   __ push(rax);
+  __ push(shape_s);
   __ push(rax_s);
   __ mov(scratch, Immediate(reinterpret_cast<intptr_t>(this)));
   __ push(scratch);
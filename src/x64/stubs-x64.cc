@@ -285,14 +285,63 @@ void AllocateObjectStub::Generate() {
   GeneratePrologue();
 
   // Arguments
+  Operand site(rbp, 32);
   Operand size(rbp, 24);
   Operand tag(rbp, 16);
 
+  Label tenured, done;
+
+  // Site is passed as tagged pointer
+  Operand qallocated(rbx, AllocationSite::kAllocatedOffset);
+  Operand qtenured(rbx, AllocationSite::kTenuredOffset);
+  Operand qheader(rbx, AllocationSite::kHeaderOffset);
+  __ mov(rbx, site);
+  __ Untag(rbx);
+
+  __ mov(scratch, qallocated);
+  __ inc(scratch);
+  __ mov(qallocated, scratch);
+
+  // Objects of this site are long-lived - allocate them in old space
+  __ cmpq(qtenured, Immediate(0));
+  __ jmp(kNe, &tenured);
+
   __ mov(rcx, tag);
   __ mov(rbx, size);
   __ AllocateObjectLiteral(Heap::kTagNil, rcx, rbx, rax);
 
-  GenerateEpilogue(2);
+  __ jmp(&done);
+  __ bind(&tenured);
+
+  RuntimeAllocateTenuredCallback allocate = &RuntimeAllocateTenured;
+
+  {
+    Masm::Align a(masm());
+    __ Pushad();
+
+    // RuntimeAllocateTenured(heap, tag, size)
+    __ mov(rdi, Immediate(reinterpret_cast<intptr_t>(masm()->heap())));
+    __ mov(rsi, tag);
+    __ mov(rdx, size);
+    __ mov(scratch, Immediate(*reinterpret_cast<intptr_t*>(&allocate)));
+    __ Call(scratch);
+    __ Popad(rax);
+  }
+
+  __ bind(&done);
+
+  // Put site's index into object's header (GC will count survivors of new
+  // objects and dead pretenured ones)
+  Operand qtag(rax, HValue::kTagOffset);
+  __ mov(rbx, site);
+  __ Untag(rbx);
+  __ mov(rcx, qheader);
+  __ mov(scratch, qtag);
+  __ orq(scratch, rcx);
+  __ mov(qtag, scratch);
+
+  // Padding + site + size + tag
+  GenerateEpilogue(4);
 }
 
 
@@ -347,9 +396,10 @@ void CollectGarbageStub::Generate() {
   {
     Masm::Align a(masm());
 
-    // RuntimeCollectGarbage(heap, stack_top)
+    // RuntimeCollectGarbage(heap, stack_top, frame)
     __ mov(rdi, Immediate(reinterpret_cast<intptr_t>(masm()->heap())));
     __ mov(rsi, rsp);
+    __ mov(rdx, rbp);
     __ mov(rax, Immediate(*reinterpret_cast<intptr_t*>(&gc)));
     __ Call(rax);
   }
@@ -360,6 +410,50 @@ void CollectGarbageStub::Generate() {
 }
 
 
+void RecordWriteStub::Generate() {
+  GeneratePrologue();
+
+  Operand holder(rbp, 24);
+  Operand value(rbp, 16);
+
+  Label runtime, done;
+
+  __ Pushad();
+
+  // Old values should be marked by runtime
+  __ mov(rbx, value);
+  Operand qgen(rbx, HValue::kGenerationOffset);
+  __ cmpb(qgen, Immediate(Heap::kMinOldSpaceGeneration));
+  __ mov(rax, holder);
+  __ jmp(kGe, &runtime);
+
+  // Skip holders that are already in the remembered set
+  Operand qmark(rax, HValue::kGCMarkOffset);
+  __ testb(qmark, Immediate(HValue::kRememberedMark));
+  __ jmp(kNe, &done);
+
+  __ bind(&runtime);
+
+  RuntimeRecordWriteCallback record = &RuntimeRecordWrite;
+
+  {
+    Masm::Align a(masm());
+
+    // RuntimeRecordWrite(heap, holder, value)
+    __ mov(rdi, Immediate(reinterpret_cast<intptr_t>(masm()->heap())));
+    __ mov(rsi, rax);
+    __ mov(rdx, value);
+    __ mov(rax, Immediate(*reinterpret_cast<intptr_t*>(&record)));
+    __ Call(rax);
+  }
+
+  __ bind(&done);
+  __ Popad(reg_nil);
+
+  GenerateEpilogue(2);
+}
+
+
 void TypeofStub::Generate() {
   GeneratePrologue();
 
@@ -460,21 +554,149 @@ void LookupPropertyStub::Generate() {
     __ IsNil(rbx, NULL, &slow_case);
     __ IsHeapObject(Heap::kTagString, rbx, &slow_case, NULL);
 
+    Operand qmask(rax, HObject::kMaskOffset);
+    Operand qmap(rax, HObject::kMapOffset);
+    Operand qproto(rax, HObject::kProtoOffset);
+
+    Label dictionary, cache_miss, shape_miss, shape_insert;
+
+    __ mov(scratch, qproto);
+    __ cmpq(scratch, Immediate(Heap::kICDisabledValue));
+    __ jmp(kEq, &dictionary);
+
+    // Shape mode: probe stub cache first
+    Operand entry_shape(rdx, StubCache::kShapeOffset);
+    Operand entry_key(rdx, StubCache::kKeyOffset);
+    Operand entry_offset(rdx, StubCache::kOffsetOffset);
+    __ mov(rsi, scratch);
+    __ StubCacheEntry(rsi, rbx, rdx);
+
+    __ cmpq(rsi, entry_shape);
+    __ jmp(kNe, &cache_miss);
+    __ cmpq(rbx, entry_key);
+    __ jmp(kNe, &cache_miss);
+
+    __ mov(rax, entry_offset);
+    __ xorq(rdx, rdx);
+    rsi_s.Unspill();
+    GenerateEpilogue(0);
+
+    __ bind(&cache_miss);
+
+    // Find key's index in shape's table
+    // (offset = hash & mask + kSpaceOffset, as in dictionary)
     __ StringHash(rbx, rdx);
 
-    Operand qmask(rax, HObject::kMaskOffset);
+    // Hashing clobbers scratch
+    __ mov(scratch, qproto);
+    Operand shape_mask(scratch, HShape::kMaskOffset);
+    Operand shape_table(scratch, HShape::kTableOffset);
+    __ mov(rsi, shape_mask);
+    __ andq(rdx, rsi);
+    __ addqb(rdx, Immediate(HMap::kSpaceOffset));
+    __ mov(scratch, shape_table);
+    __ addq(scratch, rdx);
+
+    Operand shape_key(scratch, 0);
+    __ cmpq(rbx, shape_key);
+    __ jmp(kNe, &shape_miss);
+
+    // Value slot contains tagged index, rdx = index * 8 + kSpaceOffset
+    __ addq(scratch, rsi);
+    Operand shape_index(scratch, HValue::kPointerSize);
+    __ mov(rdx, shape_index);
+    __ shl(rdx, Immediate(2));
+    __ addqb(rdx, Immediate(HMap::kSpaceOffset));
+
+    // Remember offset in stub cache
+    Operand new_shape(rax, StubCache::kShapeOffset);
+    Operand new_key(rax, StubCache::kKeyOffset);
+    Operand new_offset(rax, StubCache::kOffsetOffset);
+    __ mov(rsi, qproto);
+    __ StubCacheEntry(rsi, rbx, rax);
+    __ mov(new_shape, rsi);
+    __ mov(new_key, rbx);
+    __ mov(new_offset, rdx);
+
+    __ mov(rax, rdx);
+    __ xorq(rdx, rdx);
+    rsi_s.Unspill();
+    GenerateEpilogue(0);
+
+    // Slot is occupied by other key - let runtime probe further
+    __ bind(&shape_miss);
+    __ mov(scratch, shape_key);
+    __ cmpq(scratch, Immediate(Heap::kTagNil));
+    __ jmp(kNe, &cleanup);
+
+    // There's no such key
+    __ cmpq(rcx, Immediate(0));
+    __ jmp(kNe, &shape_insert);
+
+    __ mov(rax, Immediate(Heap::kTagNil));
+    __ xorq(rdx, rdx);
+    rsi_s.Unspill();
+    GenerateEpilogue(0);
+
+    // Insertion: follow existing transition if object has space for the
+    // new value, everything else is done in runtime
+    __ bind(&shape_insert);
+    __ StringHash(rbx, rdx);
+
+    __ mov(scratch, qproto);
+    Operand transitions(scratch, HShape::kTransitionsOffset);
+    Operand transition_mask(scratch, HShape::kTransitionMaskOffset);
+    __ mov(rsi, transition_mask);
+    __ mov(scratch, transitions);
+    __ IsNil(scratch, NULL, &cleanup);
+
+    __ andq(rdx, rsi);
+    __ addqb(rdx, Immediate(HMap::kSpaceOffset));
+    __ addq(scratch, rdx);
+    __ cmpq(rbx, shape_key);
+    __ jmp(kNe, &cleanup);
+
+    // scratch = next shape
+    __ addq(scratch, rsi);
+    Operand next_shape(scratch, HValue::kPointerSize);
+    __ mov(scratch, next_shape);
+
+    // rdx = offset of new value from the start of map's space
+    Operand next_count(scratch, HShape::kCountOffset);
+    __ mov(rdx, next_count);
+    __ dec(rdx);
+    __ shl(rdx, Immediate(3));
+
+    // Map contains (mask + 8) * 2 bytes of values
+    __ mov(rsi, qmask);
+    __ addqb(rsi, Immediate(HValue::kPointerSize));
+    __ shl(rsi, Immediate(1));
+    __ cmpq(rdx, rsi);
+    __ jmp(kGe, &cleanup);
+
+    __ mov(qproto, scratch);
+    __ RecordWrite(rax, scratch);
+
+    __ mov(rax, rdx);
+    __ addqb(rax, Immediate(HMap::kSpaceOffset));
+
+    __ xorq(rdx, rdx);
+    rsi_s.Unspill();
+    GenerateEpilogue(0);
+
+    __ bind(&dictionary);
+
+    __ StringHash(rbx, rdx);
     __ mov(rsi, qmask);
 
     // offset = hash & mask + kSpaceOffset
     __ andq(rdx, rsi);
     __ addqb(rdx, Immediate(HMap::kSpaceOffset));
 
-    Operand qmap(rax, HObject::kMapOffset);
-    Operand qproto(rax, HObject::kProtoOffset);
     __ mov(scratch, qmap);
     __ addq(scratch, rdx);
 
-    Label match, same_key;
+    Label match;
 
     // rdx now contains pointer to the key slot in map's space
     // compare key's addresses
@@ -489,6 +711,13 @@ void LookupPropertyStub::Generate() {
     __ cmpq(scratch, Immediate(Heap::kTagNil));
     __ jmp(kNe, &cleanup);
 
+    // Only internalized keys are inserted, others are interned by runtime
+    __ cmpq(rcx, Immediate(0));
+    __ jmp(kEq, &match);
+    Operand key_repr(rbx, HValue::kRepresentationOffset);
+    __ testb(key_repr, Immediate(HString::kInternalizedMark));
+    __ jmp(kEq, &cleanup);
+
     __ bind(&match);
 
     Label fast_case_end;
@@ -497,19 +726,14 @@ void LookupPropertyStub::Generate() {
     __ cmpq(rcx, Immediate(0));
     __ jmp(kEq, &fast_case_end);
 
-    // Inserting key in map is required
-    // invalidate IC if key wasn't the same
-    __ IsNil(scratch, &same_key, NULL);
-
-    __ mov(qproto, Immediate(Heap::kICDisabledValue));
-    __ bind(&same_key);
-
     // Restore map's interior pointer
     __ mov(scratch, qmap);
     __ addq(scratch, rdx);
 
     // Put the key into slot
     __ mov(slot, rbx);
+    __ mov(scratch, qmap);
+    __ RecordWrite(scratch, rbx);
 
     __ bind(&fast_case_end);
 
@@ -619,16 +843,18 @@ void PICMissStub::Generate() {
 
   Operand self(rbp, 16);
   Operand object(rbp, 24);
-  Operand result(rbp, 32);
-  Operand ip(rbp, 40);
+  Operand shape(rbp, 32);
+  Operand result(rbp, 40);
+  Operand ip(rbp, 48);
 
   // Amend PIC
   __ Pushad();
 
   __ mov(rdi, self);
   __ mov(rsi, object);
-  __ mov(rdx, result);
-  __ mov(rcx, ip);
+  __ mov(rdx, shape);
+  __ mov(rcx, result);
+  __ mov(r8, ip);
 
   PIC::MissCallback miss_cb = &PIC::Miss;
   __ mov(rax, Immediate(*reinterpret_cast<intptr_t*>(&miss_cb)));
@@ -699,6 +925,8 @@ void CloneObjectStub::Generate() {
   __ IsNil(rax, NULL, &non_object);
   __ IsHeapObject(Heap::kTagObject, rax, &non_object, NULL);
 
+  Masm::Spill rax_s(masm(), rax);
+
   // Get map
   Operand qmap(rax, HObject::kMapOffset);
   __ mov(rax, qmap);
@@ -718,9 +946,12 @@ void CloneObjectStub::Generate() {
   Operand qmap_rbx(rbx, HObject::kMapOffset);
   __ mov(rbx, qmap_rbx);
 
-  // Set proto
+  // Clone has the same shape
   Operand qproto(rdx, HObject::kProtoOffset);
-  __ mov(qproto, rax);
+  rax_s.Unspill(scratch);
+  Operand qsource_proto(scratch, HObject::kProtoOffset);
+  __ mov(scratch, qsource_proto);
+  __ mov(qproto, scratch);
 
   // Skip headers
   __ addqb(rax, Immediate(HMap::kSpaceOffset));
@@ -753,7 +984,7 @@ void CloneObjectStub::Generate() {
   __ jmp(&done);
   __ bind(&non_object);
 
-  __ mov(rcx, Immediate(HNumber::Tag(16)));
+  __ mov(rcx, Immediate(HNumber::Tag(HObject::kDefaultSize)));
 
   // Allocate new object
   __ AllocateObjectLiteral(Heap::kTagObject, reg_nil, rcx, rax);
@@ -836,6 +1067,37 @@ void StackTraceStub::Generate() {
 }
 
 
+void OptimizeStub::Generate() {
+  GeneratePrologue();
+
+  // Arguments
+  Operand site(rbp, 16);
+
+  RuntimeOptimizeCallback optimize = &RuntimeOptimize;
+
+  __ Pushad();
+
+  // Stub may be called from function's entry, align stack manually
+  // (rbx is preserved by callee)
+  __ mov(rbx, rsp);
+  __ mov(scratch, Immediate(-16));
+  __ andq(rsp, scratch);
+
+  // RuntimeOptimize(heap, site, root)
+  __ mov(rdx, root_reg);
+  __ mov(rsi, site);
+  __ mov(rdi, Immediate(reinterpret_cast<intptr_t>(masm()->heap())));
+  __ mov(rax, Immediate(*reinterpret_cast<intptr_t*>(&optimize)));
+  __ callq(rax);
+
+  __ mov(rsp, rbx);
+
+  __ Popad(reg_nil);
+
+  GenerateEpilogue(1);
+}
+
+
 #define BINARY_SUB_TYPES(V)\
     V(Add)\
     V(Sub)\
@@ -1204,6 +1466,7 @@ void LoadVarArgStub::Generate() {
 
   // Put argument in array
   __ mov(slot, offset);
+  __ RecordWrite(arr, offset);
 
   arr_s.Unspill();
 
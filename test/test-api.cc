@@ -1,4 +1,9 @@
 #include "test.h"
+#include <hir.h>
+#include <sys/wait.h>  // waitpid
+#if CANDOR_PLATFORM_LINUX
+#include <malloc.h>  // mallopt
+#endif  // CANDOR_PLATFORM_LINUX
 
 static Value* Callback(uint32_t argc, Value* argv[]) {
   ASSERT(argc == 3);
@@ -82,6 +87,18 @@ static Value* GetWeak(uint32_t argc, Value* argv[]) {
   return *obj;
 }
 
+static int stack_trace_called = 0;
+
+static Value* CheckStackTrace(uint32_t argc, Value* argv[]) {
+  Array* arr = Isolate::GetCurrent()->StackTrace();
+  ASSERT(arr->Length() == 2);
+  ASSERT(arr->Get(0)->As<Object>()->Get("line")->As<Number>()->Value() == 3);
+  ASSERT(arr->Get(1)->As<Object>()->Get("line")->As<Number>()->Value() == 2);
+
+  stack_trace_called++;
+  return Nil::New();
+}
+
 struct CDataStruct {
   int x;
   int y;
@@ -165,6 +182,49 @@ static Value* Unwrap(uint32_t argc, Value* argv[]) {
   return w->Wrap();
 }
 
+
+static Value* LocalsCallback(uint32_t argc, Value* argv[]) {
+  ASSERT(argc == 1);
+
+  HandleScope scope;
+  Local<Function> gc(argv[0]);
+
+  // Fill several blocks of arena
+  HandleArena* handles = Heap::Current()->handles();
+  Local<Object> objects[3000];
+  for (int i = 0; i < 3000; i++) {
+    objects[i] = Local<Object>(Object::New());
+    objects[i]->Set("index", Number::NewIntegral(i));
+
+    // Nested scope's locals are released on leave
+    char** top = handles->top();
+    int block = handles->block();
+    {
+      HandleScope inner;
+      for (int j = 0; j < 10; j++) {
+        Local<Number> n(Number::NewDouble(j));
+      }
+      ASSERT(handles->top() != top);
+    }
+    ASSERT(handles->top() == top);
+    ASSERT(handles->block() == block);
+  }
+
+  // Objects are moved, garbage is allocated in place of old copies
+  for (int k = 0; k < 3; k++) {
+    gc->Call(0, NULL);
+    for (int i = 0; i < 3000; i++) {
+      Object::New()->Set("index", Number::NewIntegral(-1));
+    }
+  }
+
+  for (int i = 0; i < 3000; i++) {
+    ASSERT(objects[i]->Get("index")->As<Number>()->IntegralValue() == i);
+  }
+
+  return Number::NewIntegral(3000);
+}
+
 TEST_START(api)
   FUN_TEST("return (a, b, c) {\n"
            "return a + b + c(1, 2, () { __$gc()\nreturn 3 }) + 2\n"
@@ -216,6 +276,17 @@ TEST_START(api)
     ASSERT(clone->Get("b")->As<Number>()->Value() == 2);
   })
 
+  // Missing keys of objects in shape mode have no slot
+  FUN_TEST("return { a: 1 }", {
+    Object* obj = result->As<Object>();
+
+    ASSERT(obj->Get("b")->Is<Nil>());
+    obj->Set("b", Number::NewIntegral(2));
+    ASSERT(obj->Get("b")->As<Number>()->Value() == 2);
+    ASSERT(Object::New()->Get("b")->Is<Nil>());
+    ASSERT(obj->Get("a")->As<Number>()->Value() == 1);
+  })
+
   FUN_TEST("return () { return global.g }", {
     Handle<Object> global(Object::New());
     global->Set(String::New("g", 1), Number::NewIntegral(1234));
@@ -235,6 +306,25 @@ TEST_START(api)
     ASSERT(ret->As<Number>()->Value() == 1234);
   })
 
+  // Booleans are canonical
+  FUN_TEST("a = 1\nb = 'x'\n"
+           "return [ a < 2, b == 'x', !nil, a > 2, b === 1, !{} ]", {
+    Array* arr = result->As<Array>();
+
+    ASSERT(arr->Get(0) == Boolean::True());
+    ASSERT(arr->Get(1) == Boolean::True());
+    ASSERT(arr->Get(2) == Boolean::True());
+    ASSERT(arr->Get(3) == Boolean::False());
+    ASSERT(arr->Get(4) == Boolean::False());
+    ASSERT(arr->Get(5) == Boolean::False());
+  })
+
+  // NaN is falsy
+  FUN_TEST("z = 0.0\nreturn z / z", {
+    ASSERT(result->Is<Number>());
+    ASSERT(result->ToBoolean() == Boolean::False());
+  })
+
   FUN_TEST("return 1", {
     String* str = result->ToString();
 
@@ -282,6 +372,40 @@ TEST_START(api)
     ASSERT(weak_called == 1);
   }
 
+  // Same stack trace from baseline code: both functions are padded to be
+  // too large for the optimizing compiler
+  {
+    Isolate i;
+    const char* head = "get = global.get\n"
+                       "(() {\n"
+                       "  x = get()\n";
+    const char* tail = "})()\n";
+    const char* pad = "pad = 0\n";
+
+    char source[2 * HIRGen::kMaxOptimizableSize + 1024];
+    uint32_t len = 0;
+    for (int j = 0; j < 2; j++) {
+      const char* part = j == 0 ? head : tail;
+      uint32_t start = len;
+      memcpy(source + len, part, strlen(part));
+      len += strlen(part);
+      while (len - start < HIRGen::kMaxOptimizableSize) {
+        memcpy(source + len, pad, strlen(pad));
+        len += strlen(pad);
+      }
+    }
+
+    Function* f = Function::New("api", source, len);
+
+    Object* global = Object::New();
+    global->Set(String::New("get", 3), Function::New(CheckStackTrace));
+
+    f->SetContext(global);
+
+    f->Call(0, NULL);
+    ASSERT(stack_trace_called == 1);
+  }
+
   {
     Isolate i;
     const char* code = "return () {\n__$gc()\n__$gc()\n__$gc()\n}";
@@ -300,6 +424,37 @@ TEST_START(api)
     ASSERT(weak_handle_called == 1);
   }
 
+  // Lots of handles and weak references (moved by GC)
+  {
+    Isolate i;
+    const char* code = "return () {\n__$gc()\n__$gc()\n}";
+
+    Function* f = Function::New("api", code, strlen(code));
+    Handle<Function> gc(f->Call(0, NULL)->As<Function>());
+
+    const int count = 20000;
+    Handle<Object>** handles = new Handle<Object>*[count];
+    for (int j = 0; j < count; j++) {
+      handles[j] = new Handle<Object>(Object::New());
+      (*handles[j])->Set("index", Number::NewIntegral(j));
+      (*handles[j])->SetWeakCallback(WeakHandleCallback);
+    }
+
+    int called = weak_handle_called;
+    gc->Call(0, NULL);
+
+    for (int j = 0; j < count; j++) {
+      Object* obj = **handles[j];
+      ASSERT(obj->Get("index")->As<Number>()->IntegralValue() == j);
+      obj->ClearWeak();
+      delete handles[j];
+    }
+    delete[] handles;
+
+    gc->Call(0, NULL);
+    ASSERT(weak_handle_called == called);
+  }
+
   // CData
   {
     Isolate i;
@@ -352,6 +507,27 @@ TEST_START(api)
     ASSERT(wrapper_destroyed == 1);
   }
 
+  // Local handles
+  {
+    Isolate i;
+    const char* code = "locals = global.locals\n"
+                       "gc() {\n"
+                       "  __$gc()\n"
+                       "  __$gc()\n"
+                       "}\n"
+                       "return locals(gc) + locals(gc)";
+
+    Function* f = Function::New("api", code, strlen(code));
+
+    Object* global = Object::New();
+    global->Set(String::New("locals", 6), Function::New(LocalsCallback));
+
+    f->SetContext(global);
+
+    Value* ret = f->Call(0, NULL);
+    ASSERT(ret->As<Number>()->IntegralValue() == 6000);
+  }
+
   // Regressions
   {
     Isolate i;
@@ -372,4 +548,36 @@ TEST_START(api)
     Value* ret = f->Call(0, NULL);
     ASSERT(ret->Is<Function>());
   }
+
+  // Isolate releases code before the heap that code references (freed
+  // memory is poisoned in the child, so a late heap access crashes it)
+  {
+    pid_t pid = fork();
+    ASSERT(pid != -1);
+    if (pid == 0) {
+#if CANDOR_PLATFORM_LINUX
+      mallopt(M_PERTURB, 0xff);
+#endif  // CANDOR_PLATFORM_LINUX
+      {
+        Isolate i;
+        const char* code = "inc(x) {\n"
+                           "  return x + 1\n"
+                           "}\n"
+                           "i = 0\n"
+                           "while (i < 5000) {\n"
+                           "  i = inc(i)\n"
+                           "}\n"
+                           "return i";
+
+        Function* f = Function::New("api", code, strlen(code));
+        ASSERT(f->Call(0, NULL)->As<Number>()->Value() == 5000);
+      }
+      _exit(0);
+    }
+
+    int status;
+    ASSERT(waitpid(pid, &status, 0) == pid);
+    ASSERT(WIFEXITED(status));
+    ASSERT(WEXITSTATUS(status) == 0);
+  }
 TEST_END(api)
@@ -1,4 +1,41 @@
 #include "test.h"
+#include <code-space.h>
+#include <pic.h>
+#include <parser.h>
+#include <hir.h>
+#include <hir-inl.h>
+#include <tiering.h>
+
+// Returns chunk compiled from script `code` in the current isolate (stubs
+// and optimized code have their own chunks)
+static CodeChunk* FindChunk(const char* code) {
+  CodeChunk* chunk = NULL;
+  CodeChunkList* chunks = Heap::Current()->code_space()->chunks();
+  CodeChunkList::Item* head = chunks->head();
+  for (; head != NULL; head = head->next()) {
+    CodeChunk* c = head->value();
+    if (c->source_len() == strlen(code) &&
+        strncmp(c->source(), code, c->source_len()) == 0) {
+      chunk = c;
+    }
+  }
+  return chunk;
+}
+
+// Returns tiering site of the `index`th function in chunk's source
+// (script's body is the 0th)
+static Tiering::Site* GetTieringSite(CodeChunk* chunk, int index) {
+  Zone z;
+  Parser p(chunk->source(), chunk->source_len());
+  AstNode* ast = p.Execute();
+  ASSERT(!p.has_error());
+
+  FunctionIterator it(ast);
+  for (int i = 0; i < index; i++) it.Advance();
+  ASSERT(!it.IsEnded());
+
+  return chunk->tiering()->GetSite(it.Value()->id);
+}
 
 TEST_START(functional)
   // Objects
@@ -250,6 +287,146 @@ TEST_START(functional)
     ASSERT(result->As<Number>()->Value() == 2);
   })
 
+  // Shapes
+  FUN_TEST("make(i) {\n"
+           "  return { x: i, y: i + 1 }\n"
+           "}\n"
+           "i = 0\n"
+           "sum = 0\n"
+           "while (i < 100) {\n"
+           "  o = make(i)\n"
+           "  o.z = i\n"
+           "  sum = sum + o.x + o.y + o.z\n"
+           "  i++\n"
+           "}\n"
+           "return sum", {
+    ASSERT(result->As<Number>()->Value() == 14950);
+  })
+
+  FUN_TEST("a = { x: 1 }\n"
+           "b = { x: 2 }\n"
+           "b.y = 3\n"
+           "a.z = 4\n"
+           "return a.y === nil && b.z === nil && a.x + a.z + b.x + b.y", {
+    ASSERT(result->As<Number>()->Value() == 10);
+  })
+
+  // Switching to dictionary mode
+  FUN_TEST("a = {}\n"
+           "i = 0\n"
+           "while (i < 40) {\n"
+           "  a['k' + i] = i\n"
+           "  i++\n"
+           "}\n"
+           "return a.k0 + a.k31 + a.k32 + a.k39 + sizeof keysof a", {
+    ASSERT(result->As<Number>()->Value() == 142);
+  })
+
+  // Generated keys stop creating shapes after HShape::kMaxShapes
+  FUN_TEST("make(j, k, l) {\n"
+           "  o = {}\n"
+           "  o['a' + j] = j\n"
+           "  o['b' + k] = k\n"
+           "  o['c' + l] = l\n"
+           "  return o['a' + j] + o['b' + k] + o['c' + l] + sizeof keysof o\n"
+           "}\n"
+           "sum = 0\n"
+           "i = 0\n"
+           "while (i < 12288) {\n"
+           "  sum = sum + make(i % 32, (i >> 5) % 32, i >> 10)\n"
+           "  i++\n"
+           "}\n"
+           "return sum", {
+    ASSERT(result->As<Number>()->Value() == 485376);
+  })
+
+  FUN_TEST("a = { x: 1, y: 2, z: 3 }\n"
+           "delete a.y\n"
+           "a.w = 4\n"
+           "return a.x + a.z + a.w + sizeof keysof a", {
+    ASSERT(result->As<Number>()->Value() == 11);
+  })
+
+  // Inline caches: same sites see one shape first, then others
+  FUN_TEST("get(o) {\n"
+           "  return o.x\n"
+           "}\n"
+           "set(o, v) {\n"
+           "  o.x = v\n"
+           "}\n"
+           "objs = [{ x: 1 }, { y: 2, x: 3 }, { x: 4 }, { z: 0, x: 0 }]\n"
+           "i = 0\n"
+           "while (i < 8) {\n"
+           "  o = objs[i % 4]\n"
+           "  set(o, get(o) + 1)\n"
+           "  i++\n"
+           "}\n"
+           "delete objs[0].x\n"
+           "if (get(objs[0]) !== nil || get({ y: 1 }) !== nil) return -1\n"
+           "return get(objs[1]) + get(objs[2]) + get(objs[3])", {
+    ASSERT(result->As<Number>()->Value() == 13);
+  })
+
+  // Adding stores are cached as transitions from the old shape, so their
+  // sites stay monomorphic
+  {
+    Isolate i;
+    const char* code = "add(o, v) {\n"
+                       "  o.y = v\n"
+                       "  return o\n"
+                       "}\n"
+                       "i = 0\n"
+                       "sum = 0\n"
+                       "while (i < 3000) {\n"
+                       "  sum = sum + add({ x: 1 }, i).y\n"
+                       "  i++\n"
+                       "}\n"
+                       "return sum";
+    Function* f = Function::New("test", code, strlen(code));
+    ASSERT(f->Call(0, NULL)->As<Number>()->Value() == 4498500);
+
+    List<PIC*, EmptyClass>* pics = Heap::Current()->code_space()->pics();
+    int transitions = 0;
+    List<PIC*, EmptyClass>::Item* item = pics->head();
+    for (; item != NULL; item = item->next()) {
+      ASSERT(item->value()->size() <= 1);
+      transitions += item->value()->size();
+    }
+    ASSERT(transitions > 0);
+  }
+
+  // Megamorphic site
+  FUN_TEST("get(o) {\n"
+           "  return o.x\n"
+           "}\n"
+           "objs = [{ x: 1 }, { a: 0, x: 2 }, { b: 0, x: 3 }, { c: 0, x: 4 },\n"
+           "        { d: 0, x: 5 }, { e: 0, x: 6 }, { f: 0, x: 7 }, { g: 0 }]\n"
+           "i = 0\n"
+           "sum = 0\n"
+           "while (i < 80) {\n"
+           "  o = objs[i % 8]\n"
+           "  if (i == 40) o.x = 8\n"
+           "  if (get(o) !== nil) sum = sum + get(o)\n"
+           "  i++\n"
+           "}\n"
+           "return sum", {
+    ASSERT(result->As<Number>()->Value() == 315);
+  })
+
+  // Dynamic keys are interned and match literal ones
+  FUN_TEST("a = {}\n"
+           "i = 0\n"
+           "while (i < 40) {\n"
+           "  a['k' + i] = i\n"
+           "  i++\n"
+           "}\n"
+           "a.k5 = a.k5 + 100\n"
+           "b = { k: 1 }\n"
+           "b['' + 'k'] = 2\n"
+           "return a['k' + 5] + a.k39 + a['k3' + '9'] + b.k + sizeof keysof b", {
+    ASSERT(result->As<Number>()->Value() == 186);
+  })
+
   // Numeric keys
   FUN_TEST("a = { 1: 2, 2: 3, '1': 2, '2': 3}\n"
            "return a[1] + a[2] + a['1'] + a['2'] + a[1.0] + a[2.0]", {
@@ -280,4 +457,114 @@ TEST_START(functional)
   FUN_TEST("global.a = 1\nreturn global.a", {
     ASSERT(result->As<Number>()->Value() == 1);
   })
+
+  // Type feedback: baseline code records binop operand types, HIR marks
+  // smi-only binops
+  {
+    bool tiering = CodeSpace::IsTieringEnabled();
+    CodeSpace::EnableTiering();
+
+    Isolate i;
+    const char* code = "add(a, b) {\n"
+                       "  return a + b\n"
+                       "}\n"
+                       "mul(a, b) {\n"
+                       "  return a * b\n"
+                       "}\n"
+                       "i = 0\n"
+                       "while (i < 10) {\n"
+                       "  add(i, 1)\n"
+                       "  mul(i, 0.5)\n"
+                       "  i++\n"
+                       "}\n"
+                       "return add(1, 2)";
+    Function* f = Function::New("test", code, strlen(code));
+    ASSERT(f->Call(0, NULL)->As<Number>()->Value() == 3);
+
+    CodeChunk* chunk = FindChunk(code);
+    ASSERT(chunk != NULL);
+    TypeFeedback* feedback = chunk->feedback();
+
+    // Build HIR from the same source, the way CodeSpace::Optimize does
+    Zone z;
+    Root root(Heap::Current());
+    Parser p(chunk->source(), chunk->source_len());
+    AstNode* ast = p.Execute();
+    ASSERT(!p.has_error());
+    Scope::Analyze(ast);
+
+    int adds = 0;
+    int muls = 0;
+    for (FunctionIterator it(ast); !it.IsEnded(); it.Advance()) {
+      HIRGen gen(Heap::Current(), &root, "test");
+      gen.feedback(feedback);
+      gen.Build(it.Value());
+
+      HIRBlockList::Item* bhead = gen.blocks()->head();
+      for (; bhead != NULL; bhead = bhead->next()) {
+        HIRInstructionList::Item* ihead =
+            bhead->value()->instructions()->head();
+        for (; ihead != NULL; ihead = ihead->next()) {
+          if (!ihead->value()->Is(HIRInstruction::kBinOp)) continue;
+          HIRBinOp* bin = HIRBinOp::Cast(ihead->value());
+
+          // Script's body isn't profiled
+          TypeFeedback::Site* site = feedback->Lookup(bin->ast()->id);
+          if (site == NULL) {
+            ASSERT(!bin->HasSmiFeedback());
+            continue;
+          }
+
+          if (bin->binop_type() == BinOp::kAdd) {
+            ASSERT(site->IsSmi());
+            ASSERT(bin->HasSmiFeedback());
+            adds++;
+          } else if (bin->binop_type() == BinOp::kMul) {
+            ASSERT(!site->IsSmi() && site->IsNumber());
+            ASSERT(!bin->HasSmiFeedback());
+            muls++;
+          }
+        }
+      }
+    }
+    ASSERT(adds == 1 && muls == 1);
+
+    if (!tiering) CodeSpace::DisableTiering();
+  }
+
+  // Tiering: functions are optimized after many calls or loop iterations
+  {
+    bool tiering = CodeSpace::IsTieringEnabled();
+    CodeSpace::EnableTiering();
+
+    Isolate i;
+    const char* code = "inc(x) {\n"
+                       "  return x + 1\n"
+                       "}\n"
+                       "loop(n) {\n"
+                       "  j = 0\n"
+                       "  while (j < n) {\n"
+                       "    j++\n"
+                       "  }\n"
+                       "  return j\n"
+                       "}\n"
+                       "cold() {\n"
+                       "  return 1\n"
+                       "}\n"
+                       "i = 0\n"
+                       "while (i < 1500) {\n"
+                       "  i = inc(i)\n"
+                       "}\n"
+                       "return i + loop(20000) + cold()";
+    Function* f = Function::New("test", code, strlen(code));
+    ASSERT(f->Call(0, NULL)->As<Number>()->Value() == 21501);
+
+    CodeChunk* chunk = FindChunk(code);
+    ASSERT(chunk != NULL);
+    ASSERT(GetTieringSite(chunk, 1)->IsOptimized());
+    ASSERT(GetTieringSite(chunk, 2)->IsOptimized());
+    ASSERT(!GetTieringSite(chunk, 3)->IsOptimized());
+
+    if (!tiering) CodeSpace::DisableTiering();
+  }
 TEST_END(functional)
@@ -1,4 +1,189 @@
 #include "test.h"
+#include <heap-snapshot.h>
+#include <sys/wait.h>  // waitpid
+
+static int out_of_memory_called = 0;
+
+static void OutOfMemoryCallback(Isolate* isolate) {
+  out_of_memory_called++;
+}
+
+// Exit codes of process that runs out of memory
+static const int kOutOfMemoryExit = 42;
+static const int kOutOfMemoryWrongIsolate = 43;
+static Isolate* out_of_memory_isolate = NULL;
+
+static void OutOfMemoryExitCallback(Isolate* isolate) {
+  _exit(isolate == out_of_memory_isolate ? kOutOfMemoryExit :
+                                           kOutOfMemoryWrongIsolate);
+}
+
+static int gc_events = 0;
+static uint64_t gc_copied = 0;
+
+static void GCTraceCallback(Isolate* isolate, const GCEvent& event) {
+  gc_events++;
+  gc_copied += event.bytes_copied;
+}
+
+// Linked lists workload: `mk` creates list's node, `keep` holds live lists
+#define LIST_PRELUDE \
+    "mk = (i, next) {\n" \
+    "  return { x: i, s: 'v' + i, next: next }\n" \
+    "}\n" \
+    "keep = []\n"
+
+// Returns sum of `term` over nodes of the first `count` kept lists
+#define LIST_SUM(count, term) \
+    "sum = 0\n" \
+    "i = 0\n" \
+    "while (i < " count ") {\n" \
+    "  n = keep[i].next\n" \
+    "  while (n) {\n" \
+    "    sum = sum + " term "\n" \
+    "    n = n.next\n" \
+    "  }\n" \
+    "  i = i + 1\n" \
+    "}\n" \
+    "return sum"
+
+// Runs code in the current isolate and checks its numeric result
+static void RunWorkload(const char* code, double expected) {
+  Function* f = Function::New("gc", code, strlen(code));
+  ASSERT(f->Call(0, NULL)->As<Number>()->Value() == expected);
+}
+
+// Exposes space's size class internals
+class TestSpace : public Space {
+ public:
+  TestSpace(Heap* heap, uint32_t page_size) : Space(heap, page_size) {
+  }
+
+  using Space::IndexPage;
+  using Space::FindPage;
+  using Space::AllocateFromFreeList;
+};
+
+// Boxed number that will survive sweep
+static char* AllocateLive(Space* space) {
+  char* addr = space->Allocate(HValue::kPointerSize + HNumber::kDoubleSize);
+  *reinterpret_cast<intptr_t*>(addr + HValue::kTagOffset) = Heap::kTagNumber;
+  HValue::Cast(addr)->SetSoftGCMark();
+  return addr;
+}
+
+static char* AllocateDead(Space* space, uint32_t size) {
+  char* addr = space->Allocate(size);
+  space->AddFiller(addr, size);
+  return addr;
+}
+
+// Exposes snapshot's root filter
+class TestSnapshot : public HeapSnapshot {
+ public:
+  explicit TestSnapshot(Heap* heap) : HeapSnapshot(heap) {
+  }
+
+  using HeapSnapshot::IsHeapValue;
+};
+
+// Numbers of heap snapshot's array (see HeapSnapshot::Write)
+struct SnapshotArray {
+  uint64_t* items;
+  int length;
+};
+
+static char* ReadSnapshot(const char* path) {
+  FILE* fp = fopen(path, "r");
+  if (fp == NULL) return NULL;
+
+  fseek(fp, 0, SEEK_END);
+  long size = ftell(fp);
+  fseek(fp, 0, SEEK_SET);
+
+  char* json = new char[size + 1];
+  size_t read = fread(json, 1, size, fp);
+  json[read] = 0;
+  fclose(fp);
+
+  return json;
+}
+
+static const char* SnapshotArrayStart(const char* json, const char* key) {
+  char prefix[32];
+  snprintf(prefix, sizeof(prefix), "\"%s\":[", key);
+
+  const char* start = strstr(json, prefix);
+  if (start == NULL) return NULL;
+  return start + strlen(prefix);
+}
+
+static SnapshotArray ParseSnapshotArray(const char* json, const char* key) {
+  SnapshotArray res = { NULL, 0 };
+  const char* pos = SnapshotArrayStart(json, key);
+  if (pos == NULL) return res;
+
+  // Every number is followed by at least one separator
+  const char* end = strchr(pos, ']');
+  res.items = new uint64_t[(end - pos) / 2 + 1];
+  while (pos < end) {
+    char* next;
+    res.items[res.length] = strtoull(pos, &next, 10);
+    if (next == pos) break;
+    res.length++;
+    pos = next;
+    while (pos < end && (*pos == ',' || *pos == '\n')) pos++;
+  }
+
+  return res;
+}
+
+// Index of name in snapshot's list of strings (or -1)
+static int SnapshotName(const char* json, const char* key, const char* name) {
+  const char* pos = SnapshotArrayStart(json, key);
+  if (pos == NULL) return -1;
+
+  int len = strlen(name);
+  for (int i = 0; *pos == '"'; i++) {
+    const char* end = strchr(pos + 1, '"');
+    if (end - pos - 1 == len && strncmp(pos + 1, name, len) == 0) return i;
+    pos = end + 1;
+    if (*pos == ',') pos++;
+  }
+
+  return -1;
+}
+
+// Index of node with given address (or -1)
+static int SnapshotNode(SnapshotArray* nodes, uint64_t id) {
+  for (int i = 0; i < nodes->length; i += 4) {
+    if (nodes->items[i] == id) return i / 4;
+  }
+  return -1;
+}
+
+// Target of the first edge going from node, filtered by edge type and
+// target's tag (-1 matches any), returns -1 if there's no such edge
+static int SnapshotEdge(SnapshotArray* nodes,
+                        SnapshotArray* edges,
+                        uint64_t from,
+                        int type,
+                        int tag) {
+  for (int i = 0; i < edges->length; i += 3) {
+    if (edges->items[i] != from) continue;
+    if (type != -1 && edges->items[i + 2] != static_cast<uint64_t>(type)) {
+      continue;
+    }
+
+    int target = SnapshotNode(nodes, edges->items[i + 1]);
+    if (target == -1) continue;
+
+    uint64_t target_tag = nodes->items[target * 4 + 1];
+    if (tag != -1 && target_tag != static_cast<uint64_t>(tag)) continue;
+    return target;
+  }
+  return -1;
+}
 
 TEST_START(gc)
   FUN_TEST("x=1.0\n"
@@ -36,6 +221,125 @@ TEST_START(gc)
     ASSERT(result->As<Number>()->Value() == 1);
   })
 
+  // Interned keys are moved and freed by GC
+  FUN_TEST("a = {}\n"
+           "i = 0\n"
+           "while (i < 40) {\n"
+           "  a['k' + i] = i\n"
+           "  ({})['t' + i] = i\n"
+           "  i++\n"
+           "}\n"
+           "__$gc()\n__$gc()\n"
+           "i = 0\n"
+           "while (i < 40) {\n"
+           "  a['t' + i] = a['k' + i]\n"
+           "  i++\n"
+           "}\n"
+           "__$gc()\n"
+           "return a.k7 + a['t' + 7] + a.t39 + sizeof keysof a", {
+    ASSERT(result->As<Number>()->Value() == 133);
+  })
+
+  // Loads of missing keys don't intern them (both in shape and dictionary
+  // mode)
+  {
+    Isolate i;
+    Heap* heap = Heap::Current();
+
+    const char* code = "o = { a: 1 }\n"
+                       "d = { a: 1, b: 2 }\n"
+                       "delete d.b\n"
+                       "i = 0\n"
+                       "missing = 0\n"
+                       "while (i < 100) {\n"
+                       "  if (o['m' + i] === nil && d['m' + i] === nil) {\n"
+                       "    missing++\n"
+                       "  }\n"
+                       "  i++\n"
+                       "}\n"
+                       "return missing + o['a'] + d['a']";
+    Function* f = Function::New("gc", code, strlen(code));
+    uint32_t interned = heap->string_table()->size();
+    ASSERT(f->Call(0, NULL)->As<Number>()->Value() == 102);
+    ASSERT(heap->string_table()->size() < interned + 10);
+  }
+
+  // Old -> new references (remembered set)
+  FUN_TEST("a = { x: { y: 1 } }\n"
+           "b = [ 1, 2 ]\n"
+           "i = 6\n"
+           "while (--i) { __$gc() }\n"
+           "a.z = { u: 2 }\n"
+           "b[1] = { v: 3 }\n"
+           "a.x = { y: 4 }\n"
+           "__$gc()\n"
+           "__$gc()\n"
+           "return a.x.y + a.z.u + b[1].v", {
+    ASSERT(result->As<Number>()->Value() == 9);
+  })
+
+  FUN_TEST("fn = () {\n"
+           "  x = { y: 1 }\n"
+           "  i = 6\n"
+           "  while (--i) { __$gc() }\n"
+           "  return () {\n"
+           "    x = { y: x.y + 1 }\n"
+           "    __$gc()\n"
+           "    return x.y\n"
+           "  }\n"
+           "}\n"
+           "f = fn()\n"
+           "f()\n"
+           "return f()", {
+    ASSERT(result->As<Number>()->Value() == 3);
+  })
+
+  FUN_TEST("a = { x: 1, y: [ 1, 2, 3 ] }\n"
+           "b = clone a\n"
+           "s = 'a' + 'b' + 'c'\n"
+           "__$gc()\n"
+           "c = clone b\n"
+           "__$gc()\n"
+           "return c.y[2] + b.x + sizeof s", {
+    ASSERT(result->As<Number>()->Value() == 7);
+  })
+
+  // Large objects (big maps and flattened strings)
+  FUN_TEST("mk = (n) {\n"
+           "  a = []\n"
+           "  j = 0\n"
+           "  while (j < n) {\n"
+           "    a[j] = j\n"
+           "    j = j + 1\n"
+           "  }\n"
+           "  return a\n"
+           "}\n"
+           "lookup = (key, value) {\n"
+           "  h = {}\n"
+           "  h[key] = value\n"
+           "  return h[key]\n"
+           "}\n"
+           "s = 'ab'\n"
+           "i = 0\n"
+           "while (i < 16) {\n"
+           "  s = s + s\n"
+           "  i = i + 1\n"
+           "}\n"
+           "keep = []\n"
+           "step = (i) {\n"
+           "  keep[i % 5] = mk(5000)\n"
+           "  return lookup(s + i, i) + keep[(i * 3) % 5][(i * 7) % 5000]\n"
+           "}\n"
+           "i = 0\n"
+           "sum = 0\n"
+           "while (i < 60) {\n"
+           "  sum = sum + step(i)\n"
+           "  i = i + 1\n"
+           "}\n"
+           "return sum + sizeof s", {
+    ASSERT(result->As<Number>()->Value() == 145204);
+  })
+
   // Stress test
   FUN_TEST("a = 0\ny = 30\nz=1.0\n"
            "while(--y) {\n"
@@ -48,4 +352,643 @@ TEST_START(gc)
            "return a.x.y", {
     ASSERT(result->Is<Object>());
   })
+
+  // Old space sweep: tenured objects die and their memory gets reused
+  FUN_TEST("mk = (i) {\n"
+           "  o = { x: i }\n"
+           "  o.y = { b: i + 1 }\n"
+           "  return o\n"
+           "}\n"
+           "keep = []\n"
+           "i = 0\n"
+           "while (i < 50000) {\n"
+           "  keep[i % 500] = mk(i)\n"
+           "  i = i + 1\n"
+           "}\n"
+           "return keep[7].y.b - keep[7].x + keep[7].x", {
+    ASSERT(result->As<Number>()->Value() == 49508);
+  })
+
+  // Incremental marking: old objects are relinked between marking steps
+  {
+    Isolate i;
+    RunWorkload(LIST_PRELUDE
+                "i = 0\n"
+                "while (i < 3000) {\n"
+                "  keep[i] = mk(i, nil)\n"
+                "  i = i + 1\n"
+                "}\n"
+                "i = 0\n"
+                "while (i < 100000) {\n"
+                "  a = keep[i % 3000]\n"
+                "  b = keep[(i * 7) % 3000]\n"
+                "  a.next = mk(i, b.next)\n"
+                "  b.next = nil\n"
+                "  i = i + 1\n"
+                "}\n"
+                LIST_SUM("3000", "1"),
+                99800);
+  }
+
+  // Parallel new space GC (results should match serial one)
+  uint32_t threads[] = { 1, 4 };
+  for (uint32_t j = 0; j < sizeof(threads) / sizeof(threads[0]); j++) {
+    Isolate i;
+    i.SetScavengerThreads(threads[j]);
+
+    RunWorkload(LIST_PRELUDE
+                "i = 0\n"
+                "while (i < 3000) {\n"
+                "  keep[i] = mk(i, nil)\n"
+                "  i = i + 1\n"
+                "}\n"
+                "i = 0\n"
+                "while (i < 100000) {\n"
+                "  a = keep[i % 3000]\n"
+                "  b = keep[(i * 7) % 3000]\n"
+                "  a.next = mk(i, b.next)\n"
+                "  b.next = nil\n"
+                "  if (i % 100 == 0) {\n"
+                "    keep[i % 3000] = clone a\n"
+                "  }\n"
+                "  i = i + 1\n"
+                "}\n"
+                LIST_SUM("3000", "sizeof n.s"),
+                587714);
+  }
+
+  // Concurrent marking (mutator is changing graph while it's marked)
+  {
+    Isolate i;
+    i.SetConcurrentMarking(true);
+    Heap::Current()->gc()->wait_for_marker(true);
+
+    RunWorkload(LIST_PRELUDE
+                "i = 0\n"
+                "while (i < 5000) {\n"
+                "  keep[i] = mk(i, mk(i, nil))\n"
+                "  i = i + 1\n"
+                "}\n"
+                "i = 0\n"
+                "while (i < 150000) {\n"
+                "  a = keep[i % 5000]\n"
+                "  b = keep[(i * 13) % 5000]\n"
+                "  a.next = mk(i, b.next)\n"
+                "  b.next = mk(i, nil)\n"
+                "  i = i + 1\n"
+                "}\n"
+                LIST_SUM("5000", "sizeof n.s"),
+                968004);
+
+    // Marking thread should have done some work outside of pauses
+    GCStatistics stats;
+    i.GetGCStatistics(&stats);
+    ASSERT(stats.major_gcs > 0);
+    ASSERT(stats.bytes_marked_concurrently > 0);
+  }
+
+  // Pages are reused by following collections
+  {
+    Isolate i;
+    i.SetHugePages(true);
+
+    RunWorkload(LIST_PRELUDE
+                "i = 0\n"
+                "while (i < 200) {\n"
+                "  keep[i % 10] = mk(i, mk(i, nil))\n"
+                "  __$gc()\n"
+                "  i = i + 1\n"
+                "}\n"
+                LIST_SUM("10", "n.x"),
+                1945);
+
+    // New space pages are swapped with pooled ones, nothing is mapped
+    PagePool* pool = Heap::Current()->page_pool();
+    uint32_t mapped = pool->mapped_count();
+
+    i.CollectGarbage(GCEvent::kMinor);
+    uint32_t cached = pool->cached_count();
+    ASSERT(cached != 0);
+    ASSERT(pool->released_count() == 0);
+
+    i.CollectGarbage(GCEvent::kMinor);
+    ASSERT(pool->cached_count() == cached);
+    ASSERT(pool->released_count() == 0);
+    ASSERT(pool->mapped_count() == mapped);
+  }
+
+  // Pages that weren't reused for a whole GC cycle are returned to OS
+  {
+    PagePool pool(64 * 1024);
+    char* a = pool.Allocate(pool.page_size());
+    char* b = pool.Allocate(pool.page_size());
+    ASSERT(pool.mapped_count() == 2);
+
+    // First collection: both pages are released
+    pool.Release(a, pool.page_size());
+    pool.Release(b, pool.page_size());
+    ASSERT(pool.released_count() == 2);
+    pool.Trim();
+    ASSERT(pool.released_count() == 0);
+    ASSERT(pool.cached_count() == 2);
+
+    // Second collection: only one of them is reused
+    ASSERT(pool.Allocate(pool.page_size()) == b);
+    pool.Trim();
+    ASSERT(pool.cached_count() == 0);
+    ASSERT(pool.clean_count() == 1);
+
+    // Trimmed page is still reused before mapping new one
+    ASSERT(pool.Allocate(pool.page_size()) == a);
+    ASSERT(pool.clean_count() == 0);
+    ASSERT(pool.mapped_count() == 2);
+
+    pool.Release(a, pool.page_size());
+    pool.Release(b, pool.page_size());
+  }
+
+  // Heap configuration (limit is reached only by garbage)
+  {
+    HeapConfig config;
+    config.page_size = 64 * 1024;
+    config.initial_new_space_size = 128 * 1024;
+    config.max_new_space_size = 512 * 1024;
+    config.max_old_space_size = 8 * 1024 * 1024;
+    config.growth_factor = 1.5;
+    config.tenure_generation = 2;
+    config.heap_limit = 3 * 1024 * 1024;
+    config.out_of_memory_callback = OutOfMemoryCallback;
+
+    Isolate i(config);
+
+    RunWorkload(LIST_PRELUDE
+                "i = 0\n"
+                "while (i < 100000) {\n"
+                "  keep[i % 1000] = mk(i, mk(i, nil))\n"
+                "  if (i % 10 == 0) keep[(i * 3) % 1000] = nil\n"
+                "  i = i + 1\n"
+                "}\n"
+                "sum = 0\n"
+                "i = 0\n"
+                "while (i < 1000) {\n"
+                "  if (keep[i]) sum = sum + (keep[i].x % 7)\n"
+                "  i = i + 1\n"
+                "}\n"
+                "return sum",
+                2843);
+    ASSERT(out_of_memory_called == 0);
+  }
+
+  // Live data over the limit, callback is invoked with the owning isolate
+  // (process is aborted after it returns, so it runs in a child)
+  {
+    pid_t pid = fork();
+    ASSERT(pid != -1);
+    if (pid == 0) {
+      HeapConfig config;
+      config.page_size = 64 * 1024;
+      config.max_new_space_size = 256 * 1024;
+      config.max_old_space_size = 1024 * 1024;
+      config.heap_limit = 1024 * 1024;
+      config.out_of_memory_callback = OutOfMemoryExitCallback;
+
+      Isolate i(config);
+      out_of_memory_isolate = &i;
+
+      const char* code = "keep = []\n"
+                         "i = 0\n"
+                         "while (i >= 0) {\n"
+                         "  keep[i] = { x: i, s: 'v' + i }\n"
+                         "  i = i + 1\n"
+                         "}\n"
+                         "return i";
+      Function* f = Function::New("gc", code, strlen(code));
+      f->Call(0, NULL);
+      _exit(0);
+    }
+
+    int status;
+    ASSERT(waitpid(pid, &status, 0) == pid);
+    ASSERT(WIFEXITED(status));
+    ASSERT(WEXITSTATUS(status) == kOutOfMemoryExit);
+  }
+
+  // Statistics and tracing
+  {
+    Isolate i;
+    i.SetGCTraceCallback(GCTraceCallback);
+
+    const char* code = "keep = {}\n"
+                       "i = 0\n"
+                       "while (i < 20) {\n"
+                       "  keep[i] = { x: i, y: [ i, i ] }\n"
+                       "  __$gc()\n"
+                       "  i = i + 1\n"
+                       "}\n"
+                       "return keep[19].y[1]";
+
+    Function* f = Function::New("gc", code, strlen(code));
+    Value* result = f->Call(0, NULL);
+    ASSERT(result->As<Number>()->Value() == 19);
+
+    GCStatistics stats;
+    i.GetGCStatistics(&stats);
+    ASSERT(stats.minor_gcs >= 20);
+    ASSERT(gc_events ==
+           static_cast<int>(stats.minor_gcs + stats.major_gcs +
+                            stats.marking_steps));
+    ASSERT(stats.bytes_copied == gc_copied);
+    ASSERT(stats.bytes_copied != 0);
+    ASSERT(stats.new_space_size != 0);
+
+    uint32_t pauses = 0;
+    uint32_t visits = 0;
+    for (int j = 0; j < GCStatistics::kHistogramSize; j++) {
+      pauses += stats.pause_histogram[j];
+      visits += stats.phase_histogram[GCStatistics::kVisit][j];
+    }
+    ASSERT(pauses == static_cast<uint32_t>(gc_events));
+    ASSERT(visits == stats.minor_gcs + stats.major_gcs);
+    ASSERT(stats.max_pause <= stats.total_pause);
+
+    i.SetGCTraceCallback(NULL);
+  }
+
+  // Pretenuring: literals of long-lived cache are allocated in old space
+  // (and still may reference new objects)
+  {
+    Isolate i;
+
+    const char* code = "cache = []\n"
+                       "i = 0\n"
+                       "while (i < 100000) {\n"
+                       "  cache[i] = { x: i, s: nil }\n"
+                       "  i = i + 1\n"
+                       "}\n"
+                       "i = 0\n"
+                       "while (i < 100000) {\n"
+                       "  cache[i].s = { y: i }\n"
+                       "  i = i + 1\n"
+                       "}\n"
+                       "__$gc()\n"
+                       "sum = 0\n"
+                       "i = 0\n"
+                       "while (i < 100000) {\n"
+                       "  sum = sum + (cache[i].s.y - cache[i].x) + 1\n"
+                       "  i = i + 1\n"
+                       "}\n"
+                       "return sum + cache[99999].x";
+
+    Function* f = Function::New("gc", code, strlen(code));
+    Value* result = f->Call(0, NULL);
+    ASSERT(result->As<Number>()->Value() == 199999);
+
+#if CANDOR_ARCH_x64
+    // Cached objects (and cache's maps) are copied over and over again
+    // without pretenuring (~450mb)
+    GCStatistics stats;
+    i.GetGCStatistics(&stats);
+    ASSERT(stats.bytes_copied < 100 * 1024 * 1024);
+#endif  // CANDOR_ARCH_x64
+  }
+
+  // Pretenuring is reverted when site's objects become short-lived
+  {
+    Isolate i;
+
+    const char* code = "mk = (i) {\n"
+                       "  return { x: i }\n"
+                       "}\n"
+                       "return (n, keep) {\n"
+                       "  cache = []\n"
+                       "  sum = 0\n"
+                       "  i = 0\n"
+                       "  while (i < n) {\n"
+                       "    o = mk(i)\n"
+                       "    if (keep) cache[i] = o\n"
+                       "    sum = sum + o.x\n"
+                       "    i++\n"
+                       "  }\n"
+                       "  return sum\n"
+                       "}";
+
+    Function* f = Function::New("gc", code, strlen(code));
+    Handle<Function> run(f->Call(0, NULL)->As<Function>());
+
+    // Warm-up: objects are kept alive
+    Value* argv[2];
+    argv[0] = Number::NewIntegral(100000);
+    argv[1] = Boolean::True();
+    Value* result = run->Call(2, argv);
+    ASSERT(result->As<Number>()->Value() == 4999950000.0);
+
+    // Cache is dead now, sweep finds site's old objects dying
+    i.CollectGarbage(GCEvent::kMajor);
+
+    GCStatistics before;
+    i.GetGCStatistics(&before);
+
+    // Objects are short-lived, they should die in new space
+    argv[0] = Number::NewIntegral(1000000);
+    argv[1] = Boolean::False();
+    result = run->Call(2, argv);
+    ASSERT(result->As<Number>()->Value() == 499999500000.0);
+
+#if CANDOR_ARCH_x64
+    GCStatistics stats;
+    i.GetGCStatistics(&stats);
+    ASSERT(stats.minor_gcs > before.minor_gcs);
+    ASSERT(stats.major_gcs == before.major_gcs);
+#endif  // CANDOR_ARCH_x64
+  }
+
+  // Explicit and idle time GC
+  {
+    Isolate i;
+    i.SetMarkingStepSize(16 * 1024);
+
+    const char* code = "cache = []\n"
+                       "i = 0\n"
+                       "while (i < 100000) {\n"
+                       "  cache[i % 5000] = { i: i }\n"
+                       "  i++\n"
+                       "}\n"
+                       "return cache";
+
+    Function* f = Function::New("gc", code, strlen(code));
+    Handle<Array> cache(f->Call(0, NULL));
+
+    // Finish marking that may be started by script
+    i.CollectGarbage(GCEvent::kMajor);
+
+    GCStatistics before;
+    GCStatistics stats;
+    i.GetGCStatistics(&before);
+
+    i.CollectGarbage(GCEvent::kMinor);
+    i.GetGCStatistics(&stats);
+    ASSERT(stats.minor_gcs == before.minor_gcs + 1);
+    ASSERT(stats.marking_steps == before.marking_steps);
+
+    i.CollectGarbage(GCEvent::kMarkingStep);
+    i.GetGCStatistics(&stats);
+    ASSERT(stats.marking_steps == before.marking_steps + 1);
+    ASSERT(stats.major_gcs == before.major_gcs);
+
+    i.CollectGarbage(GCEvent::kMajor);
+    i.GetGCStatistics(&stats);
+    ASSERT(stats.major_gcs == before.major_gcs + 1);
+
+    int calls = 0;
+    while (!i.IdleNotification(1000000)) {
+      ASSERT(++calls < 10);
+    }
+
+    Object* last = cache->Get(99999 % 5000)->As<Object>();
+    ASSERT(last->Get("i")->As<Number>()->IntegralValue() == 99999);
+  }
+
+  // Frames of compiled functions are visited using safepoints
+  FUN_TEST("mk = (depth) {\n"
+           "  if (depth == 0) {\n"
+           "    __$gc()\n"
+           "    return { v: 1 }\n"
+           "  }\n"
+           "  a = { x: depth }\n"
+           "  b = mk(depth - 1)\n"
+           "  c = [ a, b, { y: depth } ]\n"
+           "  d = mk(depth - 1)\n"
+           "  return { v: b.v + d.v + c[2].y - a.x, l: c, r: d }\n"
+           "}\n"
+           "return mk(8).v", {
+    ASSERT(result->As<Number>()->Value() == 256);
+  })
+
+  // Old space GC removes transitions to dead shapes, literals created after
+  // generated keys have used up shape limits still get shapes
+  {
+    Isolate i;
+    Heap* heap = Heap::Current();
+
+    const char* code = "make(j, k, l) {\n"
+                       "  o = {}\n"
+                       "  o['a' + j] = j\n"
+                       "  o['b' + k] = k\n"
+                       "  o['c' + l] = l\n"
+                       "  return o['a' + j] + o['b' + k] + o['c' + l]\n"
+                       "}\n"
+                       "sum = 0\n"
+                       "i = 0\n"
+                       "while (i < 12288) {\n"
+                       "  sum = sum + make(i % 32, (i >> 5) % 32, i >> 10)\n"
+                       "  i++\n"
+                       "}\n"
+                       "return sum";
+    const char* literal = "return { fresh: 1, keys: 2 }";
+
+    Function* f = Function::New("gc", code, strlen(code));
+    ASSERT(f->Call(0, NULL)->As<Number>()->Value() == 448512);
+
+    // Root shape has no free transitions left
+    Function* lf = Function::New("gc", literal, strlen(literal));
+    Value* obj = lf->Call(0, NULL);
+    ASSERT(HObject::IsDictionary(reinterpret_cast<char*>(obj)));
+
+    i.CollectGarbage(GCEvent::kMajor);
+    ASSERT(heap->shape_count() < 64);
+
+    lf = Function::New("gc", literal, strlen(literal));
+    Handle<Object> live(lf->Call(0, NULL)->As<Object>());
+    ASSERT(!HObject::IsDictionary(reinterpret_cast<char*>(*live)));
+    ASSERT(live->Get("keys")->As<Number>()->Value() == 2);
+
+    // Shapes of live objects stay in the tree
+    i.CollectGarbage(GCEvent::kMajor);
+    obj = lf->Call(0, NULL);
+    ASSERT(HObject::Proto(reinterpret_cast<char*>(obj)) ==
+           HObject::Proto(reinterpret_cast<char*>(*live)));
+  }
+
+  // Heap snapshot
+  {
+    Isolate i;
+
+    const char* code = "mk = (n) {\n"
+                       "  return () { return n }\n"
+                       "}\n"
+                       "list = []\n"
+                       "i = 0\n"
+                       "while (i < 100) {\n"
+                       "  list[i] = { fn: mk(i), name: \"item\" }\n"
+                       "  i = i + 1\n"
+                       "}\n"
+                       "return list";
+
+    Function* f = Function::New("gc", code, strlen(code));
+    Handle<Array> list(f->Call(0, NULL)->As<Array>());
+
+    // NOTE: `make test` passes path in CANDOR_HEAP_SNAPSHOT, runs
+    // tools/heap-snapshot.py on the file and removes it. Otherwise the
+    // snapshot is written into a temporary file which is removed here.
+    char path[1024];
+    const char* snapshot_env = getenv("CANDOR_HEAP_SNAPSHOT");
+    if (snapshot_env != NULL) {
+      snprintf(path, sizeof(path), "%s", snapshot_env);
+    } else {
+      const char* tmpdir = getenv("TMPDIR");
+      snprintf(path,
+               sizeof(path),
+               "%s/candor-XXXXXX",
+               tmpdir == NULL ? "/tmp" : tmpdir);
+      int fd = mkstemp(path);
+      ASSERT(fd != -1);
+      close(fd);
+    }
+    ASSERT(i.WriteHeapSnapshot(path));
+
+    char* json = ReadSnapshot(path);
+    ASSERT(json != NULL);
+
+    SnapshotArray nodes = ParseSnapshotArray(json, "nodes");
+    SnapshotArray edges = ParseSnapshotArray(json, "edges");
+    SnapshotArray roots = ParseSnapshotArray(json, "roots");
+    ASSERT(nodes.length > 0 && nodes.length % 4 == 0);
+    ASSERT(edges.length > 0 && edges.length % 3 == 0);
+    ASSERT(roots.length > 0);
+
+    int array_tag = SnapshotName(json, "tags", "array");
+    int object_tag = SnapshotName(json, "tags", "object");
+    int function_tag = SnapshotName(json, "tags", "function");
+    int string_tag = SnapshotName(json, "tags", "string");
+    int map_tag = SnapshotName(json, "tags", "map");
+    int shape_tag = SnapshotName(json, "tags", "shape");
+    int map_edge = SnapshotName(json, "edge_types", "map");
+    int shape_edge = SnapshotName(json, "edge_types", "shape");
+    ASSERT(array_tag == Heap::kTagArray);
+    ASSERT(object_tag == Heap::kTagObject);
+    ASSERT(function_tag == Heap::kTagFunction);
+    ASSERT(string_tag == Heap::kTagString);
+    ASSERT(map_tag == Heap::kTagMap);
+    ASSERT(shape_tag == Heap::kTagShape);
+    ASSERT(map_edge == HeapSnapshot::kMap);
+    ASSERT(shape_edge == HeapSnapshot::kShape);
+
+    // Edges are going from written objects
+    for (int j = 0; j < edges.length; j += 3) {
+      ASSERT(SnapshotNode(&nodes, edges.items[j]) != -1);
+      ASSERT(edges.items[j + 2] <= HeapSnapshot::kTransitions);
+    }
+
+    // Handle is a root, list is an array holding 100 objects in its map
+    char* list_addr = reinterpret_cast<char*>(*list);
+    uint64_t list_id = reinterpret_cast<intptr_t>(list_addr);
+    int list_node = SnapshotNode(&nodes, list_id);
+    ASSERT(list_node != -1);
+    ASSERT(nodes.items[list_node * 4 + 1] == static_cast<uint64_t>(array_tag));
+    ASSERT(nodes.items[list_node * 4 + 2] == HValue::Cast(list_addr)->Size());
+
+    bool is_root = false;
+    for (int j = 0; j < roots.length; j++) {
+      if (roots.items[j] == list_id) is_root = true;
+    }
+    ASSERT(is_root);
+
+    int list_map = SnapshotEdge(&nodes, &edges, list_id, map_edge, map_tag);
+    ASSERT(list_map != -1);
+
+    int items = 0;
+    uint64_t list_map_id = nodes.items[list_map * 4];
+    for (int j = 0; j < edges.length; j += 3) {
+      if (edges.items[j] != list_map_id) continue;
+
+      // Every item has a shape and a map with function and string in it
+      int item = SnapshotNode(&nodes, edges.items[j + 1]);
+      ASSERT(item != -1);
+      ASSERT(nodes.items[item * 4 + 1] == static_cast<uint64_t>(object_tag));
+
+      uint64_t item_id = nodes.items[item * 4];
+      ASSERT(SnapshotEdge(&nodes, &edges, item_id, shape_edge, shape_tag) !=
+             -1);
+      int item_map = SnapshotEdge(&nodes, &edges, item_id, map_edge, map_tag);
+      ASSERT(item_map != -1);
+
+      uint64_t item_map_id = nodes.items[item_map * 4];
+      ASSERT(SnapshotEdge(&nodes, &edges, item_map_id, -1, function_tag) !=
+             -1);
+      ASSERT(SnapshotEdge(&nodes, &edges, item_map_id, -1, string_tag) != -1);
+      items++;
+    }
+    ASSERT(items == 100);
+
+    // Only starts of objects can be roots
+    TestSnapshot snapshot(Heap::Current());
+    ASSERT(snapshot.IsHeapValue(list_addr));
+    ASSERT(!snapshot.IsHeapValue(list_addr + HValue::kPointerSize));
+    ASSERT(!snapshot.IsHeapValue(HObject::Map(list_addr) + 1));
+
+    delete[] nodes.items;
+    delete[] edges.items;
+    delete[] roots.items;
+    delete[] json;
+    if (snapshot_env == NULL) unlink(path);
+
+    ASSERT(!i.WriteHeapSnapshot("/nonexistent/candor.heapsnapshot"));
+  }
+
+  // Free blocks and pages with free tail are indexed by size class
+  {
+    Isolate i;
+    Heap* heap = Heap::Current();
+    uint32_t page_size = heap->page_pool()->page_size();
+
+    ASSERT(Log2(1) == 0);
+    ASSERT(Log2(3) == 1);
+    ASSERT(Log2(64) == 6);
+    ASSERT(Log2(1023) == 9);
+    ASSERT(Log2(0x80000000) == 31);
+
+    // Fragment first page: gaps of different classes between live objects
+    TestSpace space(heap, page_size);
+    AllocateLive(&space);
+    char* gap64 = AllocateDead(&space, 64);
+    AllocateLive(&space);
+    char* gap256 = AllocateDead(&space, 256);
+    AllocateLive(&space);
+    char* gap1024 = AllocateDead(&space, 1024);
+    AllocateLive(&space);
+
+    space.Sweep();
+    Space::Page* first = space.pages()->head()->value();
+    ASSERT(space.pages()->length() == 1);
+
+    // Exact fit is taken from its own class
+    ASSERT(space.AllocateFromFreeList(64) == gap64);
+
+    // Bigger block is split, remainder goes to lower class
+    ASSERT(space.AllocateFromFreeList(200) == gap256);
+    ASSERT(space.AllocateFromFreeList(56) == gap256 + 200);
+
+    // Remainder would be too small to hold free block
+    ASSERT(space.AllocateFromFreeList(1024 - HValue::kPointerSize) == NULL);
+    ASSERT(space.AllocateFromFreeList(1024) == gap1024);
+
+    // First page's free tail is indexed when other page is selected
+    space.AddPage(page_size);
+    Space::Page* second = space.pages()->tail()->value();
+    uint32_t free_bytes = first->limit_ - first->top_;
+
+    // Only classes above requested one are checked
+    ASSERT(space.FindPage(free_bytes) == NULL);
+    ASSERT(space.FindPage(1 << (Log2(free_bytes) - 1)) == first);
+    ASSERT(space.FindPage(64) == NULL);
+
+    // Allocation that doesn't fit into current page goes to indexed one
+    space.IndexPage(first);
+    char* top = first->top_;
+    space.Allocate((second->limit_ - second->top_) & ~63);
+    ASSERT(space.Allocate(64) == top);
+    ASSERT(*space.top() == &first->top_);
+
+    space.Clear();
+  }
 TEST_END(gc)
@@ -96,4 +96,30 @@ TEST_START(list)
 
     ASSERT(list.length() == 0);
   }
+
+  // Segmented stack: push and pop across segment boundaries
+  {
+    SegmentedStack<NumberKey*> stack;
+    int32_t count = SegmentedStack<NumberKey*>::kSegmentSize * 2 + 3;
+
+    for (int32_t i = 1; i <= count; i++) {
+      stack.Push(NumberKey::New(i));
+    }
+    ASSERT(stack.length() == count);
+
+    // Pop below the boundary and push over it again
+    for (int32_t i = count; i > count - 10; i--) {
+      ASSERT(stack.Pop()->value() == i);
+    }
+    for (int32_t i = count - 9; i <= count; i++) {
+      stack.Push(NumberKey::New(i));
+    }
+
+    for (int32_t i = count; i > 0; i--) {
+      ASSERT(stack.Pop()->value() == i);
+    }
+
+    ASSERT(stack.length() == 0);
+    ASSERT(stack.Pop() == NULL);
+  }
 TEST_END(list)
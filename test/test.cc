@@ -1,4 +1,5 @@
 #include "test.h"
+#include <code-space.h>
 #include "test-list.h"
 
 #define TEST_RUN(name) \
@@ -11,6 +12,13 @@
     } else \
 
 int main(int argc, char** argv) {
+  // Compile everything with optimizing compiler
+  if (argc > 1 && strcmp(argv[1], "--no-tiering") == 0) {
+    CodeSpace::DisableTiering();
+    argc--;
+    argv++;
+  }
+
   if (argc == 1) {
     TESTS_ENUM(TEST_RUN)
     return 0;
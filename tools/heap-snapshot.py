@@ -0,0 +1,232 @@
+#!/usr/bin/env python
+#
+# Copyright (c) 2012, Fedor Indutny.
+#
+# Permission is hereby granted, free of charge, to any person obtaining a copy
+# of this software and associated documentation files (the "Software"), to deal
+# in the Software without restriction, including without limitation the rights
+# to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+# copies of the Software, and to permit persons to whom the Software is
+# furnished to do so, subject to the following conditions:
+#
+# The above copyright notice and this permission notice shall be included in
+# all copies or substantial portions of the Software.
+#
+# THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+# IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+# FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+# AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+# LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+# OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+# SOFTWARE.
+
+"""Reports retained sizes of a heap snapshot.
+
+Snapshot is written by Isolate::WriteHeapSnapshot(). Objects are grouped by
+type, the biggest dominators (objects that alone are keeping others alive)
+and the longest chains of contexts' parents are listed.
+
+Usage: heap-snapshot.py [--top N] snapshot.json
+"""
+
+import json
+import sys
+
+
+class Snapshot(object):
+  def __init__(self, data):
+    self.tags = data['tags']
+    self.edge_types = data['edge_types']
+
+    nodes = data['nodes']
+    self.ids = nodes[0::4]
+    self.node_tags = nodes[1::4]
+    self.sizes = nodes[2::4]
+    self.generations = nodes[3::4]
+    self.count = len(self.ids)
+
+    index = {}
+    for i, node_id in enumerate(self.ids):
+      index[node_id] = i
+
+    # Last node is a virtual root, referencing all real ones
+    self.root = self.count
+    self.edges = [[] for i in range(self.count + 1)]
+    self.parents = [None] * self.count
+
+    edges = data['edges']
+    parent_type = self.edge_types.index('parent')
+    for i in range(0, len(edges), 3):
+      source = index.get(edges[i])
+      target = index.get(edges[i + 1])
+      if source is None or target is None:
+        continue
+      self.edges[source].append(target)
+      if edges[i + 2] == parent_type:
+        self.parents[source] = target
+
+    for root in data['roots']:
+      target = index.get(root)
+      if target is not None:
+        self.edges[self.root].append(target)
+
+  def tag_name(self, node):
+    return self.tags[self.node_tags[node]]
+
+  def compute_dominators(self):
+    """Cooper, Harvey, Kennedy: "A Simple, Fast Dominance Algorithm"."""
+    # Postorder of reachable nodes (without recursion, chains may be long)
+    order = []
+    visited = [False] * (self.count + 1)
+    visited[self.root] = True
+    stack = [(self.root, 0)]
+    while stack:
+      node, edge = stack[-1]
+      if edge < len(self.edges[node]):
+        stack[-1] = (node, edge + 1)
+        target = self.edges[node][edge]
+        if not visited[target]:
+          visited[target] = True
+          stack.append((target, 0))
+      else:
+        stack.pop()
+        order.append(node)
+
+    post_index = [-1] * (self.count + 1)
+    for i, node in enumerate(order):
+      post_index[node] = i
+
+    predecessors = [[] for i in range(self.count + 1)]
+    for node in order:
+      for target in self.edges[node]:
+        predecessors[target].append(node)
+
+    idom = [None] * (self.count + 1)
+    idom[self.root] = self.root
+
+    def intersect(a, b):
+      while a != b:
+        while post_index[a] < post_index[b]:
+          a = idom[a]
+        while post_index[b] < post_index[a]:
+          b = idom[b]
+      return a
+
+    changed = True
+    while changed:
+      changed = False
+      for node in reversed(order):
+        if node == self.root:
+          continue
+        new_idom = None
+        for pred in predecessors[node]:
+          if idom[pred] is None:
+            continue
+          new_idom = pred if new_idom is None else intersect(pred, new_idom)
+        if idom[node] != new_idom:
+          idom[node] = new_idom
+          changed = True
+
+    # Children are accounted before their dominators
+    retained = self.sizes + [0]
+    retained = [retained[i] if visited[i] else 0 for i in range(len(retained))]
+    for node in order:
+      if node != self.root:
+        retained[idom[node]] += retained[node]
+
+    # Dominators first
+    self.order = list(reversed(order))
+    self.reachable = visited
+    self.idom = idom
+    self.retained = retained
+
+  def context_chain(self, node):
+    length = 0
+    seen = set()
+    while node is not None and node not in seen:
+      seen.add(node)
+      length += 1
+      node = self.parents[node]
+    return length
+
+
+def report(snapshot, top):
+  snapshot.compute_dominators()
+  count = snapshot.count
+
+  reachable = [i for i in range(count) if snapshot.reachable[i]]
+  total = sum(snapshot.sizes)
+  live = sum(snapshot.sizes[i] for i in reachable)
+  print('Objects: %d (%d bytes), reachable: %d (%d bytes), '
+        'unreachable: %d (%d bytes)' % (count, total,
+                                        len(reachable), live,
+                                        count - len(reachable), total - live))
+
+  # Retained size of type counts only objects that aren't dominated by
+  # objects of the same type (otherwise it'll be counted twice)
+  by_tag = {}
+  dominator_tags = {snapshot.root: 0}
+  for i in snapshot.order:
+    if i == snapshot.root:
+      continue
+    dominator = snapshot.idom[i]
+    tags = dominator_tags[dominator]
+    if dominator != snapshot.root:
+      tags |= 1 << snapshot.node_tags[dominator]
+    dominator_tags[i] = tags
+
+    entry = by_tag.setdefault(snapshot.tag_name(i), [0, 0, 0])
+    entry[0] += 1
+    entry[1] += snapshot.sizes[i]
+    if not tags & (1 << snapshot.node_tags[i]):
+      entry[2] += snapshot.retained[i]
+
+  print('')
+  print('%-10s %10s %12s %12s' % ('type', 'count', 'size', 'retained'))
+  for tag, entry in sorted(by_tag.items(), key=lambda e: -e[1][2]):
+    print('%-10s %10d %12d %12d' % (tag, entry[0], entry[1], entry[2]))
+
+  print('')
+  print('Top dominators:')
+  dominators = sorted(reachable, key=lambda i: -snapshot.retained[i])[:top]
+  for i in dominators:
+    path = []
+    node = snapshot.idom[i]
+    while node != snapshot.root and len(path) < 4:
+      path.append(snapshot.tag_name(node))
+      node = snapshot.idom[node]
+    path.append('root')
+    print('  0x%x %-9s gen %d size %d retained %d (held by %s)' % (
+        snapshot.ids[i], snapshot.tag_name(i), snapshot.generations[i],
+        snapshot.sizes[i], snapshot.retained[i], ' <- '.join(path)))
+
+  context_tag = snapshot.tags.index('context')
+  contexts = [i for i in reachable if snapshot.node_tags[i] == context_tag]
+  chains = sorted(((snapshot.context_chain(i), i) for i in contexts),
+                  reverse=True)[:top]
+  if chains:
+    print('')
+    print('Longest context chains:')
+    for length, i in chains:
+      print('  0x%x length %d retained %d' % (snapshot.ids[i], length,
+                                              snapshot.retained[i]))
+
+
+def main(argv):
+  top = 10
+  args = argv[1:]
+  if len(args) >= 2 and args[0] == '--top':
+    top = int(args[1])
+    args = args[2:]
+  if len(args) != 1:
+    sys.stderr.write(__doc__)
+    return 1
+
+  with open(args[0]) as f:
+    snapshot = Snapshot(json.load(f))
+  report(snapshot, top)
+  return 0
+
+
+if __name__ == '__main__':
+  sys.exit(main(sys.argv))